@@ -24,7 +24,10 @@
 #endif
 
 #include "gstdroidcodec.h"
+#include "gstdroidcodecprobe.h"
+#include "gstdroidstagingpool.h"
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <gst/base/gstbytewriter.h>
 #ifndef GST_USE_UNSTABLE_API
 #define GST_USE_UNSTABLE_API
@@ -53,8 +56,8 @@ static gboolean ignore_codec_data (GstDroidCodec * codec, GstBuffer * data,
     DroidMediaData * out);
 static gboolean process_h26xdec_data (GstDroidCodec * codec, GstBuffer * buffer,
     DroidMediaData * out);
-static gboolean process_aacdec_data (GstDroidCodec * codec, GstBuffer * buffer,
-    DroidMediaData * out);
+static gboolean rewrite_h26xdec_data_in_place (GstDroidCodec * codec,
+    GstVideoCodecFrame * frame, DroidMediaData * out, GstMapInfo * map);
 static gboolean is_mpeg4v (GstDroidCodec * codec, const GstStructure * s);
 static gboolean is_mpega (GstDroidCodec * codec, const GstStructure * s);
 static gboolean is_h264_dec (GstDroidCodec * codec, const GstStructure * s);
@@ -68,15 +71,32 @@ static void gst_droid_codec_type_fill_quirks (GstDroidCodec * codec);
 
 GST_DEFINE_MINI_OBJECT_TYPE (GstDroidCodec, gst_droid_codec);
 
+/*
+ * gstdroidcodec.conf is parsed once per process and parsed again only when
+ * its modification time or size changes. Protected by conf_lock
+ */
+static GMutex conf_lock;
+static GKeyFile *conf_file = NULL;
+static GHashTable *conf_quirks = NULL;  /* "group/droid type" -> quirks */
+static gint64 conf_mtime = -1;
+static gint64 conf_size = -1;
+
 typedef struct
 {
   gpointer data;
+
+  /* set when data points into the mapped input buffer */
+  GstBuffer *buffer;
+  GstMapInfo map;
 } GstDroidCodecFrameReleaseData;
 
 struct _GstDroidCodecPrivate
 {
   guint h264_nal;
   gboolean aac_adts;
+
+  /* recycled input copies and release data */
+  GstDroidStagingPool *staging;
 };
 
 struct _GstDroidCodecInfo
@@ -111,7 +131,7 @@ static GstDroidCodecInfo codecs[] = {
         "audio/mpeg, mpegversion=(int){2, 4}, stream-format=(string){raw, adts}",
         TRUE,
         is_mpega, NULL, NULL, NULL, create_aacdec_codec_data_from_codec_data,
-      create_aacdec_codec_data_from_frame_data, process_aacdec_data},
+      create_aacdec_codec_data_from_frame_data, NULL},
 
   {GST_DROID_CODEC_DECODER_AUDIO, "audio/AMR", "audio/3gpp",
         "audio/AMR", FALSE, NULL, NULL, NULL, NULL,
@@ -177,6 +197,7 @@ gst_droid_codec_new_from_caps (GstCaps * caps, GstDroidCodecType type)
   const gchar *name = gst_structure_get_name (s);
   GstDroidCodec *codec = g_slice_new (GstDroidCodec);
   codec->data = g_slice_new0 (GstDroidCodecPrivate);
+  codec->data->staging = gst_droid_staging_pool_new ();
 
   for (x = 0; x < len; x++) {
     if (codecs[x].type != type) {
@@ -208,24 +229,125 @@ gst_droid_codec_new_from_caps (GstCaps * caps, GstDroidCodecType type)
   return NULL;
 }
 
+static guint
+gst_droid_codec_parse_quirks (gchar ** quirks_string, gsize quirks_length)
+{
+  guint quirks = 0;
+  gsize x;
+
+  for (x = 0; x < quirks_length; x++) {
+    if (!g_strcmp0 (quirks_string[x], USE_CODEC_SUPPLIED_HEIGHT_NAME)) {
+      quirks |= USE_CODEC_SUPPLIED_HEIGHT_VALUE;
+    } else if (!g_strcmp0 (quirks_string[x], USE_CODEC_SUPPLIED_WIDTH_NAME)) {
+      quirks |= USE_CODEC_SUPPLIED_WIDTH_VALUE;
+    } else if (!g_strcmp0 (quirks_string[x], DONT_USE_DROID_CONVERT_NAME)) {
+      quirks |= DONT_USE_DROID_CONVERT_VALUE;
+    }
+  }
+
+  return quirks;
+}
+
+static void
+gst_droid_codec_conf_load_quirks (const gchar * group)
+{
+  gchar **keys;
+  gsize x;
+
+  keys = g_key_file_get_keys (conf_file, group, NULL, NULL);
+  if (!keys) {
+    return;
+  }
+
+  for (x = 0; keys[x]; x++) {
+    gchar **quirks_string;
+    gsize quirks_length = 0;
+
+    quirks_string = g_key_file_get_string_list (conf_file, group, keys[x],
+        &quirks_length, NULL);
+    if (!quirks_string) {
+      continue;
+    }
+
+    g_hash_table_insert (conf_quirks, g_strdup_printf ("%s/%s", group,
+            keys[x]), GUINT_TO_POINTER (gst_droid_codec_parse_quirks
+            (quirks_string, quirks_length)));
+
+    g_strfreev (quirks_string);
+  }
+
+  g_strfreev (keys);
+}
+
+/* call with conf_lock held */
+static GKeyFile *
+gst_droid_codec_conf_ensure (void)
+{
+  gchar *path = g_strdup_printf ("%s/gst-droid/gstdroidcodec.conf", SYSCONFDIR);
+  GStatBuf st;
+  gint64 mtime = -1;
+  gint64 size = -1;
+
+  if (g_stat (path, &st) == 0) {
+    mtime = st.st_mtime;
+    size = st.st_size;
+  }
+
+  if (conf_file && mtime == conf_mtime && size == conf_size) {
+    goto out;
+  }
+
+  GST_INFO ("loading %s", path);
+
+  if (conf_file) {
+    g_key_file_free (conf_file);
+  }
+
+  if (!conf_quirks) {
+    conf_quirks = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  } else {
+    g_hash_table_remove_all (conf_quirks);
+  }
+
+  conf_file = g_key_file_new ();
+  conf_mtime = mtime;
+  conf_size = size;
+
+  if (mtime != -1) {
+    g_key_file_load_from_file (conf_file, path, G_KEY_FILE_NONE, NULL);
+  }
+
+  gst_droid_codec_conf_load_quirks ("decoder-quirks");
+  gst_droid_codec_conf_load_quirks ("encoder-quirks");
+
+out:
+  g_free (path);
+
+  return conf_file;
+}
+
 GstCaps *
 gst_droid_codec_get_all_caps (GstDroidCodecType type)
 {
   GstCaps *caps = gst_caps_new_empty ();
   int x = 0;
   int len = G_N_ELEMENTS (codecs);
-  GKeyFile *file = g_key_file_new ();
-  gchar *path = g_strdup_printf ("%s/gst-droid/gstdroidcodec.conf", SYSCONFDIR);
+  gboolean enabled[G_N_ELEMENTS (codecs)];
+  GKeyFile *file;
   gchar *group = type == GST_DROID_CODEC_DECODER_AUDIO
       || type == GST_DROID_CODEC_DECODER_VIDEO ? "decoders" : "encoders";
 
-  g_key_file_load_from_file (file, path, G_KEY_FILE_NONE, NULL);
-  g_free (path);
+  /* Only take the configuration snapshot under the lock. Probing below can
+   * reach the HAL and must not hold up anyone else reading the config */
+  g_mutex_lock (&conf_lock);
+
+  file = gst_droid_codec_conf_ensure ();
 
   for (x = 0; x < len; x++) {
     gboolean codec_listed;
     gint codec_enabled;
-    GstStructure *s;
+
+    enabled[x] = FALSE;
 
     if (codecs[x].type != type) {
       continue;
@@ -241,13 +363,22 @@ gst_droid_codec_get_all_caps (GstDroidCodecType type)
       continue;
     }
 
+    enabled[x] = TRUE;
+  }
+
+  g_mutex_unlock (&conf_lock);
+
+  for (x = 0; x < len; x++) {
+    GstStructure *s;
+
+    if (!enabled[x]) {
+      continue;
+    }
+
     /* Verify that video codec is supported before enabling it */
     if (type == GST_DROID_CODEC_DECODER_VIDEO
         || type == GST_DROID_CODEC_ENCODER_VIDEO) {
-      DroidMediaCodecMetaData md;
-      md.type = codecs[x].droid;
-      md.flags = DROID_MEDIA_CODEC_HW_ONLY;
-      if (!droid_media_codec_is_supported (&md,
+      if (!gst_droid_codec_probe_is_supported (codecs[x].droid,
               type == GST_DROID_CODEC_ENCODER_VIDEO)) {
         GST_INFO ("No hardware support found for %s, disabling codec",
             codecs[x].droid);
@@ -261,8 +392,6 @@ gst_droid_codec_get_all_caps (GstDroidCodecType type)
 
   GST_INFO ("caps %" GST_PTR_FORMAT, caps);
 
-  g_key_file_free (file);
-
   return caps;
 }
 
@@ -275,6 +404,8 @@ gst_droid_codec_get_droid_type (GstDroidCodec * codec)
 void
 gst_droid_codec_free (GstDroidCodec * codec)
 {
+  /* blocks still held by droidmedia keep the pool alive */
+  gst_droid_staging_pool_unref (codec->data->staging);
   g_slice_free (GstDroidCodecPrivate, codec->data);
   g_slice_free (GstDroidCodec, codec);
 }
@@ -318,6 +449,18 @@ gst_droid_codec_create_decoder_codec_data (GstDroidCodec * codec,
       out) ? GST_DROID_CODEC_CODEC_DATA_OK : GST_DROID_CODEC_CODEC_DATA_ERROR;
 }
 
+static GstDroidCodecFrameReleaseData *
+gst_droid_codec_new_release_data (GstDroidCodec * codec)
+{
+  GstDroidCodecFrameReleaseData *release_data =
+      gst_droid_staging_pool_alloc (codec->data->staging,
+      sizeof (GstDroidCodecFrameReleaseData));
+
+  memset (release_data, 0x0, sizeof (*release_data));
+
+  return release_data;
+}
+
 gboolean
 gst_droid_codec_prepare_decoder_frame (GstDroidCodec * codec,
     GstVideoCodecFrame * frame, DroidMediaData * data,
@@ -329,24 +472,37 @@ gst_droid_codec_prepare_decoder_frame (GstDroidCodec * codec,
    * We have multiple cases.
    * H264 nal prefix size 4 -> map the buffer writable, fix up and proceed
    * H264 nal prefix size != 4 -> copy data and fix up.
-   * The rest -> map buffer read only and proceed
-   * However as I do not believe that the memcpy() is that expensive
-   * so we will just copy everything and optimize later if we find issues.
+   * The rest -> copy everything. We could map the buffer read only but
+   * the memcpy() is cheap for anything but high bitrate video.
    */
 
-  if (codec->info->process_decoder_data) {
+  release_data = gst_droid_codec_new_release_data (codec);
+
+  if (codec->info->process_decoder_data == process_h26xdec_data
+      && codec->data->h264_nal == 4) {
+    if (!rewrite_h26xdec_data_in_place (codec, frame, data,
+            &release_data->map)) {
+      gst_droid_staging_pool_release (release_data);
+      return FALSE;
+    }
+
+    /* keep the memory alive until droidmedia is done with it */
+    release_data->buffer = gst_buffer_ref (frame->input_buffer);
+  } else if (codec->info->process_decoder_data) {
     if (!codec->info->process_decoder_data (codec, frame->input_buffer, data)) {
+      gst_droid_staging_pool_release (release_data);
       return FALSE;
     }
+
+    release_data->data = data->data;
   } else {
     data->size = gst_buffer_get_size (frame->input_buffer);
-    data->data = g_malloc (data->size);
+    data->data = gst_droid_staging_pool_alloc (codec->data->staging,
+        data->size);
     gst_buffer_extract (frame->input_buffer, 0, data->data, data->size);
-  }
-
-  release_data = g_slice_new (GstDroidCodecFrameReleaseData);
 
-  release_data->data = data->data;
+    release_data->data = data->data;
+  }
 
   cb->unref = gst_droid_codec_release_input_frame;
   cb->data = release_data;
@@ -354,46 +510,154 @@ gst_droid_codec_prepare_decoder_frame (GstDroidCodec * codec,
   return TRUE;
 }
 
+gsize
+gst_droid_codec_get_encoded_size (GstDroidCodec * codec, DroidMediaData * in)
+{
+  /* processing can at most add a 4 bytes NAL size */
+  return codec->info->process_encoder_data ? in->size + 4 : in->size;
+}
+
+gboolean
+gst_droid_codec_fill_encoded_data (GstDroidCodec * codec, DroidMediaData * in,
+    GstBuffer * buffer)
+{
+  GstMapInfo info;
+  DroidMediaData out;
+  gboolean ret = TRUE;
+
+  if (gst_buffer_get_size (buffer) < gst_droid_codec_get_encoded_size (codec,
+          in)) {
+    GST_ERROR ("output buffer too small");
+    return FALSE;
+  }
+
+  if (!gst_buffer_map (buffer, &info, GST_MAP_WRITE)) {
+    GST_ERROR ("failed to map buffer");
+    return FALSE;
+  }
+
+  out.data = info.data;
+  out.size = info.size;
+
+  if (codec->info->process_encoder_data) {
+    ret = codec->info->process_encoder_data (in, &out);
+  } else {
+    memcpy (out.data, in->data, in->size);
+    out.size = in->size;
+  }
+
+  gst_buffer_unmap (buffer, &info);
+
+  if (ret) {
+    gst_buffer_set_size (buffer, out.size);
+  }
+
+  return ret;
+}
+
+gboolean
+gst_droid_codec_prepare_encoder_data (GstDroidCodec * codec,
+    GstBuffer * buffer, DroidMediaData * data, DroidMediaBufferCallbacks * cb)
+{
+  /*
+   * Always a copy. GstAudioEncoder hands us a read-only wrapper around its
+   * adapter memory, without a destroy notify, which is unmapped and flushed
+   * as soon as handle_frame returns. Holding a reference to the buffer does
+   * not keep that memory alive for droidmedia.
+   */
+  GST_LOG ("copying input buffer");
+
+  data->size = gst_buffer_get_size (buffer);
+  data->data = gst_droid_staging_pool_alloc (codec->data->staging,
+      data->size);
+
+  if (gst_buffer_extract (buffer, 0, data->data, data->size) != data->size) {
+    GST_ERROR ("failed to copy buffer");
+    gst_droid_staging_pool_release (data->data);
+    return FALSE;
+  }
+
+  cb->unref = gst_droid_staging_pool_release;
+  cb->data = data->data;
+
+  return TRUE;
+}
+
+GstStructure *
+gst_droid_codec_get_staging_stats (GstDroidCodec * codec)
+{
+  return gst_droid_staging_pool_get_stats (codec->data->staging);
+}
+
 GstBuffer *
 gst_droid_codec_prepare_encoded_data (GstDroidCodec * codec,
     DroidMediaData * in)
 {
   GstBuffer *buffer;
 
-  if (codec->info->process_encoder_data) {
-    DroidMediaData out;
-    if (!codec->info->process_encoder_data (in, &out)) {
-      buffer = NULL;
-    } else {
-      buffer = gst_buffer_new_wrapped (out.data, out.size);
-    }
-  } else {
-    buffer = gst_buffer_new_allocate (NULL, in->size, NULL);
-    gst_buffer_fill (buffer, 0, in->data, in->size);
+  buffer = gst_buffer_new_allocate (NULL,
+      gst_droid_codec_get_encoded_size (codec, in), NULL);
+
+  if (!gst_droid_codec_fill_encoded_data (codec, in, buffer)) {
+    gst_buffer_unref (buffer);
+    buffer = NULL;
   }
 
   return buffer;
 }
 
 gboolean
-gst_droid_codec_process_decoder_data (GstDroidCodec * codec, GstBuffer * buffer,
-    DroidMediaData * out)
+gst_droid_codec_prepare_decoder_data (GstDroidCodec * codec,
+    GstBuffer * buffer, DroidMediaData * data, DroidMediaBufferCallbacks * cb)
 {
-  GstMapInfo info;
+  GstDroidCodecFrameReleaseData *release_data;
+  gsize header_size = 0;
+
+  release_data = gst_droid_codec_new_release_data (codec);
 
   if (codec->info->process_decoder_data) {
-    return codec->info->process_decoder_data (codec, buffer, out);
+    if (!codec->info->process_decoder_data (codec, buffer, data)) {
+      gst_droid_staging_pool_release (release_data);
+      return FALSE;
+    }
+
+    release_data->data = data->data;
+    goto out;
   }
 
-  if (!gst_buffer_map (buffer, &info, GST_MAP_READ)) {
+  /*
+   * Hand droidmedia a pointer into the mapped buffer. The buffer stays
+   * mapped until droidmedia releases the data.
+   */
+  if (!gst_buffer_map (buffer, &release_data->map, GST_MAP_READ)) {
     GST_ERROR ("failed to map buffer");
+    gst_droid_staging_pool_release (release_data);
     return FALSE;
   }
 
-  out->size = info.size;
-  out->data = g_malloc (info.size);
-  memcpy (out->data, info.data, info.size);
-  gst_buffer_unmap (buffer, &info);
+  if (codec->data->aac_adts) {
+    /* stolen from gstaacparse.c */
+    if (release_data->map.size >= 2) {
+      header_size = (release_data->map.data[1] & 1) ? 7 : 9;    /* optional CRC */
+    }
+
+    if (release_data->map.size < 2 || release_data->map.size < header_size) {
+      GST_ERROR ("malformed ADTS frame");
+      gst_buffer_unmap (buffer, &release_data->map);
+      gst_droid_staging_pool_release (release_data);
+      return FALSE;
+    }
+
+    GST_LOG ("stripping %" G_GSIZE_FORMAT " bytes", header_size);
+  }
+
+  release_data->buffer = gst_buffer_ref (buffer);
+  data->data = release_data->map.data + header_size;
+  data->size = release_data->map.size - header_size;
+
+out:
+  cb->unref = gst_droid_codec_release_input_frame;
+  cb->data = release_data;
 
   return TRUE;
 }
@@ -948,6 +1212,40 @@ ignore_codec_data (GstDroidCodec * codec G_GNUC_UNUSED,
   return TRUE;
 }
 
+static gboolean
+read_h26x_nal_length (GstByteReader * reader, guint nal, guint * len)
+{
+  guint16 len16 = 0;
+  guint8 len8 = 0;
+  gboolean success = FALSE;
+
+  switch (nal) {
+    case 4:
+      success = gst_byte_reader_get_uint32_be (reader, len);
+      break;
+
+    case 3:
+      success = gst_byte_reader_get_uint24_be (reader, len);
+      break;
+
+    case 2:
+      success = gst_byte_reader_get_uint16_be (reader, &len16);
+      *len = len16;
+      break;
+
+    case 1:
+      success = gst_byte_reader_get_uint8 (reader, &len8);
+      *len = len8;
+      break;
+
+    default:
+      g_assert_not_reached ();
+      break;
+  }
+
+  return success;
+}
+
 static gboolean
 process_h26xdec_data (GstDroidCodec * codec, GstBuffer * buffer,
     DroidMediaData * out)
@@ -955,7 +1253,8 @@ process_h26xdec_data (GstDroidCodec * codec, GstBuffer * buffer,
   GstMapInfo info;
   gboolean ret = FALSE;
   GstByteReader reader;
-  GstByteWriter *writer = NULL;
+  GstByteWriter writer;
+  gsize size = 0;
 
   if (!gst_buffer_map (buffer, &info, GST_MAP_READ)) {
     GST_ERROR ("failed to map buffer");
@@ -980,108 +1279,108 @@ process_h26xdec_data (GstDroidCodec * codec, GstBuffer * buffer,
       goto out;
   }
 
+  /* Work out the output size first so we can stage it in one block */
   gst_byte_reader_init (&reader, info.data, info.size);
 
-  /* info.size is our best estimate and should be correct if nal prefix is 4 bytes which is most of the cases */
-  writer = gst_byte_writer_new_with_size (info.size, FALSE);
-
   while (gst_byte_reader_get_pos (&reader) < info.size) {
     guint len = 0;
-    guint16 len16 = 0;
-    guint8 len8 = 0;
-    gboolean success = FALSE;
-    const guint8 *data = NULL;
 
-    switch (codec->data->h264_nal) {
-      case 4:
-        success = gst_byte_reader_get_uint32_be (&reader, &len);
-        break;
-
-      case 3:
-        success = gst_byte_reader_get_uint24_be (&reader, &len);
-        break;
-
-      case 2:
-        success = gst_byte_reader_get_uint16_be (&reader, &len16);
-        len = len16;
-        break;
-
-      case 1:
-        success = gst_byte_reader_get_uint8 (&reader, &len8);
-        len = len8;
-        break;
-
-      default:
-        g_assert_not_reached ();
-        break;
-    }
-
-    if (!success) {
+    if (!read_h26x_nal_length (&reader, codec->data->h264_nal, &len)) {
       GST_ERROR ("malformed NAL");
       goto out;
     }
 
-    if (!gst_byte_writer_put_data (writer, (guint8 *) "\x00\x00\x00\x01", 4)) {
-      GST_ERROR ("failed to write NAL prefix");
-      goto out;
-    }
-
-    if (!gst_byte_reader_get_data (&reader, len, &data)) {
+    if (!gst_byte_reader_skip (&reader, len)) {
       GST_ERROR ("failed to read NAL");
       goto out;
     }
 
-    if (!gst_byte_writer_put_data (writer, data, len)) {
-      GST_ERROR ("failed to write NAL");
-      goto out;
-    }
+    size += 4 + len;
+  }
+
+  out->size = size;
+  out->data = gst_droid_staging_pool_alloc (codec->data->staging, size);
+
+  gst_byte_reader_init (&reader, info.data, info.size);
+  gst_byte_writer_init_with_data (&writer, out->data, size, FALSE);
+
+  while (gst_byte_reader_get_pos (&reader) < info.size) {
+    guint len = 0;
+    const guint8 *data = NULL;
+
+    /* Already validated above */
+    read_h26x_nal_length (&reader, codec->data->h264_nal, &len);
+    gst_byte_reader_get_data (&reader, len, &data);
+
+    gst_byte_writer_put_data_unchecked (&writer,
+        (guint8 *) "\x00\x00\x00\x01", 4);
+    gst_byte_writer_put_data_unchecked (&writer, data, len);
 
     GST_LOG ("parsed nal unit of size %d", len);
   }
 
-  out->size = gst_byte_writer_get_size (writer);
-  out->data = gst_byte_writer_free_and_get_data (writer);
-  writer = NULL;
   ret = TRUE;
 
 out:
-  if (writer) {
-    gst_byte_writer_free (writer);
-    writer = NULL;
-  }
-
   gst_buffer_unmap (buffer, &info);
 
   return ret;
 }
 
 static gboolean
-process_aacdec_data (GstDroidCodec * codec, GstBuffer * buffer,
-    DroidMediaData * out)
+rewrite_h26xdec_data_in_place (GstDroidCodec * codec,
+    GstVideoCodecFrame * frame, DroidMediaData * out, GstMapInfo * map)
 {
-  GstMapInfo info;
+  gsize pos;
 
-  if (!gst_buffer_map (buffer, &info, GST_MAP_READ)) {
+  /*
+   * A 4 byte length prefix has the same size as a start code so we can
+   * overwrite the prefixes in place. If upstream still holds a reference
+   * to the buffer then make_writable () will copy it for us.
+   */
+  frame->input_buffer = gst_buffer_make_writable (frame->input_buffer);
+
+  if (!gst_buffer_map (frame->input_buffer, map, GST_MAP_READWRITE)) {
     GST_ERROR ("failed to map buffer");
     return FALSE;
   }
 
-  if (!codec->data->aac_adts) {
-    out->size = info.size;
-    out->data = g_malloc (info.size);
-    memcpy (out->data, info.data, info.size);
-  } else {
-    /* stolen from gstaacparse.c */
-    guint header_size = (info.data[1] & 1) ? 7 : 9;     /* optional CRC */
-    out->size = info.size - header_size;
-    out->data = g_malloc (out->size);
-    memcpy (out->data, info.data + header_size, out->size);
-    GST_LOG ("stripping %d bytes", header_size);
+  /* validate everything first so we do not leave a half rewritten buffer */
+  for (pos = 0; pos < map->size;) {
+    guint32 len;
+
+    if (map->size - pos < 4) {
+      GST_ERROR ("malformed NAL");
+      goto error;
+    }
+
+    len = GST_READ_UINT32_BE (map->data + pos);
+    if (len > map->size - pos - 4) {
+      GST_ERROR ("failed to read NAL");
+      goto error;
+    }
+
+    pos += 4 + len;
   }
 
-  gst_buffer_unmap (buffer, &info);
+  for (pos = 0; pos < map->size;) {
+    guint32 len = GST_READ_UINT32_BE (map->data + pos);
+
+    GST_WRITE_UINT32_BE (map->data + pos, 1);
+
+    GST_LOG ("parsed nal unit of size %d", len);
+
+    pos += 4 + len;
+  }
+
+  out->data = map->data;
+  out->size = map->size;
 
   return TRUE;
+
+error:
+  gst_buffer_unmap (frame->input_buffer, map);
+  return FALSE;
 }
 
 static gboolean
@@ -1100,11 +1399,8 @@ process_h264enc_data (DroidMediaData * in, DroidMediaData * out)
     data = in->data;
   }
 
+  /* out->data is allocated by the caller */
   size = GUINT32_TO_BE (out->size - 4);
-  out->data = g_malloc (out->size);
-  if (!out->data) {
-    return FALSE;
-  }
 
   memcpy (out->data, &size, sizeof (size));
   memcpy (out->data + 4, data, out->size - 4);
@@ -1117,57 +1413,37 @@ gst_droid_codec_release_input_frame (void *data)
 {
   GstDroidCodecFrameReleaseData *info = (GstDroidCodecFrameReleaseData *) data;
 
-  g_free (info->data);
+  if (info->buffer) {
+    gst_buffer_unmap (info->buffer, &info->map);
+    gst_buffer_unref (info->buffer);
+  } else {
+    gst_droid_staging_pool_release (info->data);
+  }
 
-  g_slice_free (GstDroidCodecFrameReleaseData, info);
+  gst_droid_staging_pool_release (info);
 }
 
 static void
 gst_droid_codec_type_fill_quirks (GstDroidCodec * codec)
 {
-  GKeyFile *file = g_key_file_new ();
-  gchar *path = g_strdup_printf ("%s/gst-droid/gstdroidcodec.conf", SYSCONFDIR);
-  gchar **quirks_string = NULL;
   const gchar *group
       = (codec->info->type == GST_DROID_CODEC_DECODER_AUDIO
       || codec->info->type ==
       GST_DROID_CODEC_DECODER_VIDEO) ? "decoder-quirks" : "encoder-quirks";
-  gsize quirks_length = 0;
-  codec->quirks = 0;
-  int x;
+  gchar *key = g_strdup_printf ("%s/%s", group, codec->info->droid);
+  gpointer quirks = NULL;
 
-  g_key_file_load_from_file (file, path, G_KEY_FILE_NONE, NULL);
-  g_free (path);
+  g_mutex_lock (&conf_lock);
 
-  if (!g_key_file_has_group (file, group)) {
-    GST_LOG ("no quirks");
-    goto out;
-  }
+  gst_droid_codec_conf_ensure ();
 
-  quirks_string =
-      g_key_file_get_string_list (file, group, codec->info->droid,
-      &quirks_length, NULL);
-  if (!quirks_string) {
+  if (!g_hash_table_lookup_extended (conf_quirks, key, NULL, &quirks)) {
     GST_LOG ("no quirks for %s", codec->info->droid);
-    goto out;
   }
 
-  for (x = 0; x < quirks_length; x++) {
-    if (!g_strcmp0 (quirks_string[x], USE_CODEC_SUPPLIED_HEIGHT_NAME)) {
-      codec->quirks |= USE_CODEC_SUPPLIED_HEIGHT_VALUE;
-    } else if (!g_strcmp0 (quirks_string[x], USE_CODEC_SUPPLIED_WIDTH_NAME)) {
-      codec->quirks |= USE_CODEC_SUPPLIED_WIDTH_VALUE;
-    } else if (!g_strcmp0 (quirks_string[x], DONT_USE_DROID_CONVERT_NAME)) {
-      codec->quirks |= DONT_USE_DROID_CONVERT_VALUE;
-    }
-  }
+  g_mutex_unlock (&conf_lock);
 
-out:
-  g_key_file_free (file);
-  file = NULL;
+  codec->quirks = GPOINTER_TO_UINT (quirks);
 
-  if (quirks_string) {
-    g_strfreev (quirks_string);
-    quirks_string = NULL;
-  }
+  g_free (key);
 }
@@ -99,9 +99,17 @@ gboolean gst_droid_codec_prepare_decoder_frame (GstDroidCodec * codec, GstVideoC
 						DroidMediaBufferCallbacks *cb);
 
 GstBuffer *gst_droid_codec_prepare_encoded_data (GstDroidCodec * codec, DroidMediaData * in);
-
-gboolean gst_droid_codec_process_decoder_data (GstDroidCodec * codec, GstBuffer * buffer,
-					       DroidMediaData * out);
+gsize gst_droid_codec_get_encoded_size (GstDroidCodec * codec, DroidMediaData * in);
+gboolean gst_droid_codec_fill_encoded_data (GstDroidCodec * codec, DroidMediaData * in,
+					    GstBuffer * buffer);
+
+gboolean gst_droid_codec_prepare_decoder_data (GstDroidCodec * codec, GstBuffer * buffer,
+					       DroidMediaData * data,
+					       DroidMediaBufferCallbacks *cb);
+gboolean gst_droid_codec_prepare_encoder_data (GstDroidCodec * codec, GstBuffer * buffer,
+					       DroidMediaData * data,
+					       DroidMediaBufferCallbacks *cb);
+GstStructure *gst_droid_codec_get_staging_stats (GstDroidCodec * codec);
 gint gst_droid_codec_get_samples_per_frane (GstCaps * caps);
 
 G_END_DECLS
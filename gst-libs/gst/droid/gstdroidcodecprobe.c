@@ -0,0 +1,197 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2021 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE             /* dladdr () */
+#endif
+
+#include "gstdroidcodecprobe.h"
+#include "droidmediacodec.h"
+#include <glib/gstdio.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <string.h>             /* memset() */
+
+GST_DEBUG_CATEGORY_EXTERN (gst_droid_codec_debug);
+#define GST_CAT_DEFAULT gst_droid_codec_debug
+
+/* bump this when the layout of the cache file changes */
+#define GST_DROID_CODEC_PROBE_CACHE_VERSION   1
+#define GST_DROID_CODEC_PROBE_SYSTEM_STAMP    "/system/build.prop"
+
+#define GROUP_CACHE                           "cache"
+#define GROUP_DECODERS                        "decoders"
+#define GROUP_ENCODERS                        "encoders"
+
+static GMutex probe_lock;
+static GKeyFile *probe_cache = NULL;
+static gchar *probe_cache_path = NULL;
+
+static gchar *
+gst_droid_codec_probe_file_stamp (const gchar * path)
+{
+  GStatBuf st;
+
+  if (!path || g_stat (path, &st) != 0) {
+    return g_strdup ("none");
+  }
+
+  return g_strdup_printf ("%" G_GINT64_FORMAT ":%" G_GINT64_FORMAT,
+      (gint64) st.st_mtime, (gint64) st.st_size);
+}
+
+static gchar *
+gst_droid_codec_probe_droidmedia_stamp (void)
+{
+  Dl_info info;
+
+  /* whichever libdroidmedia we are linked against */
+  if (!dladdr ((void *) droid_media_codec_is_supported, &info)) {
+    return gst_droid_codec_probe_file_stamp (NULL);
+  }
+
+  return gst_droid_codec_probe_file_stamp (info.dli_fname);
+}
+
+static gboolean
+gst_droid_codec_probe_cache_valid (GKeyFile * file, const gchar * droidmedia,
+    const gchar * system)
+{
+  gchar *value;
+  gboolean ret;
+
+  if (g_key_file_get_integer (file, GROUP_CACHE, "version", NULL) !=
+      GST_DROID_CODEC_PROBE_CACHE_VERSION) {
+    return FALSE;
+  }
+
+  value = g_key_file_get_string (file, GROUP_CACHE, "plugin-version", NULL);
+  ret = !g_strcmp0 (value, VERSION);
+  g_free (value);
+
+  value = g_key_file_get_string (file, GROUP_CACHE, "droidmedia", NULL);
+  ret &= !g_strcmp0 (value, droidmedia);
+  g_free (value);
+
+  value = g_key_file_get_string (file, GROUP_CACHE, "system", NULL);
+  ret &= !g_strcmp0 (value, system);
+  g_free (value);
+
+  return ret;
+}
+
+/* call with probe_lock held */
+static void
+gst_droid_codec_probe_load (void)
+{
+  gchar *droidmedia;
+  gchar *system;
+
+  if (probe_cache) {
+    return;
+  }
+
+  probe_cache_path = g_build_filename (g_get_user_cache_dir (), "gst-droid",
+      "codecs.cache", NULL);
+  droidmedia = gst_droid_codec_probe_droidmedia_stamp ();
+  system =
+      gst_droid_codec_probe_file_stamp (GST_DROID_CODEC_PROBE_SYSTEM_STAMP);
+
+  probe_cache = g_key_file_new ();
+
+  if (g_key_file_load_from_file (probe_cache, probe_cache_path,
+          G_KEY_FILE_NONE, NULL)
+      && gst_droid_codec_probe_cache_valid (probe_cache, droidmedia, system)) {
+    GST_INFO ("using codec probe cache %s", probe_cache_path);
+  } else {
+    GST_INFO ("codec probe cache %s is missing or stale", probe_cache_path);
+
+    g_key_file_free (probe_cache);
+    probe_cache = g_key_file_new ();
+
+    g_key_file_set_integer (probe_cache, GROUP_CACHE, "version",
+        GST_DROID_CODEC_PROBE_CACHE_VERSION);
+    g_key_file_set_string (probe_cache, GROUP_CACHE, "plugin-version", VERSION);
+    g_key_file_set_string (probe_cache, GROUP_CACHE, "droidmedia", droidmedia);
+    g_key_file_set_string (probe_cache, GROUP_CACHE, "system", system);
+  }
+
+  g_free (droidmedia);
+  g_free (system);
+}
+
+/* call with probe_lock held */
+static void
+gst_droid_codec_probe_save (void)
+{
+  gchar *dir = g_path_get_dirname (probe_cache_path);
+  GError *err = NULL;
+
+  if (g_mkdir_with_parents (dir, 0755) != 0
+      || !g_key_file_save_to_file (probe_cache, probe_cache_path, &err)) {
+    /* not fatal, we will just probe again next time */
+    GST_WARNING ("failed to write codec probe cache %s: %s",
+        probe_cache_path, err ? err->message : g_strerror (errno));
+    g_clear_error (&err);
+  }
+
+  g_free (dir);
+}
+
+gboolean
+gst_droid_codec_probe_is_supported (const gchar * droid, gboolean encoder)
+{
+  const gchar *group = encoder ? GROUP_ENCODERS : GROUP_DECODERS;
+  DroidMediaCodecMetaData md;
+  GError *err = NULL;
+  gboolean supported;
+
+  g_mutex_lock (&probe_lock);
+
+  gst_droid_codec_probe_load ();
+
+  supported = g_key_file_get_boolean (probe_cache, group, droid, &err);
+  if (!err) {
+    GST_DEBUG ("%s %s supported (cached)", droid, supported ? "is" : "is not");
+    goto out;
+  }
+
+  g_clear_error (&err);
+
+  memset (&md, 0x0, sizeof (md));
+  md.type = droid;
+  md.flags = DROID_MEDIA_CODEC_HW_ONLY;
+
+  supported = droid_media_codec_is_supported (&md, encoder);
+
+  GST_INFO ("probed %s: %s", droid, supported ? "supported" : "not supported");
+
+  g_key_file_set_boolean (probe_cache, group, droid, supported);
+  gst_droid_codec_probe_save ();
+
+out:
+  g_mutex_unlock (&probe_lock);
+
+  return supported;
+}
@@ -0,0 +1,38 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2021 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __GST_DROID_CODEC_PROBE_H__
+#define __GST_DROID_CODEC_PROBE_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Answers droid_media_codec_is_supported () for hardware codecs from a
+ * cache file in the user cache directory. The HAL is only asked when the
+ * cache does not know the codec yet or when droidmedia or the system
+ * image changed since the cache was written.
+ */
+gboolean gst_droid_codec_probe_is_supported (const gchar * droid, gboolean encoder);
+
+G_END_DECLS
+
+#endif /* __GST_DROID_CODEC_PROBE_H__ */
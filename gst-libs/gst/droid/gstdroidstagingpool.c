@@ -0,0 +1,283 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2021 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gstdroidstagingpool.h"
+
+GST_DEBUG_CATEGORY_STATIC (droid_staging_pool_debug);
+#define GST_CAT_DEFAULT droid_staging_pool_debug
+
+#define GST_DROID_STAGING_POOL_ALIGN         64
+/* size classes are powers of 2 from 64 bytes to 1MB. Above that every
+ * doubling is split into 8 steps up to 64MB, big enough for a JPEG from a
+ * 40MP+ sensor, so an image never pins more than 12.5% on top of its size */
+#define GST_DROID_STAGING_POOL_MIN_SHIFT     6
+#define GST_DROID_STAGING_POOL_FINE_SHIFT    20
+#define GST_DROID_STAGING_POOL_MAX_SHIFT     26
+#define GST_DROID_STAGING_POOL_STEPS_SHIFT   3
+#define GST_DROID_STAGING_POOL_NUM_COARSE \
+    (GST_DROID_STAGING_POOL_FINE_SHIFT - GST_DROID_STAGING_POOL_MIN_SHIFT + 1)
+#define GST_DROID_STAGING_POOL_NUM_CLASSES \
+    (GST_DROID_STAGING_POOL_NUM_COARSE + \
+    ((GST_DROID_STAGING_POOL_MAX_SHIFT - GST_DROID_STAGING_POOL_FINE_SHIFT) \
+        << GST_DROID_STAGING_POOL_STEPS_SHIFT))
+/* free blocks we keep around per size class */
+#define GST_DROID_STAGING_POOL_MAX_FREE      16
+/* and in total, so a burst of big blocks does not stay around forever */
+#define GST_DROID_STAGING_POOL_MAX_FREE_BYTES (96 * 1024 * 1024)
+
+#define ALIGN_SIZE(size, to) (((size) + to  - 1) & ~(to - 1))
+
+typedef struct _GstDroidStagingBlock GstDroidStagingBlock;
+
+/* lives right in front of the data we hand out */
+struct _GstDroidStagingBlock
+{
+  GstDroidStagingPool *pool;
+  GstDroidStagingBlock *next;
+  gpointer memory;
+  gint size_class;              /* -1 if too big to be recycled */
+};
+
+#define GST_DROID_STAGING_BLOCK_HEADER_SIZE \
+    ALIGN_SIZE (sizeof (GstDroidStagingBlock), GST_DROID_STAGING_POOL_ALIGN)
+
+struct _GstDroidStagingPool
+{
+  gint refcount;
+
+  GMutex lock;
+  GstDroidStagingBlock *free_blocks[GST_DROID_STAGING_POOL_NUM_CLASSES];
+  guint n_free_blocks[GST_DROID_STAGING_POOL_NUM_CLASSES];
+  gsize free_bytes;
+
+  /* statistics, protected by lock */
+  guint64 hits;
+  guint64 misses;
+  guint outstanding;
+  guint high_water;
+};
+
+GstDroidStagingPool *
+gst_droid_staging_pool_new (void)
+{
+  GstDroidStagingPool *pool;
+
+  GST_DEBUG_CATEGORY_INIT (droid_staging_pool_debug, "droidstagingpool", 0,
+      "droid staging pool");
+
+  pool = g_slice_new0 (GstDroidStagingPool);
+  pool->refcount = 1;
+  g_mutex_init (&pool->lock);
+
+  return pool;
+}
+
+GstDroidStagingPool *
+gst_droid_staging_pool_ref (GstDroidStagingPool * pool)
+{
+  g_atomic_int_inc (&pool->refcount);
+
+  return pool;
+}
+
+void
+gst_droid_staging_pool_unref (GstDroidStagingPool * pool)
+{
+  int x;
+
+  if (!g_atomic_int_dec_and_test (&pool->refcount)) {
+    return;
+  }
+
+  GST_DEBUG ("freeing pool %p: %" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT
+      " misses, high water %u", pool, pool->hits, pool->misses,
+      pool->high_water);
+
+  for (x = 0; x < GST_DROID_STAGING_POOL_NUM_CLASSES; x++) {
+    while (pool->free_blocks[x]) {
+      GstDroidStagingBlock *block = pool->free_blocks[x];
+      pool->free_blocks[x] = block->next;
+      g_free (block->memory);
+    }
+  }
+
+  g_mutex_clear (&pool->lock);
+  g_slice_free (GstDroidStagingPool, pool);
+}
+
+static gint
+gst_droid_staging_pool_size_class (gsize size)
+{
+  guint shift = size > 1 ? g_bit_storage (size - 1) : 0;
+  gsize base, step;
+
+  shift = MAX (shift, GST_DROID_STAGING_POOL_MIN_SHIFT);
+
+  if (shift <= GST_DROID_STAGING_POOL_FINE_SHIFT) {
+    return shift - GST_DROID_STAGING_POOL_MIN_SHIFT;
+  }
+
+  if (shift > GST_DROID_STAGING_POOL_MAX_SHIFT) {
+    return -1;
+  }
+
+  /* size is in (base, 2 * base], pick the first step that holds it */
+  base = (gsize) 1 << (shift - 1);
+  step = base >> GST_DROID_STAGING_POOL_STEPS_SHIFT;
+
+  return GST_DROID_STAGING_POOL_NUM_COARSE +
+      ((shift - 1 - GST_DROID_STAGING_POOL_FINE_SHIFT) <<
+      GST_DROID_STAGING_POOL_STEPS_SHIFT) + (size - base + step - 1) / step - 1;
+}
+
+static gsize
+gst_droid_staging_pool_class_size (gint size_class)
+{
+  gsize base;
+  gint steps = 1 << GST_DROID_STAGING_POOL_STEPS_SHIFT;
+
+  if (size_class < GST_DROID_STAGING_POOL_NUM_COARSE) {
+    return (gsize) 1 << (size_class + GST_DROID_STAGING_POOL_MIN_SHIFT);
+  }
+
+  size_class -= GST_DROID_STAGING_POOL_NUM_COARSE;
+  base = (gsize) 1 << (GST_DROID_STAGING_POOL_FINE_SHIFT +
+      (size_class >> GST_DROID_STAGING_POOL_STEPS_SHIFT));
+
+  return base + (base >> GST_DROID_STAGING_POOL_STEPS_SHIFT) *
+      ((size_class & (steps - 1)) + 1);
+}
+
+gpointer
+gst_droid_staging_pool_alloc (GstDroidStagingPool * pool, gsize size)
+{
+  GstDroidStagingBlock *block = NULL;
+  gint size_class = gst_droid_staging_pool_size_class (size);
+  gpointer memory;
+  guint8 *data;
+
+  g_mutex_lock (&pool->lock);
+
+  if (size_class >= 0 && pool->free_blocks[size_class]) {
+    block = pool->free_blocks[size_class];
+    pool->free_blocks[size_class] = block->next;
+    pool->n_free_blocks[size_class]--;
+    pool->free_bytes -= gst_droid_staging_pool_class_size (size_class);
+    pool->hits++;
+  } else {
+    pool->misses++;
+  }
+
+  pool->outstanding++;
+  pool->high_water = MAX (pool->high_water, pool->outstanding);
+
+  g_mutex_unlock (&pool->lock);
+
+  if (!block) {
+    /* Nothing to recycle so we grow */
+    gsize capacity = size_class >= 0 ?
+        gst_droid_staging_pool_class_size (size_class) : size;
+
+    GST_LOG ("allocating block of %" G_GSIZE_FORMAT " bytes", capacity);
+
+    memory = g_malloc (GST_DROID_STAGING_BLOCK_HEADER_SIZE + capacity +
+        GST_DROID_STAGING_POOL_ALIGN - 1);
+    data = (guint8 *) ALIGN_SIZE ((guintptr) memory +
+        GST_DROID_STAGING_BLOCK_HEADER_SIZE, GST_DROID_STAGING_POOL_ALIGN);
+
+    block = (GstDroidStagingBlock *) (data -
+        GST_DROID_STAGING_BLOCK_HEADER_SIZE);
+    block->memory = memory;
+    block->size_class = size_class;
+  }
+
+  block->pool = gst_droid_staging_pool_ref (pool);
+  block->next = NULL;
+
+  return (guint8 *) block + GST_DROID_STAGING_BLOCK_HEADER_SIZE;
+}
+
+void
+gst_droid_staging_pool_release (void *data)
+{
+  GstDroidStagingBlock *block;
+  GstDroidStagingPool *pool;
+
+  block = (GstDroidStagingBlock *) ((guint8 *) data -
+      GST_DROID_STAGING_BLOCK_HEADER_SIZE);
+  pool = block->pool;
+  block->pool = NULL;
+
+  g_mutex_lock (&pool->lock);
+
+  pool->outstanding--;
+
+  if (block->size_class >= 0
+      && pool->n_free_blocks[block->size_class] <
+      GST_DROID_STAGING_POOL_MAX_FREE
+      && pool->free_bytes +
+      gst_droid_staging_pool_class_size (block->size_class) <=
+      GST_DROID_STAGING_POOL_MAX_FREE_BYTES) {
+    block->next = pool->free_blocks[block->size_class];
+    pool->free_blocks[block->size_class] = block;
+    pool->n_free_blocks[block->size_class]++;
+    pool->free_bytes +=
+        gst_droid_staging_pool_class_size (block->size_class);
+    block = NULL;
+  }
+
+  g_mutex_unlock (&pool->lock);
+
+  if (block) {
+    g_free (block->memory);
+  }
+
+  gst_droid_staging_pool_unref (pool);
+}
+
+GstStructure *
+gst_droid_staging_pool_get_stats (GstDroidStagingPool * pool)
+{
+  GstStructure *stats;
+  guint cached = 0;
+  int x;
+
+  g_mutex_lock (&pool->lock);
+
+  for (x = 0; x < GST_DROID_STAGING_POOL_NUM_CLASSES; x++) {
+    cached += pool->n_free_blocks[x];
+  }
+
+  stats = gst_structure_new ("GstDroidStagingPoolStats",
+      "hits", G_TYPE_UINT64, pool->hits,
+      "misses", G_TYPE_UINT64, pool->misses,
+      "outstanding", G_TYPE_UINT, pool->outstanding,
+      "high-water", G_TYPE_UINT, pool->high_water,
+      "cached-blocks", G_TYPE_UINT, cached,
+      "cached-bytes", G_TYPE_UINT64, (guint64) pool->free_bytes, NULL);
+
+  g_mutex_unlock (&pool->lock);
+
+  return stats;
+}
@@ -0,0 +1,44 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2021 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __GST_DROID_STAGING_POOL_H__
+#define __GST_DROID_STAGING_POOL_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstDroidStagingPool GstDroidStagingPool;
+
+GstDroidStagingPool *gst_droid_staging_pool_new (void);
+GstDroidStagingPool *gst_droid_staging_pool_ref (GstDroidStagingPool * pool);
+void gst_droid_staging_pool_unref (GstDroidStagingPool * pool);
+
+/* Blocks are 64 byte aligned and keep the pool alive until released */
+gpointer gst_droid_staging_pool_alloc (GstDroidStagingPool * pool, gsize size);
+
+/* Can be used directly as DroidMediaBufferCallbacks.unref */
+void gst_droid_staging_pool_release (void *data);
+
+GstStructure *gst_droid_staging_pool_get_stats (GstDroidStagingPool * pool);
+
+G_END_DECLS
+
+#endif /* __GST_DROID_STAGING_POOL_H__ */
@@ -0,0 +1,278 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2015-2021 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Times the compressed image callback of droidcamsrc against the fake
+ * camera, for JPEG sizes from a small sensor up to a 40MP+ one. The
+ * callback copies the JPEG into the staging pool, so the time is mostly
+ * that copy, and the HAL can't deliver anything else until it returns.
+ *
+ * The image sink holds on to every image for a while, like a sink writing
+ * it out would, and the next picture is taken while it writes the previous
+ * one, so two images are in flight at once. The pool stats show how many
+ * blocks get recycled and how much memory the cached ones pin.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gstdroidfakecamera.h"
+#include "gstdroidcamsrc.h"
+#include <stdlib.h>
+#include <string.h>             /* memset() */
+
+#define BENCH_SHOTS         20
+#define BENCH_TIMEOUT       (10 * G_TIME_SPAN_SECOND)
+
+#define BENCH_PREVIEW_FPS   30
+#define BENCH_CAPTURE_TIME  (30 * GST_MSECOND)
+#define BENCH_SINK_TIME     (60 * G_TIME_SPAN_MILLISECOND)
+
+#define BENCH_MB            (1024 * 1024)
+
+static const gsize bench_sizes[] = {
+  BENCH_MB / 2, 3 * BENCH_MB, 12 * BENCH_MB, 33 * BENCH_MB
+};
+
+typedef struct
+{
+  GMutex lock;
+  GCond cond;
+  gboolean ready;
+  /* images that made it to the image sink */
+  guint images;
+} BenchState;
+
+static BenchState state;
+
+static void
+bench_ready_notify (GObject * src, GParamSpec * pspec, gpointer user_data)
+{
+  gboolean ready;
+
+  g_object_get (src, "ready-for-capture", &ready, NULL);
+
+  g_mutex_lock (&state.lock);
+  state.ready = ready;
+  g_cond_signal (&state.cond);
+  g_mutex_unlock (&state.lock);
+}
+
+static void
+bench_handoff (GstElement * sink, GstBuffer * buffer, GstPad * pad,
+    gpointer user_data)
+{
+  /* writing the image out */
+  g_usleep (BENCH_SINK_TIME);
+
+  g_mutex_lock (&state.lock);
+  state.images++;
+  g_cond_signal (&state.cond);
+  g_mutex_unlock (&state.lock);
+}
+
+/* until the camera can take the next picture and images left the sink */
+static gboolean
+bench_wait (guint images)
+{
+  gint64 end_time = g_get_monotonic_time () + BENCH_TIMEOUT;
+  gboolean ret = TRUE;
+
+  g_mutex_lock (&state.lock);
+
+  while ((!state.ready || state.images < images) && ret) {
+    ret = g_cond_wait_until (&state.cond, &state.lock, end_time);
+  }
+
+  g_mutex_unlock (&state.lock);
+
+  return ret;
+}
+
+static gint
+bench_compare (gconstpointer a, gconstpointer b)
+{
+  gint64 x = *(const gint64 *) a;
+  gint64 y = *(const gint64 *) b;
+
+  return x < y ? -1 : x > y;
+}
+
+/* the fake camera updates its stats right after the callback returned */
+static gboolean
+bench_wait_delivered (guint pictures, GstDroidFakeCameraStats * stats)
+{
+  gint64 end_time = g_get_monotonic_time () + BENCH_TIMEOUT;
+
+  gst_droid_fake_camera_get_stats (stats);
+
+  while (stats->pictures_delivered < pictures) {
+    if (g_get_monotonic_time () > end_time) {
+      return FALSE;
+    }
+
+    g_usleep (G_TIME_SPAN_MILLISECOND);
+    gst_droid_fake_camera_get_stats (stats);
+  }
+
+  return TRUE;
+}
+
+static void
+bench_pool_stats (GstElement * src, guint64 * hits, guint64 * misses,
+    guint * cached, guint64 * cached_bytes)
+{
+  GstDroidStagingPool *pool = GST_DROIDCAMSRC (src)->dev->image_pool;
+  GstStructure *stats = gst_droid_staging_pool_get_stats (pool);
+
+  gst_structure_get_uint64 (stats, "hits", hits);
+  gst_structure_get_uint64 (stats, "misses", misses);
+  gst_structure_get_uint (stats, "cached-blocks", cached);
+  gst_structure_get_uint64 (stats, "cached-bytes", cached_bytes);
+  gst_structure_free (stats);
+}
+
+static gboolean
+bench_run_size (GstElement * src, gsize size, guint * shots)
+{
+  GstDroidFakeCameraConfig config;
+  GstDroidFakeCameraStats stats;
+  gint64 times[BENCH_SHOTS];
+  guint64 hits, misses, hits_before, misses_before, cached_bytes;
+  guint cached, i;
+
+  memset (&config, 0x0, sizeof (config));
+  config.preview_fps = BENCH_PREVIEW_FPS;
+  config.picture_size = size;
+  config.capture_time = BENCH_CAPTURE_TIME;
+  gst_droid_fake_camera_configure (&config);
+
+  bench_pool_stats (src, &hits_before, &misses_before, &cached,
+      &cached_bytes);
+
+  for (i = 0; i < BENCH_SHOTS; i++) {
+    /* the sink may still be writing the previous image */
+    if (!bench_wait (*shots > 0 ? *shots - 1 : 0)) {
+      g_printerr ("shot %u of %" G_GSIZE_FORMAT " bytes never finished\n", i,
+          size);
+      return FALSE;
+    }
+
+    g_signal_emit_by_name (src, "start-capture");
+    ++*shots;
+
+    if (!bench_wait_delivered (*shots, &stats)) {
+      g_printerr ("shot %u of %" G_GSIZE_FORMAT " bytes never arrived\n", i,
+          size);
+      return FALSE;
+    }
+
+    times[i] = GST_TIME_AS_USECONDS (stats.picture_callback_last);
+  }
+
+  if (!bench_wait (*shots)) {
+    g_printerr ("images of %" G_GSIZE_FORMAT " bytes did not arrive\n", size);
+    return FALSE;
+  }
+
+  bench_pool_stats (src, &hits, &misses, &cached, &cached_bytes);
+
+  qsort (times, BENCH_SHOTS, sizeof (gint64), bench_compare);
+
+  g_print ("%6.1f MB  copy p50 %8.2f ms  p99 %8.2f ms  hits %3"
+      G_GUINT64_FORMAT "  misses %3" G_GUINT64_FORMAT
+      "  cached %2u blocks %6.1f MB\n", (gdouble) size / BENCH_MB,
+      times[BENCH_SHOTS / 2] / 1000.0, times[BENCH_SHOTS * 99 / 100] / 1000.0,
+      hits - hits_before,
+      misses - misses_before, cached, (gdouble) cached_bytes / BENCH_MB);
+
+  return TRUE;
+}
+
+static gboolean
+bench_run (void)
+{
+  GstElement *pipeline, *src, *sink;
+  GError *err = NULL;
+  gboolean ret = FALSE;
+  guint shots = 0, i;
+
+  pipeline = gst_parse_launch ("droidcamsrc name=src "
+      "src.vfsrc ! video/x-raw,format=NV21 ! fakesink sync=false async=false "
+      "src.imgsrc ! fakesink name=img sync=false async=false "
+      "signal-handoffs=true "
+      "src.vidsrc ! fakesink sync=false async=false", &err);
+  if (!pipeline) {
+    g_printerr ("failed to create the pipeline: %s\n", err->message);
+    g_error_free (err);
+    return FALSE;
+  }
+
+  src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "img");
+  g_signal_connect (src, "notify::ready-for-capture",
+      G_CALLBACK (bench_ready_notify), NULL);
+  g_signal_connect (sink, "handoff", G_CALLBACK (bench_handoff), NULL);
+
+  if (gst_element_set_state (pipeline,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+    g_printerr ("failed to start the pipeline\n");
+    goto out;
+  }
+
+  /* the preview is running once we are in PLAYING */
+  bench_ready_notify (G_OBJECT (src), NULL, NULL);
+
+  for (i = 0; i < G_N_ELEMENTS (bench_sizes); i++) {
+    if (!bench_run_size (src, bench_sizes[i], &shots)) {
+      goto out;
+    }
+  }
+
+  ret = TRUE;
+
+out:
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (sink);
+  gst_object_unref (src);
+  gst_object_unref (pipeline);
+
+  return ret;
+}
+
+int
+main (int argc, char *argv[])
+{
+  gboolean ret = FALSE;
+
+  gst_init (&argc, &argv);
+
+  g_mutex_init (&state.lock);
+  g_cond_init (&state.cond);
+
+  if (!gst_droid_fake_camera_register_elements ()) {
+    g_printerr ("failed to register the elements\n");
+  } else {
+    ret = bench_run ();
+  }
+
+  return ret ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,463 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2015-2021 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Times the handoff of viewfinder frames from a HAL thread to the pad task
+ * of droidcamsrc at 120 and 240 fps, and as fast as frames can be queued.
+ *
+ * The current vfsrc pad is run next to a copy of the handoff it replaced,
+ * which took the pad lock up to four times and the object lock once per
+ * buffer, and woke the task up for every frame whether it was asleep or
+ * not. Latency runs from queueing a frame to the sink getting it, enqueue
+ * is the time the HAL thread spends queueing it, so that is where the
+ * contention with the task shows. CPU time and context switches are for
+ * the whole process, per frame.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gstdroidfakecamera.h"
+#include "gstdroidcamsrc.h"
+#include <stdlib.h>
+#include <sys/resource.h>       /* getrusage() */
+
+#define BENCH_FRAMES        1200
+#define BENCH_TIMEOUT       (10 * G_TIME_SPAN_SECOND)
+
+/* 0 queues frames as fast as it can */
+static const guint bench_rates[] = { 120, 240, 0 };
+
+typedef void (*BenchQueueFunc) (gpointer pad, GstBuffer * buffer);
+
+typedef struct
+{
+  GMutex lock;
+  GCond cond;
+  gboolean done;
+
+  /* only written by the streaming thread until done */
+  guint frames;
+  gint64 latency[BENCH_FRAMES];
+  gint64 enqueue[BENCH_FRAMES];
+} BenchState;
+
+static BenchState state;
+
+/* the pad task handoff before the lock traffic was cut */
+typedef struct
+{
+  GstElement *parent;
+  GstPad *pad;
+  GQueue *queue;
+  GCond cond;
+  GMutex lock;
+  gboolean running;
+  gboolean open_stream;
+  gboolean open_segment;
+  guint pushed_buffers;
+  GstSegment segment;
+  GList *pending_events;
+} BenchOldPad;
+
+static void
+bench_old_loop (gpointer user_data)
+{
+  BenchOldPad *data = (BenchOldPad *) user_data;
+  GstBuffer *buffer;
+  GList *events, *tmp;
+
+  g_mutex_lock (&data->lock);
+
+  if (!data->running) {
+    g_mutex_unlock (&data->lock);
+    return;
+  }
+
+  g_mutex_unlock (&data->lock);
+
+  if (G_UNLIKELY (data->open_stream)) {
+    gchar *stream_id;
+    GstEvent *event;
+
+    stream_id = gst_pad_create_stream_id (data->pad, data->parent, "src");
+    event = gst_event_new_stream_start (stream_id);
+    gst_event_set_group_id (event, gst_util_group_id_next ());
+    gst_pad_push_event (data->pad, event);
+
+    g_free (stream_id);
+    data->open_stream = FALSE;
+  }
+
+  g_mutex_lock (&data->lock);
+
+  if (!data->running) {
+    g_mutex_unlock (&data->lock);
+    return;
+  }
+
+  buffer = g_queue_pop_head (data->queue);
+  if (!buffer) {
+    g_cond_wait (&data->cond, &data->lock);
+    buffer = g_queue_pop_head (data->queue);
+  }
+
+  g_mutex_unlock (&data->lock);
+
+  if (!buffer) {
+    return;
+  }
+
+  if (G_UNLIKELY (data->open_segment)) {
+    gst_pad_push_event (data->pad, gst_event_new_segment (&data->segment));
+    data->open_segment = FALSE;
+  }
+
+  GST_OBJECT_LOCK (data->parent);
+  g_mutex_lock (&data->lock);
+  events = data->pending_events;
+  data->pending_events = NULL;
+  g_mutex_unlock (&data->lock);
+  GST_OBJECT_UNLOCK (data->parent);
+
+  for (tmp = events; tmp; tmp = g_list_next (tmp)) {
+    gst_pad_push_event (data->pad, (GstEvent *) tmp->data);
+  }
+  g_list_free (events);
+
+  gst_pad_push (data->pad, buffer);
+
+  g_mutex_lock (&data->lock);
+  data->pushed_buffers++;
+  g_mutex_unlock (&data->lock);
+}
+
+static void
+bench_old_queue_buffer (gpointer pad, GstBuffer * buffer)
+{
+  BenchOldPad *data = (BenchOldPad *) pad;
+
+  g_mutex_lock (&data->lock);
+  g_queue_push_tail (data->queue, buffer);
+  g_cond_signal (&data->cond);
+  g_mutex_unlock (&data->lock);
+}
+
+static gboolean
+bench_old_start (BenchOldPad * data, GstPad * sinkpad)
+{
+  data->parent = gst_bin_new ("old");
+  data->pad = gst_pad_new ("src", GST_PAD_SRC);
+  gst_element_add_pad (data->parent, data->pad);
+
+  data->queue = g_queue_new ();
+  g_mutex_init (&data->lock);
+  g_cond_init (&data->cond);
+  gst_segment_init (&data->segment, GST_FORMAT_TIME);
+  data->pending_events = NULL;
+  data->pushed_buffers = 0;
+  data->running = TRUE;
+  data->open_stream = TRUE;
+  data->open_segment = TRUE;
+
+  if (gst_pad_link (data->pad, sinkpad) != GST_PAD_LINK_OK
+      || !gst_pad_set_active (data->pad, TRUE)) {
+    return FALSE;
+  }
+
+  return gst_pad_start_task (data->pad, bench_old_loop, data, NULL);
+}
+
+static void
+bench_old_stop (BenchOldPad * data)
+{
+  g_mutex_lock (&data->lock);
+  data->running = FALSE;
+  g_cond_signal (&data->cond);
+  g_mutex_unlock (&data->lock);
+
+  gst_pad_stop_task (data->pad);
+  gst_pad_set_active (data->pad, FALSE);
+
+  g_queue_free_full (data->queue, (GDestroyNotify) gst_buffer_unref);
+  g_mutex_clear (&data->lock);
+  g_cond_clear (&data->cond);
+  gst_object_unref (data->parent);
+}
+
+static void
+bench_current_queue_buffer (gpointer pad, GstBuffer * buffer)
+{
+  gst_droidcamsrc_pad_queue_buffer ((GstDroidCamSrcPad *) pad, buffer);
+}
+
+static void
+bench_handoff (GstElement * sink, GstBuffer * buffer, GstPad * pad,
+    gpointer user_data)
+{
+  if (state.frames < BENCH_FRAMES) {
+    state.latency[state.frames] =
+        gst_util_get_timestamp () - GST_BUFFER_OFFSET (buffer);
+  }
+
+  if (++state.frames == BENCH_FRAMES) {
+    g_mutex_lock (&state.lock);
+    state.done = TRUE;
+    g_cond_signal (&state.cond);
+    g_mutex_unlock (&state.lock);
+  }
+}
+
+static gboolean
+bench_wait_done (void)
+{
+  gint64 end_time = g_get_monotonic_time () + BENCH_TIMEOUT;
+  gboolean ret = TRUE;
+
+  g_mutex_lock (&state.lock);
+
+  while (!state.done && ret) {
+    ret = g_cond_wait_until (&state.cond, &state.lock, end_time);
+  }
+
+  g_mutex_unlock (&state.lock);
+
+  return ret;
+}
+
+static gint
+bench_compare (gconstpointer a, gconstpointer b)
+{
+  gint64 x = *(const gint64 *) a;
+  gint64 y = *(const gint64 *) b;
+
+  return x < y ? -1 : x > y;
+}
+
+static gint64
+bench_cpu_time (const struct rusage *usage)
+{
+  return (gint64) (usage->ru_utime.tv_sec + usage->ru_stime.tv_sec) *
+      G_USEC_PER_SEC + usage->ru_utime.tv_usec + usage->ru_stime.tv_usec;
+}
+
+static gboolean
+bench_run_rate (const gchar * name, BenchQueueFunc queue, gpointer pad,
+    guint fps)
+{
+  struct rusage before, after;
+  gint64 start, deadline, now;
+  GstClockTime stamp;
+  gchar rate[8];
+  glong switches;
+  guint i;
+
+  g_mutex_lock (&state.lock);
+  state.done = FALSE;
+  state.frames = 0;
+  g_mutex_unlock (&state.lock);
+
+  getrusage (RUSAGE_SELF, &before);
+  start = g_get_monotonic_time ();
+
+  for (i = 0; i < BENCH_FRAMES; i++) {
+    GstBuffer *buffer = gst_buffer_new ();
+
+    if (fps > 0) {
+      deadline = start + i * G_TIME_SPAN_SECOND / fps;
+      now = g_get_monotonic_time ();
+      if (deadline > now) {
+        g_usleep (deadline - now);
+      }
+    }
+
+    stamp = gst_util_get_timestamp ();
+    GST_BUFFER_OFFSET (buffer) = stamp;
+    queue (pad, buffer);
+    state.enqueue[i] = gst_util_get_timestamp () - stamp;
+  }
+
+  if (!bench_wait_done ()) {
+    g_printerr ("%s at %u fps: only %u of %u frames arrived\n", name, fps,
+        state.frames, BENCH_FRAMES);
+    return FALSE;
+  }
+
+  getrusage (RUSAGE_SELF, &after);
+  switches = (after.ru_nvcsw - before.ru_nvcsw) +
+      (after.ru_nivcsw - before.ru_nivcsw);
+
+  qsort (state.latency, BENCH_FRAMES, sizeof (gint64), bench_compare);
+  qsort (state.enqueue, BENCH_FRAMES, sizeof (gint64), bench_compare);
+
+  if (fps > 0) {
+    g_snprintf (rate, sizeof (rate), "%u", fps);
+  } else {
+    g_strlcpy (rate, "max", sizeof (rate));
+  }
+
+  g_print ("%-7s %3s fps  latency p50 %7.2f us  p99 %7.2f us  "
+      "enqueue p50 %6.2f us  p99 %6.2f us  cpu %6.2f us  switches %5.2f "
+      "per frame\n", name, rate,
+      state.latency[BENCH_FRAMES / 2] / 1000.0,
+      state.latency[BENCH_FRAMES * 99 / 100] / 1000.0,
+      state.enqueue[BENCH_FRAMES / 2] / 1000.0,
+      state.enqueue[BENCH_FRAMES * 99 / 100] / 1000.0,
+      (gdouble) (bench_cpu_time (&after) - bench_cpu_time (&before)) /
+      BENCH_FRAMES, (gdouble) switches / BENCH_FRAMES);
+
+  return TRUE;
+}
+
+static GstElement *
+bench_sink_new (void)
+{
+  GstElement *sink = gst_element_factory_make ("fakesink", NULL);
+
+  if (!sink) {
+    return NULL;
+  }
+
+  g_object_set (sink, "sync", FALSE, "async", FALSE, "signal-handoffs", TRUE,
+      NULL);
+  g_signal_connect (sink, "handoff", G_CALLBACK (bench_handoff), NULL);
+
+  if (gst_element_set_state (sink,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+    gst_object_unref (sink);
+    return NULL;
+  }
+
+  return sink;
+}
+
+static gboolean
+bench_run_old (void)
+{
+  BenchOldPad data;
+  GstElement *sink;
+  GstPad *sinkpad;
+  gboolean ret = FALSE;
+  guint i;
+
+  sink = bench_sink_new ();
+  if (!sink) {
+    g_printerr ("failed to create the sink\n");
+    return FALSE;
+  }
+
+  sinkpad = gst_element_get_static_pad (sink, "sink");
+
+  if (!bench_old_start (&data, sinkpad)) {
+    g_printerr ("failed to start the old handoff\n");
+    goto out;
+  }
+
+  for (i = 0; i < G_N_ELEMENTS (bench_rates); i++) {
+    if (!bench_run_rate ("old", bench_old_queue_buffer, &data,
+            bench_rates[i])) {
+      goto out;
+    }
+  }
+
+  ret = TRUE;
+
+out:
+  bench_old_stop (&data);
+  gst_object_unref (sinkpad);
+  gst_element_set_state (sink, GST_STATE_NULL);
+  gst_object_unref (sink);
+
+  return ret;
+}
+
+static gboolean
+bench_run_current (void)
+{
+  GstElement *src, *sink;
+  GstDroidCamSrcPad *vfsrc;
+  GstPad *sinkpad;
+  gboolean ret = FALSE;
+  guint i;
+
+  src = gst_element_factory_make ("droidcamsrc", NULL);
+  sink = bench_sink_new ();
+  if (!src || !sink) {
+    g_printerr ("failed to create the elements\n");
+    if (src) {
+      gst_object_unref (src);
+    }
+    if (sink) {
+      gst_object_unref (sink);
+    }
+    return FALSE;
+  }
+
+  /* unbounded like the old queue, so nothing is ever dropped */
+  g_object_set (src, "vfsrc-max-queue-depth", 0, NULL);
+
+  /* only the pad task runs, the camera is never opened */
+  vfsrc = GST_DROIDCAMSRC (src)->vfsrc;
+  sinkpad = gst_element_get_static_pad (sink, "sink");
+
+  if (gst_pad_link (vfsrc->pad, sinkpad) != GST_PAD_LINK_OK
+      || !gst_pad_set_active (vfsrc->pad, TRUE)) {
+    g_printerr ("failed to start the viewfinder pad\n");
+    goto out;
+  }
+
+  for (i = 0; i < G_N_ELEMENTS (bench_rates); i++) {
+    if (!bench_run_rate ("current", bench_current_queue_buffer, vfsrc,
+            bench_rates[i])) {
+      goto out;
+    }
+  }
+
+  ret = TRUE;
+
+out:
+  gst_pad_set_active (vfsrc->pad, FALSE);
+  gst_object_unref (sinkpad);
+  gst_element_set_state (sink, GST_STATE_NULL);
+  gst_object_unref (sink);
+  gst_object_unref (src);
+
+  return ret;
+}
+
+int
+main (int argc, char *argv[])
+{
+  gboolean ret = FALSE;
+
+  gst_init (&argc, &argv);
+
+  g_mutex_init (&state.lock);
+  g_cond_init (&state.cond);
+
+  if (!gst_droid_fake_camera_register_elements ()) {
+    g_printerr ("failed to register the elements\n");
+  } else {
+    ret = bench_run_old () && bench_run_current ();
+  }
+
+  return ret ? EXIT_SUCCESS : EXIT_FAILURE;
+}
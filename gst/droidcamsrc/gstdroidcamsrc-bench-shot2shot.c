@@ -0,0 +1,204 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2015-2021 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Times shot to shot latency of non-ZSL captures in droidcamsrc against
+ * the fake camera. Every capture is started as soon as ready-for-capture
+ * comes back, and the time runs from one start-capture to the next. The
+ * fake camera refuses a picture while its preview is not running, so a
+ * refused picture means ready-for-capture was reported too early.
+ *
+ * The camera takes as long to take a picture and to restart its preview
+ * as camera1 HALs tend to, so the floor printed is what the HAL costs and
+ * the rest is ours.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gstdroidfakecamera.h"
+#include <stdlib.h>
+#include <string.h>             /* memset() */
+
+#define BENCH_SHOTS         50
+#define BENCH_TIMEOUT       (10 * G_TIME_SPAN_SECOND)
+
+#define BENCH_PREVIEW_FPS   30
+#define BENCH_PICTURE_SIZE  (8 * 1024 * 1024)
+#define BENCH_CAPTURE_TIME  (150 * GST_MSECOND)
+#define BENCH_START_TIME    (40 * GST_MSECOND)
+
+typedef struct
+{
+  GMutex lock;
+  GCond cond;
+  gboolean ready;
+} BenchState;
+
+static BenchState state;
+
+static void
+bench_ready_notify (GObject * src, GParamSpec * pspec, gpointer user_data)
+{
+  gboolean ready;
+
+  g_object_get (src, "ready-for-capture", &ready, NULL);
+
+  g_mutex_lock (&state.lock);
+  state.ready = ready;
+  g_cond_signal (&state.cond);
+  g_mutex_unlock (&state.lock);
+}
+
+static gboolean
+bench_wait_ready (void)
+{
+  gint64 end_time = g_get_monotonic_time () + BENCH_TIMEOUT;
+  gboolean ret = TRUE;
+
+  g_mutex_lock (&state.lock);
+
+  while (!state.ready && ret) {
+    ret = g_cond_wait_until (&state.cond, &state.lock, end_time);
+  }
+
+  g_mutex_unlock (&state.lock);
+
+  return ret;
+}
+
+static gint
+bench_compare (gconstpointer a, gconstpointer b)
+{
+  gint64 x = *(const gint64 *) a;
+  gint64 y = *(const gint64 *) b;
+
+  return x < y ? -1 : x > y;
+}
+
+static gboolean
+bench_run (void)
+{
+  GstElement *pipeline, *src;
+  GstDroidFakeCameraStats stats;
+  GError *err = NULL;
+  gint64 times[BENCH_SHOTS], start, last;
+  gboolean ret = FALSE;
+  guint i;
+
+  pipeline = gst_parse_launch ("droidcamsrc name=src "
+      "src.vfsrc ! video/x-raw,format=NV21 ! fakesink sync=false async=false "
+      "src.imgsrc ! fakesink sync=false async=false "
+      "src.vidsrc ! fakesink sync=false async=false", &err);
+  if (!pipeline) {
+    g_printerr ("failed to create the pipeline: %s\n", err->message);
+    g_error_free (err);
+    return FALSE;
+  }
+
+  src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  g_signal_connect (src, "notify::ready-for-capture",
+      G_CALLBACK (bench_ready_notify), NULL);
+
+  if (gst_element_set_state (pipeline,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+    g_printerr ("failed to start the pipeline\n");
+    goto out;
+  }
+
+  bench_ready_notify (G_OBJECT (src), NULL, NULL);
+  if (!bench_wait_ready ()) {
+    g_printerr ("never ready for the first capture\n");
+    goto out;
+  }
+
+  gst_droid_fake_camera_reset_stats ();
+
+  last = g_get_monotonic_time ();
+  g_signal_emit_by_name (src, "start-capture");
+
+  for (i = 0; i < BENCH_SHOTS; i++) {
+    if (!bench_wait_ready ()) {
+      g_printerr ("never ready after shot %u\n", i);
+      goto out;
+    }
+
+    start = g_get_monotonic_time ();
+    times[i] = start - last;
+    last = start;
+
+    /* and the last one has to finish before we stop */
+    if (i + 1 < BENCH_SHOTS) {
+      g_signal_emit_by_name (src, "start-capture");
+    }
+  }
+
+  gst_droid_fake_camera_get_stats (&stats);
+
+  qsort (times, BENCH_SHOTS, sizeof (gint64), bench_compare);
+
+  g_print ("shot-to-shot p50 %8.2f ms  p99 %8.2f ms  floor %8.2f ms  "
+      "taken %3u  refused %3u\n", times[BENCH_SHOTS / 2] / 1000.0,
+      times[BENCH_SHOTS * 99 / 100] / 1000.0,
+      (gdouble) (BENCH_CAPTURE_TIME + BENCH_START_TIME) / GST_MSECOND,
+      stats.pictures_taken, stats.pictures_refused);
+
+  if (stats.pictures_refused > 0) {
+    g_printerr ("ready-for-capture came before the camera was ready\n");
+    goto out;
+  }
+
+  ret = TRUE;
+
+out:
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (src);
+  gst_object_unref (pipeline);
+
+  return ret;
+}
+
+int
+main (int argc, char *argv[])
+{
+  GstDroidFakeCameraConfig config;
+  gboolean ret = FALSE;
+
+  gst_init (&argc, &argv);
+
+  g_mutex_init (&state.lock);
+  g_cond_init (&state.cond);
+
+  memset (&config, 0x0, sizeof (config));
+  config.preview_fps = BENCH_PREVIEW_FPS;
+  config.start_preview_time = BENCH_START_TIME;
+  config.picture_size = BENCH_PICTURE_SIZE;
+  config.capture_time = BENCH_CAPTURE_TIME;
+  gst_droid_fake_camera_configure (&config);
+
+  if (!gst_droid_fake_camera_register_elements ()) {
+    g_printerr ("failed to register the elements\n");
+  } else {
+    ret = bench_run ();
+  }
+
+  return ret ? EXIT_SUCCESS : EXIT_FAILURE;
+}
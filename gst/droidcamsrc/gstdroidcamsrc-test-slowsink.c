@@ -0,0 +1,254 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2015-2021 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Runs the viewfinder of droidcamsrc against the fake camera into a sink
+ * that takes far longer per frame than the camera takes to deliver one.
+ * With the queue bounded the frames reaching the sink may only be as old
+ * as the queue is deep, the frames that do not fit have to be reported
+ * as QoS drops, and the preview callback must not be held up by the sink
+ * for longer than the leaky policy allows. Every policy is run in turn.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gstdroidfakecamera.h"
+#include "gstdroidcamsrcenums.h"
+#include <stdlib.h>
+#include <string.h>             /* memset() */
+
+#define TEST_RUN_TIME       (2 * GST_SECOND)
+#define TEST_PREVIEW_FPS    60
+#define TEST_SINK_TIME      (100 * G_TIME_SPAN_MILLISECOND)
+#define TEST_QUEUE_DEPTH    3
+
+/* half of what the sink could take in the time given */
+#define TEST_MIN_FRAMES \
+  (TEST_RUN_TIME / (TEST_SINK_TIME * GST_USECOND) / 2)
+
+/* a frame waits for the frames queued before it and the one in the sink */
+#define TEST_MAX_LATENCY \
+  ((TEST_QUEUE_DEPTH + 2) * TEST_SINK_TIME * GST_USECOND)
+
+/* copying a frame and queueing it, with a lot of room for a loaded box */
+#define TEST_CALLBACK_TIME  (50 * GST_MSECOND)
+/* GST_DROIDCAMSRC_QUEUE_WAIT_TIMEOUT */
+#define TEST_WAIT_TIMEOUT   (200 * GST_MSECOND)
+
+typedef struct
+{
+  const gchar *name;
+  GstDroidCamSrcQueueLeaky leaky;
+  /* the longest the preview callback may take */
+  GstClockTime callback_max;
+  /* whether drops have to be reported. The sink frees a slot well within
+   * the wait timeout, so with wait the camera loses the frames instead */
+  gboolean drops;
+} TestCase;
+
+static const TestCase test_cases[] = {
+  {"drop-oldest", GST_DROIDCAMSRC_QUEUE_LEAKY_DROP_OLDEST, TEST_CALLBACK_TIME,
+      TRUE},
+  {"drop-newest", GST_DROIDCAMSRC_QUEUE_LEAKY_DROP_NEWEST, TEST_CALLBACK_TIME,
+      TRUE},
+  {"wait", GST_DROIDCAMSRC_QUEUE_LEAKY_WAIT,
+      TEST_WAIT_TIMEOUT + TEST_CALLBACK_TIME, FALSE},
+};
+
+typedef struct
+{
+  GMutex lock;
+  guint frames;
+  GstClockTime latency_max;
+} TestState;
+
+static TestState state;
+
+static void
+test_handoff (GstElement * sink, GstBuffer * buffer, GstPad * pad,
+    gpointer user_data)
+{
+  GstClock *clock = gst_element_get_clock (sink);
+  GstClockTime now, latency = 0;
+
+  if (clock && GST_BUFFER_PTS_IS_VALID (buffer)) {
+    now = gst_clock_get_time (clock) - gst_element_get_base_time (sink);
+    if (now > GST_BUFFER_PTS (buffer)) {
+      latency = now - GST_BUFFER_PTS (buffer);
+    }
+  }
+
+  if (clock) {
+    gst_object_unref (clock);
+  }
+
+  g_mutex_lock (&state.lock);
+  state.frames++;
+  state.latency_max = MAX (state.latency_max, latency);
+  g_mutex_unlock (&state.lock);
+
+  /* a sink that can't keep up */
+  g_usleep (TEST_SINK_TIME);
+}
+
+static gboolean
+test_run_case (const TestCase * test)
+{
+  GstElement *pipeline, *src, *sink;
+  GstDroidFakeCameraStats stats;
+  GstMessage *msg;
+  GstBus *bus;
+  GError *err = NULL;
+  GstClockTime end_time, now;
+  guint64 processed, dropped = 0;
+  gboolean ret = FALSE;
+
+  pipeline = gst_parse_launch ("droidcamsrc name=src "
+      "src.vfsrc ! video/x-raw,format=NV21 ! fakesink name=vf sync=false "
+      "async=false signal-handoffs=true "
+      "src.imgsrc ! fakesink sync=false async=false "
+      "src.vidsrc ! fakesink sync=false async=false", &err);
+  if (!pipeline) {
+    g_printerr ("failed to create the pipeline: %s\n", err->message);
+    g_error_free (err);
+    return FALSE;
+  }
+
+  src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "vf");
+  bus = gst_element_get_bus (pipeline);
+
+  g_object_set (src, "vfsrc-max-queue-depth", TEST_QUEUE_DEPTH,
+      "vfsrc-leaky", test->leaky, NULL);
+  g_signal_connect (sink, "handoff", G_CALLBACK (test_handoff), NULL);
+
+  g_mutex_lock (&state.lock);
+  state.frames = 0;
+  state.latency_max = 0;
+  g_mutex_unlock (&state.lock);
+
+  gst_droid_fake_camera_reset_stats ();
+
+  if (gst_element_set_state (pipeline,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+    g_printerr ("%s: failed to start the pipeline\n", test->name);
+    goto out;
+  }
+
+  end_time = gst_util_get_timestamp () + TEST_RUN_TIME;
+
+  while ((now = gst_util_get_timestamp ()) < end_time) {
+    msg = gst_bus_timed_pop_filtered (bus, end_time - now,
+        GST_MESSAGE_QOS | GST_MESSAGE_ERROR);
+    if (!msg) {
+      continue;
+    }
+
+    if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+      gst_message_parse_error (msg, &err, NULL);
+      g_printerr ("%s: pipeline error: %s\n", test->name, err->message);
+      g_error_free (err);
+      gst_message_unref (msg);
+      goto out;
+    }
+
+    if (GST_MESSAGE_SRC (msg) == GST_OBJECT (src)) {
+      /* the counts are running totals */
+      gst_message_parse_qos_stats (msg, NULL, &processed, &dropped);
+    }
+
+    gst_message_unref (msg);
+  }
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_droid_fake_camera_get_stats (&stats);
+
+  g_print ("%-11s frames %3u of %3u  latency max %7.2f ms  dropped %3"
+      G_GUINT64_FORMAT "  callback max %7.2f ms\n", test->name, state.frames,
+      stats.preview_frames, (gdouble) state.latency_max / GST_MSECOND,
+      dropped, (gdouble) stats.preview_callback_max / GST_MSECOND);
+
+  ret = TRUE;
+
+  if (state.frames < TEST_MIN_FRAMES) {
+    g_printerr ("%s: only %u frames reached the sink\n", test->name,
+        state.frames);
+    ret = FALSE;
+  }
+
+  if (state.latency_max > TEST_MAX_LATENCY) {
+    g_printerr ("%s: a frame was %" GST_TIME_FORMAT " old, more than %"
+        GST_TIME_FORMAT "\n", test->name, GST_TIME_ARGS (state.latency_max),
+        GST_TIME_ARGS (TEST_MAX_LATENCY));
+    ret = FALSE;
+  }
+
+  if (test->drops && dropped == 0) {
+    g_printerr ("%s: no dropped frames were reported\n", test->name);
+    ret = FALSE;
+  }
+
+  if (stats.preview_callback_max > test->callback_max) {
+    g_printerr ("%s: the preview callback took %" GST_TIME_FORMAT
+        ", more than %" GST_TIME_FORMAT "\n", test->name,
+        GST_TIME_ARGS (stats.preview_callback_max),
+        GST_TIME_ARGS (test->callback_max));
+    ret = FALSE;
+  }
+
+out:
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (bus);
+  gst_object_unref (sink);
+  gst_object_unref (src);
+  gst_object_unref (pipeline);
+
+  return ret;
+}
+
+int
+main (int argc, char *argv[])
+{
+  GstDroidFakeCameraConfig config;
+  gboolean ret = FALSE;
+  guint i;
+
+  gst_init (&argc, &argv);
+
+  g_mutex_init (&state.lock);
+
+  memset (&config, 0x0, sizeof (config));
+  config.preview_fps = TEST_PREVIEW_FPS;
+  gst_droid_fake_camera_configure (&config);
+
+  if (!gst_droid_fake_camera_register_elements ()) {
+    g_printerr ("failed to register the elements\n");
+  } else {
+    ret = TRUE;
+
+    for (i = 0; i < G_N_ELEMENTS (test_cases); i++) {
+      ret = test_run_case (&test_cases[i]) && ret;
+    }
+  }
+
+  return ret ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -109,6 +109,8 @@ enum
 static guint droidcamsrc_signals[LAST_SIGNAL];
 
 #define DEFAULT_CAMERA_DEVICE          0
+/* the real count is only known once droidmedia is up */
+#define MAX_CAMERA_DEVICE              31
 #define DEFAULT_MODE                   MODE_IMAGE
 #define DEFAULT_MAX_ZOOM               10.0f
 #define DEFAULT_VIDEO_TORCH            FALSE
@@ -121,6 +123,20 @@ static guint droidcamsrc_signals[LAST_SIGNAL];
 #define DEFAULT_IMAGE_MODE             GST_DROIDCAMSRC_IMAGE_MODE_NORMAL
 #define DEFAULT_TARGET_BITRATE         12000000
 #define DEFAULT_POST_PREVIEW           FALSE
+#define DEFAULT_RAW_PREVIEW_MIN_BUFFERS 2
+#define DEFAULT_RAW_PREVIEW_MAX_BUFFERS 6
+#define DEFAULT_BURST_COUNT            5
+#define DEFAULT_VFSRC_MAX_QUEUE_DEPTH  3
+#define DEFAULT_VFSRC_LEAKY            GST_DROIDCAMSRC_QUEUE_LEAKY_DROP_OLDEST
+#define DEFAULT_VIDSRC_MAX_QUEUE_DEPTH 0
+#define DEFAULT_VIDSRC_LEAKY           GST_DROIDCAMSRC_QUEUE_LEAKY_WAIT
+
+/*
+ * How long a producer may wait for room with the wait policy before the
+ * incoming frame is dropped. Producers are HAL threads so this has to stay
+ * short.
+ */
+#define GST_DROIDCAMSRC_QUEUE_WAIT_TIMEOUT   (200 * G_TIME_SPAN_MILLISECOND)
 
 static GstDroidCamSrcPad *
 gst_droidcamsrc_create_pad (GstDroidCamSrc * src,
@@ -142,11 +158,17 @@ gst_droidcamsrc_create_pad (GstDroidCamSrc * src,
 
   g_mutex_init (&pad->lock);
   g_cond_init (&pad->cond);
+  g_cond_init (&pad->space_cond);
   pad->queue = g_queue_new ();
   pad->running = FALSE;
   pad->negotiate = NULL;
   pad->capture_pad = capture_pad;
   pad->pushed_buffers = 0;
+  pad->waiting = FALSE;
+  pad->max_queue_depth = 0;
+  pad->leaky = GST_DROIDCAMSRC_QUEUE_LEAKY_DROP_OLDEST;
+  pad->dropped_buffers = 0;
+  pad->producers_waiting = 0;
   pad->adjust_segment = FALSE;
   pad->pending_events = NULL;
   gst_segment_init (&pad->segment, GST_FORMAT_TIME);
@@ -162,6 +184,7 @@ gst_droidcamsrc_destroy_pad (GstDroidCamSrcPad * pad)
   /* we don't destroy the pad itself */
   g_mutex_clear (&pad->lock);
   g_cond_clear (&pad->cond);
+  g_cond_clear (&pad->space_cond);
   g_queue_free (pad->queue);
   g_slice_free (GstDroidCamSrcPad, pad);
 }
@@ -173,6 +196,7 @@ gst_droidcamsrc_init (GstDroidCamSrc * src)
   g_rec_mutex_init (&src->dev_lock);
   src->dev = NULL;
   src->info = NULL;
+  src->num_cameras = 0;
   src->camera_device = DEFAULT_CAMERA_DEVICE;
   src->mode = DEFAULT_MODE;
   src->captures = 0;
@@ -190,6 +214,9 @@ gst_droidcamsrc_init (GstDroidCamSrc * src)
   src->fps_n = 0;
   src->fps_d = 1;
   src->target_bitrate = DEFAULT_TARGET_BITRATE;
+  src->raw_preview_min_buffers = DEFAULT_RAW_PREVIEW_MIN_BUFFERS;
+  src->raw_preview_max_buffers = DEFAULT_RAW_PREVIEW_MAX_BUFFERS;
+  src->burst_count = DEFAULT_BURST_COUNT;
 
   gst_droidcamsrc_photography_init (src);
 
@@ -206,6 +233,11 @@ gst_droidcamsrc_init (GstDroidCamSrc * src)
   src->vidsrc->adjust_segment = TRUE;
   src->vidsrc->negotiate = gst_droidcamsrc_vidsrc_negotiate;
 
+  src->vfsrc->max_queue_depth = DEFAULT_VFSRC_MAX_QUEUE_DEPTH;
+  src->vfsrc->leaky = DEFAULT_VFSRC_LEAKY;
+  src->vidsrc->max_queue_depth = DEFAULT_VIDSRC_MAX_QUEUE_DEPTH;
+  src->vidsrc->leaky = DEFAULT_VIDSRC_LEAKY;
+
   /* create the modes after we create the pads because the modes need the pads */
   src->image = gst_droidcamsrc_mode_new_image (src);
   src->video = gst_droidcamsrc_mode_new_video (src);
@@ -279,13 +311,19 @@ gst_droidcamsrc_get_property (GObject * object, guint prop_id, GValue * value,
       break;
 
     case PROP_SENSOR_DIRECTION:
-      g_value_set_int (value, src->info[src->camera_device].direction);
+      if (!gst_droidcamsrc_get_hw (src)
+          || src->camera_device >= src->num_cameras) {
+        g_value_set_int (value, DEFAULT_SENSOR_DIRECTION);
+      } else {
+        g_value_set_int (value, src->info[src->camera_device].direction);
+      }
       break;
 
     case PROP_SENSOR_MOUNT_ANGLE:
     case PROP_SENSOR_ORIENTATION:
-      if (!gst_droidcamsrc_get_hw (src)) {
-        g_value_set_int (value, 0);
+      if (!gst_droidcamsrc_get_hw (src)
+          || src->camera_device >= src->num_cameras) {
+        g_value_set_int (value, DEFAULT_SENSOR_ORIENTATION);
       } else {
         g_value_set_int (value, src->info[src->camera_device].orientation * 90);
       }
@@ -315,6 +353,16 @@ gst_droidcamsrc_get_property (GObject * object, guint prop_id, GValue * value,
         g_array_append_val (supported_image_modes, mode);
       }
 
+      /* burst is driven by us so it is always there */
+      mode = GST_DROIDCAMSRC_IMAGE_MODE_BURST;
+      g_array_append_val (supported_image_modes, mode);
+
+      if (gst_droidcamsrc_quirks_get_quirk (src->quirks, "zsl")) {
+        mode = GST_DROIDCAMSRC_IMAGE_MODE_ZSL;
+        mode |= GST_DROIDCAMSRC_IMAGE_MODE_BURST;
+        g_array_append_val (supported_image_modes, mode);
+      }
+
       g_value_set_pointer (value, supported_image_modes);
       break;
 
@@ -322,6 +370,42 @@ gst_droidcamsrc_get_property (GObject * object, guint prop_id, GValue * value,
       g_value_set_int (value, src->target_bitrate);
       break;
 
+    case PROP_RAW_PREVIEW_MIN_BUFFERS:
+      g_value_set_uint (value, src->raw_preview_min_buffers);
+      break;
+
+    case PROP_RAW_PREVIEW_MAX_BUFFERS:
+      g_value_set_uint (value, src->raw_preview_max_buffers);
+      break;
+
+    case PROP_BURST_COUNT:
+      g_value_set_uint (value, src->burst_count);
+      break;
+
+    case PROP_VFSRC_MAX_QUEUE_DEPTH:
+      g_mutex_lock (&src->vfsrc->lock);
+      g_value_set_uint (value, src->vfsrc->max_queue_depth);
+      g_mutex_unlock (&src->vfsrc->lock);
+      break;
+
+    case PROP_VFSRC_LEAKY:
+      g_mutex_lock (&src->vfsrc->lock);
+      g_value_set_enum (value, src->vfsrc->leaky);
+      g_mutex_unlock (&src->vfsrc->lock);
+      break;
+
+    case PROP_VIDSRC_MAX_QUEUE_DEPTH:
+      g_mutex_lock (&src->vidsrc->lock);
+      g_value_set_uint (value, src->vidsrc->max_queue_depth);
+      g_mutex_unlock (&src->vidsrc->lock);
+      break;
+
+    case PROP_VIDSRC_LEAKY:
+      g_mutex_lock (&src->vidsrc->lock);
+      g_value_set_enum (value, src->vidsrc->leaky);
+      g_mutex_unlock (&src->vidsrc->lock);
+      break;
+
     case PROP_POST_PREVIEW:
       g_value_set_boolean (value, src->post_preview);
       break;
@@ -354,6 +438,14 @@ gst_droidcamsrc_set_property (GObject * object, guint prop_id,
 
   switch (prop_id) {
     case PROP_CAMERA_DEVICE:
+      /* the range of the property is a static maximum, the cameras
+       * themselves are only counted once droidmedia is initialized */
+      if (src->info && g_value_get_int (value) >= src->num_cameras) {
+        GST_WARNING_OBJECT (src, "camera %d does not exist, there are %d",
+            g_value_get_int (value), src->num_cameras);
+        break;
+      }
+
       src->camera_device = g_value_get_int (value);
       g_rec_mutex_lock (&src->dev_lock);
       if (src->dev && src->dev->info) {
@@ -436,6 +528,46 @@ gst_droidcamsrc_set_property (GObject * object, guint prop_id,
       src->target_bitrate = g_value_get_int (value);
       break;
 
+    case PROP_RAW_PREVIEW_MIN_BUFFERS:
+      src->raw_preview_min_buffers = g_value_get_uint (value);
+      break;
+
+    case PROP_RAW_PREVIEW_MAX_BUFFERS:
+      src->raw_preview_max_buffers = g_value_get_uint (value);
+      break;
+
+    case PROP_BURST_COUNT:
+      src->burst_count = g_value_get_uint (value);
+      break;
+
+    case PROP_VFSRC_MAX_QUEUE_DEPTH:
+      g_mutex_lock (&src->vfsrc->lock);
+      src->vfsrc->max_queue_depth = g_value_get_uint (value);
+      g_cond_broadcast (&src->vfsrc->space_cond);
+      g_mutex_unlock (&src->vfsrc->lock);
+      break;
+
+    case PROP_VFSRC_LEAKY:
+      g_mutex_lock (&src->vfsrc->lock);
+      src->vfsrc->leaky = g_value_get_enum (value);
+      g_cond_broadcast (&src->vfsrc->space_cond);
+      g_mutex_unlock (&src->vfsrc->lock);
+      break;
+
+    case PROP_VIDSRC_MAX_QUEUE_DEPTH:
+      g_mutex_lock (&src->vidsrc->lock);
+      src->vidsrc->max_queue_depth = g_value_get_uint (value);
+      g_cond_broadcast (&src->vidsrc->space_cond);
+      g_mutex_unlock (&src->vidsrc->lock);
+      break;
+
+    case PROP_VIDSRC_LEAKY:
+      g_mutex_lock (&src->vidsrc->lock);
+      src->vidsrc->leaky = g_value_get_enum (value);
+      g_cond_broadcast (&src->vidsrc->space_cond);
+      g_mutex_unlock (&src->vidsrc->lock);
+      break;
+
     case PROP_POST_PREVIEW:
       src->post_preview = g_value_get_boolean (value);
 
@@ -560,6 +692,10 @@ gst_droidcamsrc_get_hw (GstDroidCamSrc * src)
     return TRUE;
   }
 
+  if (!gst_droid_media_ensure_init (GST_ELEMENT (src))) {
+    return FALSE;
+  }
+
   num = droid_media_camera_get_number_of_cameras ();
   GST_INFO_OBJECT (src, "Found %d cameras", num);
 
@@ -569,6 +705,12 @@ gst_droidcamsrc_get_hw (GstDroidCamSrc * src)
   }
 
   src->info = g_malloc0 (num * sizeof (GstDroidCamSrcCamInfo));
+  src->num_cameras = num;
+
+  if (src->camera_device >= num) {
+    GST_WARNING_OBJECT (src, "camera-device %d does not exist, there are %d",
+        src->camera_device, num);
+  }
 
   for (x = 0; x < num; x++) {
     gboolean found;
@@ -585,9 +727,7 @@ gst_droidcamsrc_get_hw (GstDroidCamSrc * src)
 static GstDroidCamSrcCamInfo *
 gst_droidcamsrc_find_camera_device (GstDroidCamSrc * src)
 {
-  int num = droid_media_camera_get_number_of_cameras ();
-
-  if (src->camera_device < num) {
+  if (src->camera_device < src->num_cameras) {
     return &src->info[src->camera_device];
   } else {
     GST_ERROR_OBJECT (src, "cannot find camera %d", src->camera_device);
@@ -772,6 +912,7 @@ gst_droidcamsrc_change_state (GstElement * element, GstStateChange transition)
 
       g_free (src->info);
       src->info = NULL;
+      src->num_cameras = 0;
 
       gst_element_set_state (src->preview_pipeline->pipeline, GST_STATE_NULL);
       break;
@@ -1004,10 +1145,10 @@ gst_droidcamsrc_send_event (GstElement * element, GstEvent * event)
     case GST_EVENT_CUSTOM_DOWNSTREAM:
     case GST_EVENT_CUSTOM_DOWNSTREAM_STICKY:
     case GST_EVENT_CUSTOM_BOTH:
-      GST_OBJECT_LOCK (src);
+      g_mutex_lock (&src->vfsrc->lock);
       src->vfsrc->pending_events =
           g_list_append (src->vfsrc->pending_events, event);
-      GST_OBJECT_UNLOCK (src);
+      g_mutex_unlock (&src->vfsrc->lock);
       event = NULL;
       res = TRUE;
       break;
@@ -1072,15 +1213,13 @@ gst_droidcamsrc_class_init (GstDroidCamSrcClass * klass)
       GST_DEBUG_FUNCPTR (gst_droidcamsrc_change_state);
   gstelement_class->send_event = GST_DEBUG_FUNCPTR (gst_droidcamsrc_send_event);
 
-  /* Add camera-device property only if cameras have been found */
-  if (droid_media_camera_get_number_of_cameras () > 0) {
-    g_object_class_install_property (gobject_class, PROP_CAMERA_DEVICE,
-        g_param_spec_int ("camera-device", "Camera device",
-            "Defines which camera device should be used",
-            0,
-            droid_media_camera_get_number_of_cameras () - 1,
-            DEFAULT_CAMERA_DEVICE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
-  }
+  /* class_init runs during registry scans, long before droidmedia is
+   * initialized, so the HAL can't be asked how many cameras there are */
+  g_object_class_install_property (gobject_class, PROP_CAMERA_DEVICE,
+      g_param_spec_int ("camera-device", "Camera device",
+          "Defines which camera device should be used",
+          0, MAX_CAMERA_DEVICE,
+          DEFAULT_CAMERA_DEVICE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   g_object_class_install_property (gobject_class, PROP_MODE,
       g_param_spec_enum ("mode", "Mode",
@@ -1168,6 +1307,52 @@ gst_droidcamsrc_class_init (GstDroidCamSrcClass * klass)
           "Target bitrate", 0, G_MAXINT,
           DEFAULT_TARGET_BITRATE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class,
+      PROP_RAW_PREVIEW_MIN_BUFFERS,
+      g_param_spec_uint ("raw-preview-min-buffers", "Raw preview min buffers",
+          "Viewfinder buffers allocated up front for raw preview frames "
+          "(applied on the next negotiation)", 0, 32,
+          DEFAULT_RAW_PREVIEW_MIN_BUFFERS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class,
+      PROP_RAW_PREVIEW_MAX_BUFFERS,
+      g_param_spec_uint ("raw-preview-max-buffers", "Raw preview max buffers",
+          "Maximum viewfinder buffers for raw preview frames, frames are "
+          "dropped once all of them are in use "
+          "(applied on the next negotiation)", 1, 32,
+          DEFAULT_RAW_PREVIEW_MAX_BUFFERS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_BURST_COUNT,
+      g_param_spec_uint ("burst-count", "Burst count",
+          "Number of images taken per capture in burst image mode", 1, 100,
+          DEFAULT_BURST_COUNT, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_VFSRC_MAX_QUEUE_DEPTH,
+      g_param_spec_uint ("vfsrc-max-queue-depth", "Viewfinder max queue depth",
+          "Viewfinder frames waiting to be pushed before vfsrc-leaky kicks in "
+          "(0 = unlimited)", 0, G_MAXUINT, DEFAULT_VFSRC_MAX_QUEUE_DEPTH,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_VFSRC_LEAKY,
+      g_param_spec_enum ("vfsrc-leaky", "Viewfinder leaky",
+          "What to do with viewfinder frames once the queue is full",
+          GST_TYPE_DROIDCAMSRC_QUEUE_LEAKY, DEFAULT_VFSRC_LEAKY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_VIDSRC_MAX_QUEUE_DEPTH,
+      g_param_spec_uint ("vidsrc-max-queue-depth", "Video max queue depth",
+          "Video frames waiting to be pushed before vidsrc-leaky kicks in "
+          "(0 = unlimited)", 0, G_MAXUINT, DEFAULT_VIDSRC_MAX_QUEUE_DEPTH,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_VIDSRC_LEAKY,
+      g_param_spec_enum ("vidsrc-leaky", "Video leaky",
+          "What to do with video frames once the queue is full",
+          GST_TYPE_DROIDCAMSRC_QUEUE_LEAKY, DEFAULT_VIDSRC_LEAKY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   g_object_class_install_property (gobject_class,
       PROP_SUPPORTED_WB_MODES,
       g_param_spec_variant ("supported-wb-modes",
@@ -1233,6 +1418,120 @@ gst_droidcamsrc_class_init (GstDroidCamSrcClass * klass)
       NULL, NULL, g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
 }
 
+/*
+ * Returns the buffer which had to be dropped to honour max_queue_depth, if
+ * any. It has to be released by the caller, preferably without the lock
+ * held because that hands hardware buffers back to the HAL.
+ */
+GstBuffer *
+gst_droidcamsrc_pad_queue_buffer_locked (GstDroidCamSrcPad * pad,
+    GstBuffer * buffer)
+{
+  GstBuffer *dropped = NULL;
+
+  if (pad->max_queue_depth > 0
+      && pad->leaky == GST_DROIDCAMSRC_QUEUE_LEAKY_WAIT) {
+    gint64 end_time =
+        g_get_monotonic_time () + GST_DROIDCAMSRC_QUEUE_WAIT_TIMEOUT;
+
+    /* a timed wait, once it runs out we drop the incoming frame */
+    while (pad->running && pad->max_queue_depth > 0
+        && g_queue_get_length (pad->queue) >= pad->max_queue_depth) {
+      gboolean signalled;
+
+      pad->producers_waiting++;
+      signalled = g_cond_wait_until (&pad->space_cond, &pad->lock, end_time);
+      pad->producers_waiting--;
+
+      if (!signalled) {
+        break;
+      }
+    }
+  }
+
+  if (pad->max_queue_depth > 0
+      && g_queue_get_length (pad->queue) >= pad->max_queue_depth) {
+    pad->dropped_buffers++;
+
+    if (pad->leaky == GST_DROIDCAMSRC_QUEUE_LEAKY_DROP_OLDEST) {
+      dropped = g_queue_pop_head (pad->queue);
+    } else {
+      return buffer;
+    }
+  }
+
+  g_queue_push_tail (pad->queue, buffer);
+
+  /* Only the pad task waits on the condition so there's no need to wake
+   * anybody up unless it is asleep. */
+  if (pad->waiting) {
+    g_cond_signal (&pad->cond);
+  }
+
+  return dropped;
+}
+
+static void
+gst_droidcamsrc_pad_post_qos (GstDroidCamSrcPad * pad,
+    const GstSegment * segment, GstBuffer * buffer, guint64 processed,
+    guint64 dropped)
+{
+  GstDroidCamSrc *src = GST_DROIDCAMSRC (GST_PAD_PARENT (pad->pad));
+  GstClockTime timestamp = GST_BUFFER_PTS (buffer);
+  GstClockTime running_time, stream_time;
+  GstMessage *msg;
+
+  GST_DEBUG_OBJECT (pad->pad, "dropped buffer %" GST_TIME_FORMAT ", %"
+      G_GUINT64_FORMAT " dropped so far", GST_TIME_ARGS (timestamp), dropped);
+
+  running_time = gst_segment_to_running_time (segment, GST_FORMAT_TIME,
+      timestamp);
+  stream_time = gst_segment_to_stream_time (segment, GST_FORMAT_TIME,
+      timestamp);
+
+  msg = gst_message_new_qos (GST_OBJECT (src), TRUE, running_time,
+      stream_time, timestamp, GST_BUFFER_DURATION (buffer));
+  gst_message_set_qos_stats (msg, GST_FORMAT_BUFFERS, processed, dropped);
+
+  gst_element_post_message (GST_ELEMENT (src), msg);
+}
+
+void
+gst_droidcamsrc_pad_queue_buffer (GstDroidCamSrcPad * pad, GstBuffer * buffer)
+{
+  GstBuffer *dropped;
+  GstSegment segment;
+  guint64 processed, dropped_buffers;
+
+  g_mutex_lock (&pad->lock);
+  dropped = gst_droidcamsrc_pad_queue_buffer_locked (pad, buffer);
+  if (G_UNLIKELY (dropped)) {
+    /* the task updates the segment under the lock */
+    gst_segment_copy_into (&pad->segment, &segment);
+  }
+  processed = g_atomic_int_get (&pad->pushed_buffers);
+  dropped_buffers = pad->dropped_buffers;
+  g_mutex_unlock (&pad->lock);
+
+  if (G_UNLIKELY (dropped)) {
+    gst_droidcamsrc_pad_post_qos (pad, &segment, dropped, processed,
+        dropped_buffers);
+    gst_buffer_unref (dropped);
+  }
+}
+
+void
+gst_droidcamsrc_pad_flush_queue_locked (GstDroidCamSrcPad * pad)
+{
+  g_queue_foreach (pad->queue, (GFunc) gst_buffer_unref, NULL);
+  g_queue_clear (pad->queue);
+
+  /* let waiting producers queue again */
+  if (pad->producers_waiting) {
+    g_cond_broadcast (&pad->space_cond);
+  }
+}
+
 static void
 gst_droidcamsrc_loop (gpointer user_data)
 {
@@ -1242,25 +1541,25 @@ gst_droidcamsrc_loop (gpointer user_data)
   GstBuffer *buffer = NULL;
   GstPad *pad = data->pad;
 
-  GList *events;
+  GList *events = NULL;
 
   GST_LOG_OBJECT (pad, "loop");
 
-  g_mutex_lock (&data->lock);
-
-  if (!data->running) {
-    GST_DEBUG_OBJECT (pad, "task is not running");
-    g_mutex_unlock (&data->lock);
-    goto exit;
-  }
-
-  g_mutex_unlock (&data->lock);
-
   /* stream start */
   if (G_UNLIKELY (data->open_stream)) {
     gchar *stream_id;
     GstEvent *event;
 
+    g_mutex_lock (&data->lock);
+
+    if (!data->running) {
+      GST_DEBUG_OBJECT (pad, "task is not running");
+      g_mutex_unlock (&data->lock);
+      goto exit;
+    }
+
+    g_mutex_unlock (&data->lock);
+
     stream_id =
         gst_pad_create_stream_id (data->pad, GST_ELEMENT_CAST (src),
         GST_PAD_NAME (data->pad));
@@ -1277,6 +1576,8 @@ gst_droidcamsrc_loop (gpointer user_data)
     data->open_stream = FALSE;
   }
 
+  /* The buffer and the events to push before it are taken in one go so
+   * we only touch the lock once per buffer. */
   g_mutex_lock (&data->lock);
 
   if (!data->running) {
@@ -1286,16 +1587,23 @@ gst_droidcamsrc_loop (gpointer user_data)
   }
 
   buffer = g_queue_pop_head (data->queue);
-  if (buffer) {
-    g_mutex_unlock (&data->lock);
-    goto out;
-  }
 
   if (!buffer) {
+    data->waiting = TRUE;
     g_cond_wait (&data->cond, &data->lock);
+    data->waiting = FALSE;
     buffer = g_queue_pop_head (data->queue);
   }
 
+  if (buffer) {
+    events = data->pending_events;
+    data->pending_events = NULL;
+
+    if (data->producers_waiting) {
+      g_cond_signal (&data->space_cond);
+    }
+  }
+
   g_mutex_unlock (&data->lock);
 
   if (!buffer) {
@@ -1318,7 +1626,10 @@ out:
     GST_DEBUG_OBJECT (pad, "Pushing SEGMENT");
 
     if (data->adjust_segment) {
+      /* QoS messages read the segment from the HAL threads */
+      g_mutex_lock (&data->lock);
       data->segment.start = GST_BUFFER_PTS (buffer);
+      g_mutex_unlock (&data->lock);
     }
 
     event = gst_event_new_segment (&data->segment);
@@ -1331,14 +1642,6 @@ out:
   }
 
   /* pending events */
-  GST_OBJECT_LOCK (src);
-  /* queue lock is needed for vfsrc and imgsrc pads */
-  g_mutex_lock (&data->lock);
-  events = data->pending_events;
-  data->pending_events = NULL;
-  g_mutex_unlock (&data->lock);
-  GST_OBJECT_UNLOCK (src);
-
   if (G_UNLIKELY (events)) {
     GList *tmp;
     for (tmp = events; tmp; tmp = g_list_next (tmp)) {
@@ -1366,9 +1669,8 @@ out:
     }
   }
 
-  g_mutex_lock (&data->lock);
-  data->pushed_buffers++;
-  g_mutex_unlock (&data->lock);
+  /* atomic so the task does not take the lock once more per buffer */
+  g_atomic_int_inc (&data->pushed_buffers);
 }
 
 static gboolean
@@ -1395,7 +1697,8 @@ gst_droidcamsrc_pad_activate_mode (GstPad * pad, GstObject * parent,
     data->running = TRUE;
     data->open_stream = TRUE;
     data->open_segment = TRUE;
-    data->pushed_buffers = 0;
+    g_atomic_int_set (&data->pushed_buffers, 0);
+    data->dropped_buffers = 0;
     if (!gst_pad_start_task (pad, gst_droidcamsrc_loop, data, NULL)) {
       GST_ERROR_OBJECT (src, "failed to start pad task");
       return FALSE;
@@ -1406,6 +1709,7 @@ gst_droidcamsrc_pad_activate_mode (GstPad * pad, GstObject * parent,
     g_mutex_lock (&data->lock);
     data->running = FALSE;
     g_cond_signal (&data->cond);
+    g_cond_broadcast (&data->space_cond);
     g_mutex_unlock (&data->lock);
 
     if (!gst_pad_stop_task (pad)) {
@@ -1416,26 +1720,24 @@ gst_droidcamsrc_pad_activate_mode (GstPad * pad, GstObject * parent,
     }
 
     g_mutex_lock (&data->lock);
-    /* toss the queue */
-    g_queue_foreach (data->queue, (GFunc) gst_buffer_unref, NULL);
-    g_queue_clear (data->queue);
-    g_mutex_unlock (&data->lock);
 
-    GST_OBJECT_LOCK (src);
+    if (data->dropped_buffers) {
+      GST_INFO_OBJECT (src, "pad %s dropped %" G_GUINT64_FORMAT " of %u "
+          "buffers", GST_PAD_NAME (pad), data->dropped_buffers,
+          g_atomic_int_get (&data->pushed_buffers));
+    }
 
-    /*
-     * We have 2 pads making use of such lists:
-     * - vfsrc which always accesses the list with the object lock so it should be safe.
-     *   It's also safe for it because it's not running so the object lock is needed in
-     *   order to prevent us from messing up the list if we happen to get events.
-     * - imgsrc which is also not running. GstDRoidCamSrcDev is also gone long ago
-     */
+    /* toss the queue */
+    gst_droidcamsrc_pad_flush_queue_locked (data);
+
+    /* pending events are protected by the queue lock as well */
     if (data->pending_events) {
       g_list_free_full (data->pending_events, (GDestroyNotify) gst_event_unref);
       data->pending_events = NULL;
     }
 
-    GST_OBJECT_UNLOCK (src);
+    g_mutex_unlock (&data->lock);
+
     return ret;
   }
 
@@ -1665,6 +1967,46 @@ gst_droidcamsrc_pad_query (GstPad * pad, GstObject * parent, GstQuery * query)
   return ret;
 }
 
+static GstBufferPool *
+gst_droidcamsrc_create_raw_preview_pool (GstDroidCamSrc * src,
+    GstVideoInfo * info, gsize * size)
+{
+  GstBufferPool *pool;
+  GstStructure *config;
+  GstVideoInfo raw_info;
+  GstCaps *caps;
+  guint min, max;
+
+  /* The preview callback hands us NV21 at the preview size */
+  gst_video_info_set_format (&raw_info, GST_VIDEO_FORMAT_NV21, info->width,
+      info->height);
+  caps = gst_video_info_to_caps (&raw_info);
+
+  GST_OBJECT_LOCK (src);
+  min = src->raw_preview_min_buffers;
+  max = MAX (src->raw_preview_max_buffers, min);
+  GST_OBJECT_UNLOCK (src);
+
+  pool = gst_video_buffer_pool_new ();
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, caps, raw_info.size, min, max);
+  gst_caps_unref (caps);
+
+  if (!gst_buffer_pool_set_config (pool, config)) {
+    GST_WARNING_OBJECT (src, "Failed to configure raw preview buffer pool");
+    gst_object_unref (pool);
+    return NULL;
+  }
+
+  GST_DEBUG_OBJECT (src, "raw preview pool of %u-%u buffers of %"
+      G_GSIZE_FORMAT " bytes", min, max, raw_info.size);
+
+  /* the preview callback grows the pool if the HAL pads its frames */
+  *size = raw_info.size;
+
+  return pool;
+}
+
 static gboolean
 gst_droidcamsrc_vfsrc_negotiate (GstDroidCamSrcPad * data)
 {
@@ -1677,6 +2019,8 @@ gst_droidcamsrc_vfsrc_negotiate (GstDroidCamSrcPad * data)
   GstVideoInfo info;
   gboolean use_raw_data = TRUE;
   GstBufferPool *pool = NULL;
+  GstBufferPool *raw_pool = NULL;
+  gsize raw_size = 0;
 
   g_rec_mutex_lock (&src->dev_lock);
 
@@ -1809,6 +2153,11 @@ gst_droidcamsrc_vfsrc_negotiate (GstDroidCamSrcPad * data)
     }
   }
 
+  /* the buffer queue path has no use for the copies */
+  if (use_raw_data) {
+    raw_pool = gst_droidcamsrc_create_raw_preview_pool (src, &info, &raw_size);
+  }
+
   g_rec_mutex_lock (&src->dev_lock);
   src->dev->use_raw_data = use_raw_data;
 
@@ -1817,6 +2166,13 @@ gst_droidcamsrc_vfsrc_negotiate (GstDroidCamSrcPad * data)
   }
   src->dev->pool = pool;
 
+  if (raw_pool && src->dev->running
+      && !gst_buffer_pool_set_active (raw_pool, TRUE)) {
+    GST_WARNING_OBJECT (src, "Failed to activate raw preview buffer pool");
+  }
+
+  gst_droidcamsrc_dev_set_raw_pool (src->dev, raw_pool, raw_size);
+
   g_rec_mutex_unlock (&src->dev_lock);
 
   ret = TRUE;
@@ -2419,7 +2775,6 @@ gst_droidcamsrc_add_vfsrc_orientation_tag (GstDroidCamSrc * src)
 
   taglist = gst_tag_list_new (GST_TAG_IMAGE_ORIENTATION, orientation, NULL);
 
-  /* The lock is not really needed but for the sake of consistency */
   g_mutex_lock (&src->vfsrc->lock);
   src->vfsrc->pending_events = g_list_append (src->vfsrc->pending_events,
       gst_event_new_tag (taglist));
@@ -52,6 +52,7 @@ G_BEGIN_DECLS
 #define GST_DROIDCAMSRC_CAPTURE_START "photo-capture-start"
 #define GST_DROIDCAMSRC_CAPTURE_END "photo-capture-end"
 #define GST_DROIDCAMSRC_PREVIEW_IMAGE "photo-capture-preview"
+#define GST_DROIDCAMSRC_BURST_DONE "photo-burst-done"
 
 typedef struct _GstDroidCamSrc GstDroidCamSrc;
 typedef struct _GstDroidCamSrcClass GstDroidCamSrcClass;
@@ -80,7 +81,15 @@ struct _GstDroidCamSrcPad
   gboolean open_segment;
   gboolean adjust_segment;
   gboolean capture_pad;
-  unsigned pushed_buffers;
+  guint pushed_buffers;         /* atomic, read by the HAL threads */
+  gboolean waiting;             /* the task sleeps on cond */
+
+  /* 0 means unbounded, protected by lock */
+  guint max_queue_depth;
+  GstDroidCamSrcQueueLeaky leaky;
+  guint64 dropped_buffers;
+  GCond space_cond;
+  guint producers_waiting;      /* sleeping on space_cond */
   GstSegment segment;
   GstDroidCamSrcNegotiateCallback negotiate;
   GList *pending_events;
@@ -94,6 +103,7 @@ struct _GstDroidCamSrc
   GstDroidCamSrcDev *dev;
   GRecMutex dev_lock;
   GstDroidCamSrcCamInfo *info;
+  int num_cameras;
 
   GstDroidCamSrcPad *vfsrc;
   GstDroidCamSrcPad *imgsrc;
@@ -122,6 +132,13 @@ struct _GstDroidCamSrc
 
   gint32 target_bitrate;
 
+  /* raw viewfinder frames from the preview callback */
+  guint raw_preview_min_buffers;
+  guint raw_preview_max_buffers;
+
+  /* shots taken per capture in burst image mode */
+  guint burst_count;
+
   /* camerabin interface */
   gboolean post_preview;
   GstCaps *preview_caps;
@@ -155,6 +172,10 @@ void gst_droidcamsrc_update_max_zoom (GstDroidCamSrc * src);
 
 void gst_droidcamsrc_post_preview (GstDroidCamSrc * src, GstSample * sample);
 
+void gst_droidcamsrc_pad_queue_buffer (GstDroidCamSrcPad * pad, GstBuffer * buffer);
+GstBuffer *gst_droidcamsrc_pad_queue_buffer_locked (GstDroidCamSrcPad * pad, GstBuffer * buffer);
+void gst_droidcamsrc_pad_flush_queue_locked (GstDroidCamSrcPad * pad);
+
 G_END_DECLS
 
 #endif /* __GST_DROIDCAMSRC_H__ */
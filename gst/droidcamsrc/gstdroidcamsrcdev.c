@@ -46,18 +46,30 @@ GST_DEBUG_CATEGORY_EXTERN (gst_droid_camsrc_debug);
 
 #define VIDEO_RECORDING_STOP_TIMEOUT                 100000     /* us */
 #define GST_DROIDCAMSRC_NUM_BUFFERS                  2
+/* images waiting on imgsrc before we start dropping burst shots */
+#define GST_DROIDCAMSRC_MAX_QUEUED_IMAGES            8
 
 struct _GstDroidCamSrcImageCaptureState
 {
   gboolean image_preview_sent;
   gboolean image_start_sent;
   gboolean preview_image_requested;
+  GstClockTime capture_requested;       /* first shot of the burst */
+  GstClockTime shot_requested;          /* shot the HAL is working on */
+
+  /* burst state, a single capture is a burst of one */
+  gboolean burst;
+  guint burst_shots;
+  guint burst_remaining;
+  guint burst_sequence;
+  guint burst_dropped_base;
 };
 
 struct _GstDroidCamSrcVideoCaptureState
 {
   unsigned long video_frames;
   int queued_frames;
+  guint queueing;               /* buffers on their way to vidsrc */
   gboolean running;
   gboolean eos_sent;
   GMutex lock;
@@ -70,6 +82,21 @@ typedef struct _GstDroidCamSrcDevVideoData
   DroidMediaCameraRecordingData *data;
 } GstDroidCamSrcDevVideoData;
 
+typedef struct _GstDroidCamSrcDevImageJob
+{
+  GstBuffer *buffer;            /* NULL if the burst was cut short */
+  gboolean post_capture_end;
+  GstClockTime hal_delivery_time;
+  GstClockTime queued;
+
+  /* set on the last job of a burst */
+  gboolean burst_done;
+  guint burst_shots;
+  guint burst_missed;
+  guint burst_dropped_base;
+  GstClockTime burst_duration;
+} GstDroidCamSrcDevImageJob;
+
 static void gst_droidcamsrc_dev_release_recording_frame (void *data,
     GstDroidCamSrcDevVideoData * video_data);
 void gst_droidcamsrc_dev_update_params_locked (GstDroidCamSrcDev * dev);
@@ -81,9 +108,20 @@ gst_droidcamsrc_dev_start_video_recording_recorder_locked (GstDroidCamSrcDev *
     dev);
 static gboolean
 gst_droidcamsrc_dev_start_video_recording_raw_locked (GstDroidCamSrcDev * dev);
-static void gst_droidcamsrc_dev_queue_video_buffer_locked (GstDroidCamSrcDev *
-    dev, GstBuffer * buffer);
+static gboolean gst_droidcamsrc_dev_prepare_video_buffer_locked
+    (GstDroidCamSrcDev * dev, GstBuffer * buffer);
+static void gst_droidcamsrc_dev_push_video_buffer (GstDroidCamSrcDev * dev,
+    GstBuffer * buffer);
 static void gst_droidcamsrc_dev_post_preview (GstDroidCamSrcDev * dev);
+static void gst_droidcamsrc_dev_process_image (GstDroidCamSrcDevImageJob * job,
+    GstDroidCamSrcDev * dev);
+static void gst_droidcamsrc_dev_restart_preview (GstDroidCamSrcDev * data,
+    GstDroidCamSrcDev * dev);
+static void gst_droidcamsrc_dev_capture_done (GstDroidCamSrcDev * dev);
+static gboolean gst_droidcamsrc_dev_take_picture_locked (GstDroidCamSrcDev *
+    dev);
+static gboolean gst_droidcamsrc_dev_start_preview (GstDroidCamSrcDev * dev,
+    gboolean apply_settings);
 
 static void
 gst_droidcamsrc_dev_shutter_callback (void *user)
@@ -192,9 +230,10 @@ gst_droidcamsrc_dev_compressed_image_callback (void *user, DroidMediaData * mem)
   size_t size = mem->size;
   void *data = mem->data;
   GstBuffer *buffer;
-  GstTagList *tags;
-  GstEvent *event = NULL;
-  void *d;
+  GstDroidCamSrcDevImageJob *job;
+  GstClockTime now = gst_util_get_timestamp ();
+  gboolean zsl, more_shots;
+  guint8 *d;
 
   GST_DEBUG_OBJECT (src, "dev compressed image callback");
 
@@ -203,20 +242,187 @@ gst_droidcamsrc_dev_compressed_image_callback (void *user, DroidMediaData * mem)
     return;
   }
 
-  /* TODO: research a way to get rid of the memcpy */
-  d = g_malloc (size);
+  /* The HAL only keeps the data alive for the duration of the callback so
+   * we still have to copy but we can at least reuse the block of the
+   * previous shot instead of faulting in fresh pages every time. */
+  d = gst_droid_staging_pool_alloc (dev->image_pool, size);
   memcpy (d, data, size);
-  buffer = gst_buffer_new_wrapped (d, size);
+  buffer = gst_buffer_new_wrapped_full (0, d, size, 0, size, d,
+      gst_droid_staging_pool_release);
+
+  gst_droidcamsrc_timestamp (src, buffer);
+
+  job = g_slice_new0 (GstDroidCamSrcDevImageJob);
+  job->buffer = buffer;
+  job->queued = now;
+
   if (!dev->img->image_preview_sent) {
-    gst_droidcamsrc_post_message (src,
-        gst_structure_new_empty (GST_DROIDCAMSRC_CAPTURE_END));
     /* TODO: generate and send preview if we don't get it from HAL */
+    job->post_capture_end = TRUE;
     dev->img->image_preview_sent = TRUE;
   }
 
-  gst_droidcamsrc_timestamp (src, buffer);
+  g_rec_mutex_lock (dev->lock);
+
+  if (GST_CLOCK_TIME_IS_VALID (dev->img->shot_requested)) {
+    job->hal_delivery_time = now - dev->img->shot_requested;
+  } else {
+    job->hal_delivery_time = GST_CLOCK_TIME_NONE;
+  }
+
+  /* the sequence number within the burst goes into the offset */
+  GST_BUFFER_OFFSET (buffer) = dev->img->burst_sequence++;
+
+  if (dev->img->burst_remaining > 0) {
+    dev->img->burst_remaining--;
+  }
+
+  more_shots = dev->img->burst_remaining > 0;
+
+  if (dev->img->burst && !more_shots) {
+    job->burst_done = TRUE;
+    job->burst_shots = dev->img->burst_shots;
+    job->burst_dropped_base = dev->img->burst_dropped_base;
+    job->burst_duration = now - dev->img->capture_requested;
+  }
+
+  g_rec_mutex_unlock (dev->lock);
+
+  /* EXIF parsing and queueing to imgsrc are done by the worker */
+  g_mutex_lock (&dev->image_lock);
+  dev->pending_images++;
+  g_mutex_unlock (&dev->image_lock);
+
+  g_thread_pool_push (dev->image_worker, job, NULL);
+
+  /* we need to restart the preview but only if we are not in ZSL mode.
+   * android demands this but GStreamer does not know about it.
+   * The control thread does it, takes the next shot of a burst and reports
+   * us ready for the next capture once the HAL can take it.
+   */
+  zsl = (src->image_mode & GST_DROIDCAMSRC_IMAGE_MODE_ZSL) != 0;
+
+  if (!zsl || more_shots) {
+    if (!zsl) {
+      g_rec_mutex_lock (dev->lock);
+      dev->running = FALSE;
+      dev->restart_pending = TRUE;
+      g_rec_mutex_unlock (dev->lock);
+    }
+
+    g_thread_pool_push (dev->control_worker, dev, NULL);
+    return;
+  }
+
+  gst_droidcamsrc_dev_capture_done (dev);
+}
+
+static void
+gst_droidcamsrc_dev_capture_done (GstDroidCamSrcDev * dev)
+{
+  GstDroidCamSrc *src = GST_DROIDCAMSRC (GST_PAD_PARENT (dev->imgsrc->pad));
+
+  g_mutex_lock (&src->capture_lock);
+  /* a state change may have reset the counter in the meantime */
+  if (src->captures > 0) {
+    --src->captures;
+  }
+  g_mutex_unlock (&src->capture_lock);
+
+  g_object_notify (G_OBJECT (src), "ready-for-capture");
+}
+
+static void
+gst_droidcamsrc_dev_restart_preview (G_GNUC_UNUSED GstDroidCamSrcDev * data,
+    GstDroidCamSrcDev * dev)
+{
+  GstClockTime start = gst_util_get_timestamp ();
+  GstDroidCamSrcDevImageJob *job;
+  gboolean restarted = FALSE;
+
+  g_rec_mutex_lock (dev->lock);
+
+  /* dev_stop () cancels a restart which did not get to run yet */
+  if (dev->restart_pending) {
+    dev->restart_pending = FALSE;
+
+    /* parameters only get pushed to the HAL if they changed */
+    restarted = gst_droidcamsrc_dev_start_preview (dev, TRUE);
+    if (!restarted) {
+      GST_ERROR ("failed to restart preview after capture");
+    }
+
+    GST_DEBUG ("preview restarted in %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (gst_util_get_timestamp () - start));
+  }
+
+  if (dev->img->burst_remaining > 0) {
+    if (dev->running && gst_droidcamsrc_dev_take_picture_locked (dev)) {
+      /* we are ready again once the last shot arrives */
+      g_rec_mutex_unlock (dev->lock);
+      goto out;
+    }
+
+    GST_WARNING ("burst cut short, %u of %u shots missing",
+        dev->img->burst_remaining, dev->img->burst_shots);
+
+    /* let the image worker report the burst after the images it has */
+    job = g_slice_new0 (GstDroidCamSrcDevImageJob);
+    job->burst_done = TRUE;
+    job->burst_shots = dev->img->burst_shots;
+    job->burst_missed = dev->img->burst_remaining;
+    job->burst_dropped_base = dev->img->burst_dropped_base;
+    job->burst_duration =
+        gst_util_get_timestamp () - dev->img->capture_requested;
+
+    dev->img->burst_remaining = 0;
+
+    g_mutex_lock (&dev->image_lock);
+    dev->pending_images++;
+    g_mutex_unlock (&dev->image_lock);
+
+    g_thread_pool_push (dev->image_worker, job, NULL);
+  }
+
+  g_rec_mutex_unlock (dev->lock);
+
+  /* camera1 takes the next picture as soon as start_preview returned, the
+   * preview callback flag can wait until the application knows that */
+  gst_droidcamsrc_dev_capture_done (dev);
+
+out:
+  if (restarted) {
+    gst_droidcamsrc_dev_update_preview_callback_flag (dev);
+  }
+}
+
+static void
+gst_droidcamsrc_dev_process_image (GstDroidCamSrcDevImageJob * job,
+    GstDroidCamSrcDev * dev)
+{
+  GstDroidCamSrc *src = GST_DROIDCAMSRC (GST_PAD_PARENT (dev->imgsrc->pad));
+  GstTagList *tags = NULL;
+  GstEvent *event = NULL;
+  GstClockTime start, exif_parse_time, queue_time;
+  GstMapInfo info;
+  GstBuffer *dropped;
+  gboolean full;
+
+  if (!job->buffer) {
+    goto done;
+  }
+
+  start = gst_util_get_timestamp ();
+
+  if (gst_buffer_map (job->buffer, &info, GST_MAP_READ)) {
+    tags = gst_droidcamsrc_exif_tags_from_jpeg_data (info.data, info.size);
+    gst_buffer_unmap (job->buffer, &info);
+  } else {
+    GST_WARNING_OBJECT (src, "failed to map image buffer");
+  }
+
+  exif_parse_time = gst_util_get_timestamp () - start;
 
-  tags = gst_droidcamsrc_exif_tags_from_jpeg_data (d, size);
   if (tags) {
     GST_INFO_OBJECT (src, "pushing tags %" GST_PTR_FORMAT, tags);
     event = gst_event_new_tag (tags);
@@ -224,31 +430,104 @@ gst_droidcamsrc_dev_compressed_image_callback (void *user, DroidMediaData * mem)
 
   g_mutex_lock (&dev->imgsrc->lock);
 
+  /* checked under the same lock we queue with, so the streaming thread
+   * can't sneak a buffer in between */
+  full = g_queue_get_length (dev->imgsrc->queue) >=
+      GST_DROIDCAMSRC_MAX_QUEUED_IMAGES;
+
+  if (full) {
+    g_mutex_unlock (&dev->imgsrc->lock);
+
+    /* downstream can't keep up with the burst */
+    GST_WARNING_OBJECT (src, "imgsrc queue full, dropping image %"
+        G_GUINT64_FORMAT, GST_BUFFER_OFFSET (job->buffer));
+    gst_buffer_unref (job->buffer);
+
+    if (event) {
+      gst_event_unref (event);
+    }
+
+    g_mutex_lock (&dev->image_lock);
+    dev->images_dropped++;
+    g_mutex_unlock (&dev->image_lock);
+
+    goto done;
+  }
+
   // TODO: get the correct lock
   if (event) {
     src->imgsrc->pending_events =
         g_list_append (src->imgsrc->pending_events, event);
   }
 
-  g_queue_push_tail (dev->imgsrc->queue, buffer);
-  g_cond_signal (&dev->imgsrc->cond);
+  /* imgsrc is not bounded, the check above keeps it short */
+  dropped = gst_droidcamsrc_pad_queue_buffer_locked (dev->imgsrc, job->buffer);
   g_mutex_unlock (&dev->imgsrc->lock);
 
-  /* we need to restart the preview but only if we are not in ZSL mode.
-   * android demands this but GStreamer does not know about it.
-   */
-  if (!(src->image_mode & GST_DROIDCAMSRC_IMAGE_MODE_ZSL)) {
-    g_rec_mutex_lock (dev->lock);
-    dev->running = FALSE;
-    g_rec_mutex_unlock (dev->lock);
-    gst_droidcamsrc_dev_start (dev, TRUE);
+  if (dropped) {
+    gst_buffer_unref (dropped);
   }
 
-  g_mutex_lock (&src->capture_lock);
-  --src->captures;
-  g_mutex_unlock (&src->capture_lock);
+  queue_time = gst_util_get_timestamp () - job->queued;
 
-  g_object_notify (G_OBJECT (src), "ready-for-capture");
+  GST_DEBUG_OBJECT (src, "image delivered by HAL after %" GST_TIME_FORMAT
+      ", EXIF parsed in %" GST_TIME_FORMAT ", queued to imgsrc after %"
+      GST_TIME_FORMAT, GST_TIME_ARGS (job->hal_delivery_time),
+      GST_TIME_ARGS (exif_parse_time), GST_TIME_ARGS (queue_time));
+
+  if (job->post_capture_end) {
+    gst_droidcamsrc_post_message (src,
+        gst_structure_new (GST_DROIDCAMSRC_CAPTURE_END,
+            "hal-delivery-time", GST_TYPE_CLOCK_TIME, job->hal_delivery_time,
+            "exif-parse-time", GST_TYPE_CLOCK_TIME, exif_parse_time,
+            "queue-to-push-time", GST_TYPE_CLOCK_TIME, queue_time, NULL));
+  }
+
+done:
+  if (job->burst_done) {
+    guint received = job->burst_shots - job->burst_missed;
+    guint dropped;
+    gdouble fps = 0.0;
+
+    g_mutex_lock (&dev->image_lock);
+    dropped = dev->images_dropped - job->burst_dropped_base;
+    g_mutex_unlock (&dev->image_lock);
+
+    if (job->burst_duration > 0) {
+      fps = (gdouble) received * GST_SECOND / job->burst_duration;
+    }
+
+    GST_INFO_OBJECT (src, "burst done: %u of %u shots received, %u dropped, "
+        "%.2f fps", received, job->burst_shots, dropped, fps);
+
+    gst_droidcamsrc_post_message (src,
+        gst_structure_new (GST_DROIDCAMSRC_BURST_DONE,
+            "shots", G_TYPE_UINT, job->burst_shots,
+            "captured", G_TYPE_UINT, received - MIN (dropped, received),
+            "dropped", G_TYPE_UINT, dropped + job->burst_missed,
+            "duration", GST_TYPE_CLOCK_TIME, job->burst_duration,
+            "fps", G_TYPE_DOUBLE, fps, NULL));
+  }
+
+  g_slice_free (GstDroidCamSrcDevImageJob, job);
+
+  g_mutex_lock (&dev->image_lock);
+  dev->pending_images--;
+  g_cond_signal (&dev->image_cond);
+  g_mutex_unlock (&dev->image_lock);
+}
+
+static void
+gst_droidcamsrc_dev_wait_for_images (GstDroidCamSrcDev * dev)
+{
+  g_mutex_lock (&dev->image_lock);
+
+  while (dev->pending_images > 0) {
+    GST_DEBUG ("waiting for %u images to be processed", dev->pending_images);
+    g_cond_wait (&dev->image_cond, &dev->image_lock);
+  }
+
+  g_mutex_unlock (&dev->image_lock);
 }
 
 static void
@@ -274,6 +553,101 @@ gst_droidcamsrc_dev_raw_image_notify_callback (void *user)
   GST_FIXME_OBJECT (src, "implement me");
 }
 
+void
+gst_droidcamsrc_dev_set_raw_pool (GstDroidCamSrcDev * dev,
+    GstBufferPool * pool, gsize size)
+{
+  GstBufferPool *old;
+
+  g_mutex_lock (&dev->raw_pool_lock);
+  old = dev->raw_pool;
+  dev->raw_pool = pool;
+  dev->raw_pool_size = size;
+  g_mutex_unlock (&dev->raw_pool_lock);
+
+  /* A preview callback still holding the old pool fails to acquire from
+   * it and drops the frame. Buffers downstream are freed on return */
+  if (old) {
+    gst_buffer_pool_set_active (old, FALSE);
+    gst_object_unref (old);
+  }
+}
+
+static GstBufferPool *
+gst_droidcamsrc_dev_get_raw_pool (GstDroidCamSrcDev * dev, gsize * size)
+{
+  GstBufferPool *pool = NULL;
+
+  g_mutex_lock (&dev->raw_pool_lock);
+  if (dev->raw_pool) {
+    pool = gst_object_ref (dev->raw_pool);
+  }
+
+  if (size) {
+    *size = dev->raw_pool_size;
+  }
+  g_mutex_unlock (&dev->raw_pool_lock);
+
+  return pool;
+}
+
+/* returns the new pool with a reference or NULL */
+static GstBufferPool *
+gst_droidcamsrc_dev_resize_raw_pool (GstDroidCamSrcDev * dev, gsize size)
+{
+  GstDroidCamSrc *src = GST_DROIDCAMSRC (GST_PAD_PARENT (dev->imgsrc->pad));
+  GstBufferPool *old = gst_droidcamsrc_dev_get_raw_pool (dev, NULL);
+  GstBufferPool *pool;
+  GstStructure *config;
+  GstCaps *caps = NULL;
+  guint min, max;
+
+  if (!old) {
+    return NULL;
+  }
+
+  GST_INFO_OBJECT (src, "HAL preview frames are %" G_GSIZE_FORMAT
+      " bytes, growing the raw preview pool", size);
+
+  config = gst_buffer_pool_get_config (old);
+  gst_buffer_pool_config_get_params (config, &caps, NULL, &min, &max);
+  gst_buffer_pool_config_set_params (config, caps, size, min, max);
+
+  pool = gst_video_buffer_pool_new ();
+  if (!gst_buffer_pool_set_config (pool, config)) {
+    GST_WARNING_OBJECT (src, "Failed to configure raw preview buffer pool");
+    gst_object_unref (pool);
+    pool = NULL;
+  } else if (gst_buffer_pool_is_active (old)
+      && !gst_buffer_pool_set_active (pool, TRUE)) {
+    GST_WARNING_OBJECT (src, "Failed to activate raw preview buffer pool");
+  }
+
+  g_mutex_lock (&dev->raw_pool_lock);
+  if (dev->raw_pool != old) {
+    /* renegotiated in the meantime, the new pool gets checked next frame */
+    g_mutex_unlock (&dev->raw_pool_lock);
+    gst_object_unref (old);
+    if (pool) {
+      gst_buffer_pool_set_active (pool, FALSE);
+      gst_object_unref (pool);
+    }
+    return NULL;
+  }
+
+  /* without a pool the callback drops frames, it doesn't allocate */
+  dev->raw_pool = pool ? gst_object_ref (pool) : NULL;
+  dev->raw_pool_size = size;
+  g_mutex_unlock (&dev->raw_pool_lock);
+
+  /* once for the reference dev held and once for ours */
+  gst_buffer_pool_set_active (old, FALSE);
+  gst_object_unref (old);
+  gst_object_unref (old);
+
+  return pool;
+}
+
 static void
 gst_droidcamsrc_dev_preview_frame_callback (void *user,
     G_GNUC_UNUSED DroidMediaData * mem)
@@ -282,14 +656,61 @@ gst_droidcamsrc_dev_preview_frame_callback (void *user,
   GstDroidCamSrc *src = GST_DROIDCAMSRC (GST_PAD_PARENT (dev->imgsrc->pad));
   GstDroidCamSrcPad *pad = dev->vfsrc;
   GstVideoInfo video_info;
-  GstBuffer *buffer;
-  gsize width, height;
+  GstBuffer *buffer = NULL;
+  GstBufferPool *pool;
+  gsize width, height, pool_size;
   DroidMediaRect rect;
 
   GST_DEBUG_OBJECT (src, "dev preview frame callback");
 
-  buffer = gst_buffer_new_allocate (NULL, mem->size, NULL);
-  gst_buffer_fill (buffer, 0, mem->data, mem->size);
+  dev->raw_preview_frames++;
+
+  /* vfsrc negotiation may swap the pool while the preview runs */
+  pool = gst_droidcamsrc_dev_get_raw_pool (dev, &pool_size);
+
+  if (pool && G_UNLIKELY (pool_size < mem->size)) {
+    /* The HAL pads the frame beyond what the caps say. Once is enough */
+    gst_object_unref (pool);
+    pool = gst_droidcamsrc_dev_resize_raw_pool (dev, mem->size);
+  }
+
+  if (pool) {
+    GstBufferPoolAcquireParams params = { 0, };
+    params.flags = GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT;
+
+    if (gst_buffer_pool_acquire_buffer (pool, &buffer,
+            &params) != GST_FLOW_OK) {
+      /* downstream still holds all of them, don't pile up more */
+      gst_object_unref (pool);
+      dev->raw_preview_drops++;
+      GST_DEBUG_OBJECT (src, "no free preview buffer, dropping frame (%"
+          G_GUINT64_FORMAT " dropped so far)", dev->raw_preview_drops);
+      return;
+    }
+
+    gst_object_unref (pool);
+
+    if (G_UNLIKELY (gst_buffer_get_size (buffer) < mem->size)) {
+      GST_WARNING_OBJECT (src, "preview frame of %d bytes does not fit in "
+          "pool buffer of %" G_GSIZE_FORMAT " bytes, dropping it", mem->size,
+          gst_buffer_get_size (buffer));
+      gst_buffer_unref (buffer);
+      dev->raw_preview_drops++;
+      return;
+    }
+
+    gst_buffer_fill (buffer, 0, mem->data, mem->size);
+    gst_buffer_set_size (buffer, mem->size);
+  } else if (dev->use_raw_data) {
+    /* the pool could not be set up, see the warnings before this */
+    dev->raw_preview_drops++;
+    return;
+  } else {
+    /* only here for post-preview, the preview itself goes through the
+     * buffer queue */
+    buffer = gst_buffer_new_allocate (NULL, mem->size, NULL);
+    gst_buffer_fill (buffer, 0, mem->data, mem->size);
+  }
 
   GST_OBJECT_LOCK (src);
   width = src->width;
@@ -311,10 +732,7 @@ gst_droidcamsrc_dev_preview_frame_callback (void *user,
    * 2) We can get called when we start the preview and we will deadlock because the lock is already held
    */
   if (dev->use_raw_data) {
-    g_mutex_lock (&pad->lock);
-    g_queue_push_tail (pad->queue, buffer);
-    g_cond_signal (&pad->cond);
-    g_mutex_unlock (&pad->lock);
+    gst_droidcamsrc_pad_queue_buffer (pad, buffer);
   } else {
     gst_buffer_unref (buffer);
   }
@@ -330,6 +748,7 @@ gst_droidcamsrc_dev_video_frame_callback (void *user,
   GstBuffer *buffer;
   GstMemory *mem;
   GstDroidCamSrcDevVideoData *mem_data;
+  gboolean queue;
 
   GST_DEBUG_OBJECT (src, "dev video frame callback");
 
@@ -357,9 +776,14 @@ gst_droidcamsrc_dev_video_frame_callback (void *user,
 
   gst_droidcamsrc_timestamp (src, buffer);
 
-  gst_droidcamsrc_dev_queue_video_buffer_locked (dev, buffer);
+  queue = gst_droidcamsrc_dev_prepare_video_buffer_locked (dev, buffer);
 
   g_mutex_unlock (&dev->vid->lock);
+
+  if (queue) {
+    gst_droidcamsrc_dev_push_video_buffer (dev, buffer);
+  }
+
   return;
 
 unlock_and_out:
@@ -515,10 +939,7 @@ gst_droidcamsrc_dev_frame_available (void *user, DroidMediaBuffer * buffer)
   gst_droidcamsrc_dev_prepare_buffer (dev, buff, rect,
       gst_droid_media_buffer_get_video_info_from_gst_buffer (buff));
 
-  g_mutex_lock (&pad->lock);
-  g_queue_push_tail (pad->queue, buff);
-  g_cond_signal (&pad->cond);
-  g_mutex_unlock (&pad->lock);
+  gst_droidcamsrc_pad_queue_buffer (pad, buff);
 
   return true;
 }
@@ -538,6 +959,8 @@ gst_droidcamsrc_dev_new (GstDroidCamSrcPad * vfsrc,
   dev->use_raw_data = FALSE;
   dev->info = NULL;
   dev->img = g_slice_new0 (GstDroidCamSrcImageCaptureState);
+  dev->img->capture_requested = GST_CLOCK_TIME_NONE;
+  dev->img->shot_requested = GST_CLOCK_TIME_NONE;
   dev->vid = g_slice_new0 (GstDroidCamSrcVideoCaptureState);
 
   g_mutex_init (&dev->vid->lock);
@@ -552,6 +975,24 @@ gst_droidcamsrc_dev_new (GstDroidCamSrcPad * vfsrc,
   dev->lock = lock;
 
   dev->pool = NULL;
+  dev->raw_pool = NULL;
+  dev->raw_pool_size = 0;
+  g_mutex_init (&dev->raw_pool_lock);
+  dev->image_pool = gst_droid_staging_pool_new ();
+
+  /* a single thread keeps the images in order */
+  dev->image_worker =
+      g_thread_pool_new ((GFunc) gst_droidcamsrc_dev_process_image, dev, 1,
+      FALSE, NULL);
+  g_mutex_init (&dev->image_lock);
+  g_cond_init (&dev->image_cond);
+  dev->pending_images = 0;
+  dev->images_dropped = 0;
+
+  dev->control_worker =
+      g_thread_pool_new ((GFunc) gst_droidcamsrc_dev_restart_preview, dev, 1,
+      FALSE, NULL);
+  dev->restart_pending = FALSE;
 
   dev->last_preview_buffer = NULL;
   g_mutex_init (&dev->last_preview_buffer_lock);
@@ -669,6 +1110,20 @@ gst_droidcamsrc_dev_destroy (GstDroidCamSrcDev * dev)
   gst_droidcamsrc_recorder_destroy (dev->recorder);
 
   gst_buffer_replace (&dev->last_preview_buffer, NULL);
+
+  gst_droidcamsrc_dev_set_raw_pool (dev, NULL, 0);
+  g_mutex_clear (&dev->raw_pool_lock);
+
+  /* lets queued images and restarts finish before we go away */
+  g_thread_pool_free (dev->control_worker, FALSE, TRUE);
+  g_thread_pool_free (dev->image_worker, FALSE, TRUE);
+  g_mutex_clear (&dev->image_lock);
+  g_cond_clear (&dev->image_cond);
+
+  /* buffers still in flight keep the pool alive */
+  gst_droid_staging_pool_unref (dev->image_pool);
+  dev->image_pool = NULL;
+
   g_mutex_clear (&dev->last_preview_buffer_lock);
   g_cond_clear (&dev->last_preview_buffer_cond);
 
@@ -735,11 +1190,17 @@ gst_droidcamsrc_dev_deinit (GstDroidCamSrcDev * dev)
   g_rec_mutex_unlock (dev->lock);
 }
 
-gboolean
-gst_droidcamsrc_dev_start (GstDroidCamSrcDev * dev, gboolean apply_settings)
+/*
+ * Everything up to the HAL running the preview. The preview callback flag
+ * is left to the caller so a restart after capture can report ready first
+ */
+static gboolean
+gst_droidcamsrc_dev_start_preview (GstDroidCamSrcDev * dev,
+    gboolean apply_settings)
 {
   gboolean ret = FALSE;
   GstDroidCamSrc *src = GST_DROIDCAMSRC (GST_PAD_PARENT (dev->imgsrc->pad));
+  GstBufferPool *raw_pool;
 
   g_rec_mutex_lock (dev->lock);
 
@@ -764,6 +1225,19 @@ gst_droidcamsrc_dev_start (GstDroidCamSrcDev * dev, gboolean apply_settings)
     }
   }
 
+  /* allocates the minimum number of buffers up front */
+  raw_pool = gst_droidcamsrc_dev_get_raw_pool (dev, NULL);
+  if (raw_pool) {
+    if (!gst_buffer_pool_set_active (raw_pool, TRUE)) {
+      GST_WARNING_OBJECT (src, "Failed to activate raw preview buffer pool");
+    }
+
+    gst_object_unref (raw_pool);
+  }
+
+  dev->raw_preview_frames = 0;
+  dev->raw_preview_drops = 0;
+
   if (apply_settings) {
     gst_droidcamsrc_apply_mode_settings (src, SET_ONLY);
   }
@@ -780,9 +1254,6 @@ gst_droidcamsrc_dev_start (GstDroidCamSrcDev * dev, gboolean apply_settings)
 
   dev->running = TRUE;
 
-  /* Flag update is done here because the function checks for dev->running. */
-  gst_droidcamsrc_dev_update_preview_callback_flag (dev);
-
   ret = TRUE;
 
 out:
@@ -794,13 +1265,39 @@ out:
   return ret;
 }
 
+gboolean
+gst_droidcamsrc_dev_start (GstDroidCamSrcDev * dev, gboolean apply_settings)
+{
+  gboolean ret;
+
+  g_rec_mutex_lock (dev->lock);
+
+  ret = gst_droidcamsrc_dev_start_preview (dev, apply_settings);
+
+  /* Flag update is done here because the function checks for dev->running. */
+  if (ret) {
+    gst_droidcamsrc_dev_update_preview_callback_flag (dev);
+  }
+
+  g_rec_mutex_unlock (dev->lock);
+
+  return ret;
+}
+
 void
 gst_droidcamsrc_dev_stop (GstDroidCamSrcDev * dev)
 {
+  GstBufferPool *raw_pool;
+
+  /* don't let an image still being processed land after we stopped */
+  gst_droidcamsrc_dev_wait_for_images (dev);
+
   g_rec_mutex_lock (dev->lock);
 
   GST_DEBUG ("dev stop");
 
+  dev->restart_pending = FALSE;
+
   if (dev->running) {
     GST_DEBUG ("stopping preview");
     if (dev->pool) {
@@ -808,13 +1305,23 @@ gst_droidcamsrc_dev_stop (GstDroidCamSrcDev * dev)
     }
     droid_media_camera_stop_preview (dev->cam);
     dev->running = FALSE;
+
+    /* buffers still held downstream are freed when they come back */
+    raw_pool = gst_droidcamsrc_dev_get_raw_pool (dev, NULL);
+    if (raw_pool) {
+      gst_buffer_pool_set_active (raw_pool, FALSE);
+      gst_object_unref (raw_pool);
+    }
+
     GST_DEBUG ("stopped preview");
+    GST_INFO ("preview callback: %" G_GUINT64_FORMAT " frames, %"
+        G_GUINT64_FORMAT " dropped", dev->raw_preview_frames,
+        dev->raw_preview_drops);
   }
 
   /* Now we need to empty the queue */
   g_mutex_lock (&dev->vfsrc->lock);
-  g_queue_foreach (dev->vfsrc->queue, (GFunc) gst_buffer_unref, NULL);
-  g_queue_clear (dev->vfsrc->queue);
+  gst_droidcamsrc_pad_flush_queue_locked (dev->vfsrc);
   g_mutex_unlock (&dev->vfsrc->lock);
 
   g_rec_mutex_unlock (dev->lock);
@@ -862,14 +1369,32 @@ out:
   return ret;
 }
 
+static gboolean
+gst_droidcamsrc_dev_take_picture_locked (GstDroidCamSrcDev * dev)
+{
+  int msg_type = dev->c.CAMERA_MSG_SHUTTER | dev->c.CAMERA_MSG_RAW_IMAGE
+      | dev->c.CAMERA_MSG_POSTVIEW_FRAME | dev->c.CAMERA_MSG_COMPRESSED_IMAGE;
+
+  GST_DEBUG ("taking picture %u of %u", dev->img->burst_sequence + 1,
+      dev->img->burst_shots);
+
+  /* hal-delivery-time is per shot, not since the start of the burst */
+  dev->img->shot_requested = gst_util_get_timestamp ();
+
+  if (!droid_media_camera_take_picture (dev->cam, msg_type)) {
+    GST_ERROR ("error capturing image");
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
 gboolean
 gst_droidcamsrc_dev_capture_image (GstDroidCamSrcDev * dev)
 {
   GstDroidCamSrc *src = GST_DROIDCAMSRC (GST_PAD_PARENT (dev->imgsrc->pad));
 
   gboolean ret = FALSE;
-  int msg_type = dev->c.CAMERA_MSG_SHUTTER | dev->c.CAMERA_MSG_RAW_IMAGE
-      | dev->c.CAMERA_MSG_POSTVIEW_FRAME | dev->c.CAMERA_MSG_COMPRESSED_IMAGE;
 
   GST_DEBUG ("dev capture image");
 
@@ -901,9 +1426,21 @@ gst_droidcamsrc_dev_capture_image (GstDroidCamSrcDev * dev)
   dev->img->image_start_sent = FALSE;
 
   dev->img->preview_image_requested = src->post_preview;
+  dev->img->capture_requested = gst_util_get_timestamp ();
 
-  if (!droid_media_camera_take_picture (dev->cam, msg_type)) {
-    GST_ERROR ("error capturing image");
+  /* the remaining shots of a burst are taken by the control thread as
+   * soon as the HAL delivered the previous one */
+  dev->img->burst = (src->image_mode & GST_DROIDCAMSRC_IMAGE_MODE_BURST) != 0;
+  dev->img->burst_shots = dev->img->burst ? MAX (src->burst_count, 1) : 1;
+  dev->img->burst_remaining = dev->img->burst_shots;
+  dev->img->burst_sequence = 0;
+
+  g_mutex_lock (&dev->image_lock);
+  dev->img->burst_dropped_base = dev->images_dropped;
+  g_mutex_unlock (&dev->image_lock);
+
+  if (!gst_droidcamsrc_dev_take_picture_locked (dev)) {
+    dev->img->burst_remaining = 0;
     goto out;
   }
 
@@ -944,9 +1481,7 @@ gst_droidcamsrc_dev_start_video_recording (GstDroidCamSrcDev * dev)
     g_mutex_unlock (&dev->last_preview_buffer_lock);
   }
 
-  g_mutex_lock (&dev->vidsrc->lock);
-  dev->vidsrc->pushed_buffers = 0;
-  g_mutex_unlock (&dev->vidsrc->lock);
+  g_atomic_int_set (&dev->vidsrc->pushed_buffers, 0);
 
   g_rec_mutex_lock (dev->lock);
   if (dev->use_raw_data) {
@@ -961,6 +1496,7 @@ gst_droidcamsrc_dev_start_video_recording (GstDroidCamSrcDev * dev)
   dev->vid->eos_sent = FALSE;
   dev->vid->video_frames = 0;
   dev->vid->queued_frames = 0;
+  dev->vid->queueing = 0;
 
   if (dev->use_recorder) {
     ret = gst_droidcamsrc_dev_start_video_recording_recorder_locked (dev);
@@ -1006,12 +1542,14 @@ gst_droidcamsrc_dev_stop_video_recording (GstDroidCamSrcDev * dev)
 
   /* now make sure nothing is being pushed to the queue */
   g_mutex_lock (&dev->vid->lock);
+  while (dev->vid->queueing > 0) {
+    g_cond_wait (&dev->vid->cond, &dev->vid->lock);
+  }
   g_mutex_unlock (&dev->vid->lock);
 
   /* our pad task is either sleeping or still pushing buffers. We empty the queue. */
   g_mutex_lock (&dev->vidsrc->lock);
-  g_queue_foreach (dev->vidsrc->queue, (GFunc) gst_buffer_unref, NULL);
-  g_queue_clear (dev->vidsrc->queue);
+  gst_droidcamsrc_pad_flush_queue_locked (dev->vidsrc);
   g_mutex_unlock (&dev->vidsrc->lock);
 
   /* now we are done. We just push eos */
@@ -1287,13 +1825,24 @@ void
 gst_droidcamsrc_dev_queue_video_buffer (GstDroidCamSrcDev * dev,
     GstBuffer * buffer)
 {
+  gboolean queue;
+
   g_mutex_lock (&dev->vid->lock);
-  gst_droidcamsrc_dev_queue_video_buffer_locked (dev, buffer);
+  queue = gst_droidcamsrc_dev_prepare_video_buffer_locked (dev, buffer);
   g_mutex_unlock (&dev->vid->lock);
+
+  if (queue) {
+    gst_droidcamsrc_dev_push_video_buffer (dev, buffer);
+  }
 }
 
-static void
-gst_droidcamsrc_dev_queue_video_buffer_locked (GstDroidCamSrcDev * dev,
+/*
+ * Returns TRUE if the buffer has to be handed to
+ * gst_droidcamsrc_dev_push_video_buffer () once vid->lock is released.
+ * Queueing may wait for room in vidsrc so it must not hold vid->lock.
+ */
+static gboolean
+gst_droidcamsrc_dev_prepare_video_buffer_locked (GstDroidCamSrcDev * dev,
     GstBuffer * buffer)
 {
   GstDroidCamSrc *src = GST_DROIDCAMSRC (GST_PAD_PARENT (dev->imgsrc->pad));
@@ -1313,14 +1862,26 @@ gst_droidcamsrc_dev_queue_video_buffer_locked (GstDroidCamSrcDev * dev,
         "dropping buffer because video recording is not running");
     gst_buffer_unref (buffer);
   } else {
-    g_mutex_lock (&dev->vidsrc->lock);
-    g_queue_push_tail (dev->vidsrc->queue, buffer);
-    g_cond_signal (&dev->vidsrc->cond);
-    g_mutex_unlock (&dev->vidsrc->lock);
+    /* stop_video_recording() waits for us before flushing vidsrc */
+    dev->vid->queueing++;
   }
 
   /* in case stop_video_recording() is waiting for us */
   g_cond_signal (&dev->vid->cond);
+
+  return !drop_buffer;
+}
+
+static void
+gst_droidcamsrc_dev_push_video_buffer (GstDroidCamSrcDev * dev,
+    GstBuffer * buffer)
+{
+  gst_droidcamsrc_pad_queue_buffer (dev->vidsrc, buffer);
+
+  g_mutex_lock (&dev->vid->lock);
+  dev->vid->queueing--;
+  g_cond_signal (&dev->vid->cond);
+  g_mutex_unlock (&dev->vid->lock);
 }
 
 void
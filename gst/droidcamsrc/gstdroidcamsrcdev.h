@@ -27,6 +27,7 @@
 #include "gstdroidcamsrcparams.h"
 #include "droidmediacamera.h"
 #include "droidmediaconstants.h"
+#include "gst/droid/gstdroidstagingpool.h"
 
 G_BEGIN_DECLS
 
@@ -55,6 +56,30 @@ struct _GstDroidCamSrcDev
   GstDroidCamSrcVideoCaptureState *vid;
   GstBufferPool *pool;
   DroidMediaCameraConstants c;
+
+  /* recycles the copies made in the preview frame callback, only in raw
+   * preview mode. The callback does not take dev->lock so the pool is
+   * swapped and referenced under raw_pool_lock */
+  GstBufferPool *raw_pool;
+  gsize raw_pool_size;
+  GMutex raw_pool_lock;
+  guint64 raw_preview_frames;
+  guint64 raw_preview_drops;
+
+  /* recycles the copies made in the compressed image callback */
+  GstDroidStagingPool *image_pool;
+
+  /* EXIF parsing and imgsrc queueing happen here, off the HAL thread */
+  GThreadPool *image_worker;
+  GMutex image_lock;
+  GCond image_cond;
+  guint pending_images;
+  guint images_dropped;
+
+  /* restarts the preview after a non-ZSL capture, off the HAL thread */
+  GThreadPool *control_worker;
+  gboolean restart_pending;
+
   GstVideoFormat viewfinder_format;
 
   GstBuffer *last_preview_buffer;
@@ -102,6 +127,9 @@ void gst_droidcamsrc_dev_queue_video_buffer (GstDroidCamSrcDev * dev, GstBuffer
 
 void gst_droidcamsrc_dev_update_preview_callback_flag (GstDroidCamSrcDev * dev);
 
+/* takes ownership of pool */
+void gst_droidcamsrc_dev_set_raw_pool (GstDroidCamSrcDev * dev, GstBufferPool * pool, gsize size);
+
 G_END_DECLS
 
 #endif /* __GST_DROIDCAMSRC_DEV_H__ */
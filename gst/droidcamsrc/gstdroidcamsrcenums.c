@@ -33,6 +33,7 @@ gst_droidcamsrc_image_mode_get_type (void)
     {GST_DROIDCAMSRC_IMAGE_MODE_NORMAL, "Normal image mode", "normal"},
     {GST_DROIDCAMSRC_IMAGE_MODE_ZSL, "ZSL image mode", "zsl"},
     {GST_DROIDCAMSRC_IMAGE_MODE_HDR, "HDR image mode", "hdr"},
+    {GST_DROIDCAMSRC_IMAGE_MODE_BURST, "Burst image mode", "burst"},
     {0, NULL, NULL},
   };
 
@@ -43,3 +44,25 @@ gst_droidcamsrc_image_mode_get_type (void)
   }
   return gst_droidcamsrc_image_mode_type;
 }
+
+GType
+gst_droidcamsrc_queue_leaky_get_type (void)
+{
+  static GType gst_droidcamsrc_queue_leaky_type = 0;
+  static GEnumValue gst_droidcamsrc_queue_leaky[] = {
+    {GST_DROIDCAMSRC_QUEUE_LEAKY_DROP_OLDEST, "Drop the oldest queued frame",
+        "drop-oldest"},
+    {GST_DROIDCAMSRC_QUEUE_LEAKY_DROP_NEWEST, "Drop the incoming frame",
+        "drop-newest"},
+    {GST_DROIDCAMSRC_QUEUE_LEAKY_WAIT,
+        "Wait up to 200ms for room, then drop the incoming frame", "wait"},
+    {0, NULL, NULL},
+  };
+
+  if (G_UNLIKELY (!gst_droidcamsrc_queue_leaky_type)) {
+    gst_droidcamsrc_queue_leaky_type =
+        g_enum_register_static ("GstDroidCamSrcQueueLeaky",
+        gst_droidcamsrc_queue_leaky);
+  }
+  return gst_droidcamsrc_queue_leaky_type;
+}
@@ -32,11 +32,22 @@ typedef enum {
   GST_DROIDCAMSRC_IMAGE_MODE_NORMAL = 0x0,
   GST_DROIDCAMSRC_IMAGE_MODE_ZSL = 0x1,
   GST_DROIDCAMSRC_IMAGE_MODE_HDR = 0x2,
+  GST_DROIDCAMSRC_IMAGE_MODE_BURST = 0x4,
 } GstDroidCamSrcImageMode;
 
 GType gst_droidcamsrc_image_mode_get_type (void);
 GType gst_droidcamsrc_supported_image_modes_get_type (void);
 
+#define GST_TYPE_DROIDCAMSRC_QUEUE_LEAKY (gst_droidcamsrc_queue_leaky_get_type())
+
+typedef enum {
+  GST_DROIDCAMSRC_QUEUE_LEAKY_DROP_OLDEST = 0,
+  GST_DROIDCAMSRC_QUEUE_LEAKY_DROP_NEWEST = 1,
+  GST_DROIDCAMSRC_QUEUE_LEAKY_WAIT = 2,
+} GstDroidCamSrcQueueLeaky;
+
+GType gst_droidcamsrc_queue_leaky_get_type (void);
+
 typedef enum {
   GST_DROIDCAMSRC_ROI_FOCUS_AREA = 0x1,
   GST_DROIDCAMSRC_ROI_METERING_AREA = 0x2,
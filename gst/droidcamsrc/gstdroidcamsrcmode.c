@@ -206,8 +206,7 @@ gst_droidcamsrc_mode_negotiate_pad (GstDroidCamSrcMode * mode, GstPad * pad,
   }
 
   /* toss pad queue */
-  g_queue_foreach (data->queue, (GFunc) gst_buffer_unref, NULL);
-  g_queue_clear (data->queue);
+  gst_droidcamsrc_pad_flush_queue_locked (data);
 
   /* unlock */
   g_mutex_unlock (&data->lock);
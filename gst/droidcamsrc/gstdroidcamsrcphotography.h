@@ -82,7 +82,15 @@ typedef enum
   /* camerabin interface */
   PROP_POST_PREVIEW,
   PROP_PREVIEW_CAPS,
-  PROP_PREVIEW_FILTER
+  PROP_PREVIEW_FILTER,
+
+  PROP_RAW_PREVIEW_MIN_BUFFERS,
+  PROP_RAW_PREVIEW_MAX_BUFFERS,
+  PROP_BURST_COUNT,
+  PROP_VFSRC_MAX_QUEUE_DEPTH,
+  PROP_VFSRC_LEAKY,
+  PROP_VIDSRC_MAX_QUEUE_DEPTH,
+  PROP_VIDSRC_LEAKY
 } GstDroidCamSrcProperties;
 
 void gst_droidcamsrc_photography_register (gpointer g_iface,  gpointer iface_data);
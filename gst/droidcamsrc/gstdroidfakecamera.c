@@ -0,0 +1,557 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2015-2021 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gstdroidfakecamera.h"
+#include "gstdroidcamsrc.h"
+#include "plugin.h"
+#include <stdio.h>              /* sscanf() */
+#include <string.h>
+
+/* what plugin.c would otherwise provide */
+GST_DEBUG_CATEGORY (gst_droid_camsrc_debug);
+
+/* OpenMAX IL values */
+#define FAKE_CAMERA_YUV420_PLANAR          19
+#define FAKE_CAMERA_YUV420_PACKED_PLANAR   20
+#define FAKE_CAMERA_YUV420_SEMI_PLANAR     21
+
+/* android camera1 values */
+#define FAKE_CAMERA_MSG_SHUTTER            0x0002
+#define FAKE_CAMERA_MSG_POSTVIEW_FRAME     0x0040
+#define FAKE_CAMERA_MSG_RAW_IMAGE          0x0080
+#define FAKE_CAMERA_MSG_COMPRESSED_IMAGE   0x0100
+#define FAKE_CAMERA_FRAME_CALLBACK_FLAG_NOOP      0x00
+#define FAKE_CAMERA_FRAME_CALLBACK_FLAG_CAMERA    0x05
+#define FAKE_CAMERA_CMD_ENABLE_SHUTTER_SOUND      4
+
+#define FAKE_CAMERA_WIDTH                  640
+#define FAKE_CAMERA_HEIGHT                 480
+
+/* enough for the element to negotiate and for the photography interface */
+static const gchar fake_camera_params[] =
+    "preview-size=640x480;preview-size-values=640x480,320x240;"
+    "preview-frame-rate=30;preview-frame-rate-values=15,30;"
+    "preview-fps-range=30000,30000;"
+    "preview-fps-range-values=(15000,30000),(30000,30000);"
+    "preview-format=yuv420sp;picture-size=4000x3000;"
+    "picture-size-values=4000x3000,1920x1080;picture-format=jpeg;"
+    "jpeg-quality=95;max-zoom=4;zoom=0;zoom-supported=true;"
+    "exposure-compensation=0;exposure-compensation-step=0.5;"
+    "min-exposure-compensation=-4;max-exposure-compensation=4;"
+    "max-num-focus-areas=1;max-num-metering-areas=1;"
+    "focus-mode=auto;focus-mode-values=auto,infinity,continuous-picture;"
+    "flash-mode=off;flash-mode-values=off,on,auto;"
+    "effect=none;effect-values=none,mono;"
+    "scene-mode=auto;scene-mode-values=auto,night;"
+    "whitebalance=auto;whitebalance-values=auto,daylight;"
+    "iso=auto;iso-values=auto,100,200,400;"
+    "antibanding=auto;antibanding-values=off,auto";
+
+/* SOI and a JFIF APP0 segment, the rest of the picture is filler */
+static const guint8 fake_camera_jpeg_header[] = {
+  0xff, 0xd8, 0xff, 0xe0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00, 0x01,
+  0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00
+};
+
+typedef struct
+{
+  DroidMediaCameraCallbacks cb;
+  void *cb_data;
+  gchar *params;
+
+  GMutex lock;
+  GCond cond;
+  GThread *thread;
+  gboolean connected;
+
+  /* the preview, frames are delivered at next_frame (monotonic us) */
+  gboolean previewing;
+  int callback_flags;
+  gint width;
+  gint height;
+  gint64 frame_interval;
+  gint64 next_frame;
+  guint8 *frame;
+  gsize frame_size;
+
+  /* a picture between take_picture () and its delivery */
+  int picture_msgs;
+  gint64 picture_due;
+  gsize picture_due_size;
+  guint8 *picture;
+  gsize picture_size;
+} FakeCamera;
+
+static GMutex fake_camera_lock;
+static GstDroidFakeCameraConfig fake_camera_config;
+static GstDroidFakeCameraStats fake_camera_stats;
+
+void
+gst_droid_fake_camera_configure (const GstDroidFakeCameraConfig * config)
+{
+  g_mutex_lock (&fake_camera_lock);
+  fake_camera_config = *config;
+  g_mutex_unlock (&fake_camera_lock);
+}
+
+void
+gst_droid_fake_camera_get_stats (GstDroidFakeCameraStats * stats)
+{
+  g_mutex_lock (&fake_camera_lock);
+  *stats = fake_camera_stats;
+  g_mutex_unlock (&fake_camera_lock);
+}
+
+void
+gst_droid_fake_camera_reset_stats (void)
+{
+  g_mutex_lock (&fake_camera_lock);
+  memset (&fake_camera_stats, 0x0, sizeof (fake_camera_stats));
+  g_mutex_unlock (&fake_camera_lock);
+}
+
+gboolean
+gst_droid_fake_camera_register_elements (void)
+{
+  GST_DEBUG_CATEGORY_INIT (gst_droid_camsrc_debug, "droidcamsrc",
+      0, "Android HAL camera source");
+
+  return gst_element_register (NULL, "droidcamsrc", GST_RANK_NONE,
+      GST_TYPE_DROIDCAMSRC);
+}
+
+gboolean
+gst_droid_media_ensure_init (GstElement * element)
+{
+  return TRUE;
+}
+
+/* the preview size is whatever the element set last */
+static void
+fake_camera_parse_preview_size (FakeCamera * cam, const char *params)
+{
+  const gchar *size = strstr (params, "preview-size=");
+  gint width, height;
+
+  if (size && sscanf (size, "preview-size=%dx%d", &width, &height) == 2
+      && width > 0 && height > 0) {
+    cam->width = width;
+    cam->height = height;
+  }
+}
+
+/* called without the lock, returns how long the callback took */
+static GstClockTime
+fake_camera_deliver_frame (FakeCamera * cam, gint width, gint height)
+{
+  DroidMediaData data;
+  GstClockTime start;
+  gsize size = (gsize) width * height * 3 / 2;
+
+  if (cam->frame_size != size) {
+    g_free (cam->frame);
+    /* mid grey */
+    cam->frame = g_malloc (size);
+    memset (cam->frame, 0x80, size);
+    cam->frame_size = size;
+  }
+
+  data.data = cam->frame;
+  data.size = cam->frame_size;
+
+  start = gst_util_get_timestamp ();
+  cam->cb.preview_frame_cb (cam->cb_data, &data);
+  return gst_util_get_timestamp () - start;
+}
+
+/* called without the lock, returns how long the callback took */
+static GstClockTime
+fake_camera_deliver_picture (FakeCamera * cam, gsize size)
+{
+  DroidMediaData data;
+  GstClockTime start;
+
+  size = MAX (size, sizeof (fake_camera_jpeg_header) + 2);
+
+  if (cam->picture_size != size) {
+    g_free (cam->picture);
+    cam->picture = g_malloc0 (size);
+    memcpy (cam->picture, fake_camera_jpeg_header,
+        sizeof (fake_camera_jpeg_header));
+    cam->picture_size = size;
+    /* EOI */
+    cam->picture[cam->picture_size - 2] = 0xff;
+    cam->picture[cam->picture_size - 1] = 0xd9;
+  }
+
+  data.data = cam->picture;
+  data.size = cam->picture_size;
+
+  start = gst_util_get_timestamp ();
+  cam->cb.compressed_image_cb (cam->cb_data, &data);
+  return gst_util_get_timestamp () - start;
+}
+
+static gpointer
+fake_camera_thread (gpointer user_data)
+{
+  FakeCamera *cam = user_data;
+  GstClockTime took;
+
+  g_mutex_lock (&cam->lock);
+
+  while (cam->connected) {
+    gint64 now = g_get_monotonic_time ();
+    gint64 wake = G_MAXINT64;
+
+    if (cam->picture_msgs & FAKE_CAMERA_MSG_SHUTTER) {
+      cam->picture_msgs &= ~FAKE_CAMERA_MSG_SHUTTER;
+
+      g_mutex_unlock (&cam->lock);
+      cam->cb.shutter_cb (cam->cb_data);
+      g_mutex_lock (&cam->lock);
+      continue;
+    }
+
+    if (cam->picture_msgs) {
+      if (now < cam->picture_due) {
+        wake = cam->picture_due;
+      } else {
+        /* the picture is taken, the HAL may get the next request */
+        gboolean compressed =
+            (cam->picture_msgs & FAKE_CAMERA_MSG_COMPRESSED_IMAGE) != 0;
+        gsize size = cam->picture_due_size;
+
+        cam->picture_msgs = 0;
+
+        if (compressed) {
+          g_mutex_unlock (&cam->lock);
+          took = fake_camera_deliver_picture (cam, size);
+          g_mutex_lock (&cam->lock);
+
+          g_mutex_lock (&fake_camera_lock);
+          fake_camera_stats.pictures_delivered++;
+          fake_camera_stats.picture_callback_last = took;
+          g_mutex_unlock (&fake_camera_lock);
+        }
+        continue;
+      }
+    }
+
+    if (cam->previewing && cam->frame_interval > 0) {
+      if (now < cam->next_frame) {
+        wake = MIN (wake, cam->next_frame);
+      } else {
+        /* a frame nobody took in time is gone, like on a sensor */
+        cam->next_frame += cam->frame_interval;
+        if (cam->next_frame <= now) {
+          cam->next_frame = now + cam->frame_interval;
+        }
+
+        if (cam->callback_flags & FAKE_CAMERA_FRAME_CALLBACK_FLAG_CAMERA) {
+          gint width = cam->width;
+          gint height = cam->height;
+
+          g_mutex_unlock (&cam->lock);
+          took = fake_camera_deliver_frame (cam, width, height);
+          g_mutex_lock (&cam->lock);
+
+          g_mutex_lock (&fake_camera_lock);
+          fake_camera_stats.preview_frames++;
+          fake_camera_stats.preview_callback_max =
+              MAX (fake_camera_stats.preview_callback_max, took);
+          g_mutex_unlock (&fake_camera_lock);
+        }
+        continue;
+      }
+    }
+
+    if (wake == G_MAXINT64) {
+      g_cond_wait (&cam->cond, &cam->lock);
+    } else {
+      g_cond_wait_until (&cam->cond, &cam->lock, wake);
+    }
+  }
+
+  g_mutex_unlock (&cam->lock);
+
+  return NULL;
+}
+
+void
+droid_media_colour_format_constants_init (DroidMediaColourFormatConstants * c)
+{
+  /* anything we don't set can't be matched by what the camera reports */
+  memset (c, 0x0, sizeof (*c));
+
+  c->OMX_COLOR_FormatYUV420Planar = FAKE_CAMERA_YUV420_PLANAR;
+  c->OMX_COLOR_FormatYUV420PackedPlanar = FAKE_CAMERA_YUV420_PACKED_PLANAR;
+  c->OMX_COLOR_FormatYUV420SemiPlanar = FAKE_CAMERA_YUV420_SEMI_PLANAR;
+}
+
+void
+droid_media_camera_constants_init (DroidMediaCameraConstants * c)
+{
+  memset (c, 0x0, sizeof (*c));
+
+  c->CAMERA_MSG_SHUTTER = FAKE_CAMERA_MSG_SHUTTER;
+  c->CAMERA_MSG_POSTVIEW_FRAME = FAKE_CAMERA_MSG_POSTVIEW_FRAME;
+  c->CAMERA_MSG_RAW_IMAGE = FAKE_CAMERA_MSG_RAW_IMAGE;
+  c->CAMERA_MSG_COMPRESSED_IMAGE = FAKE_CAMERA_MSG_COMPRESSED_IMAGE;
+  c->CAMERA_FRAME_CALLBACK_FLAG_NOOP = FAKE_CAMERA_FRAME_CALLBACK_FLAG_NOOP;
+  c->CAMERA_FRAME_CALLBACK_FLAG_CAMERA = FAKE_CAMERA_FRAME_CALLBACK_FLAG_CAMERA;
+  c->CAMERA_CMD_ENABLE_SHUTTER_SOUND = FAKE_CAMERA_CMD_ENABLE_SHUTTER_SOUND;
+}
+
+void
+droid_media_buffer_queue_set_callbacks (DroidMediaBufferQueue * queue,
+    DroidMediaBufferQueueCallbacks * cb, void *data)
+{
+  /* we never hand out a buffer queue */
+}
+
+int
+droid_media_camera_get_number_of_cameras ()
+{
+  return 1;
+}
+
+bool
+droid_media_camera_get_info (DroidMediaCameraInfo * info, int camera_number)
+{
+  if (camera_number != 0) {
+    return false;
+  }
+
+  info->facing = DROID_MEDIA_CAMERA_FACING_BACK;
+  info->orientation = 0;
+
+  return true;
+}
+
+DroidMediaCamera *
+droid_media_camera_connect (int camera_number)
+{
+  FakeCamera *cam;
+
+  if (camera_number != 0) {
+    return NULL;
+  }
+
+  cam = g_slice_new0 (FakeCamera);
+  cam->params = g_strdup (fake_camera_params);
+  cam->width = FAKE_CAMERA_WIDTH;
+  cam->height = FAKE_CAMERA_HEIGHT;
+  cam->connected = TRUE;
+
+  g_mutex_init (&cam->lock);
+  g_cond_init (&cam->cond);
+
+  cam->thread = g_thread_new ("fakecamera", fake_camera_thread, cam);
+
+  return (DroidMediaCamera *) cam;
+}
+
+void
+droid_media_camera_disconnect (DroidMediaCamera * camera)
+{
+  FakeCamera *cam = (FakeCamera *) camera;
+
+  g_mutex_lock (&cam->lock);
+  cam->connected = FALSE;
+  g_cond_signal (&cam->cond);
+  g_mutex_unlock (&cam->lock);
+
+  g_thread_join (cam->thread);
+
+  g_free (cam->params);
+  g_free (cam->frame);
+  g_free (cam->picture);
+  g_mutex_clear (&cam->lock);
+  g_cond_clear (&cam->cond);
+  g_slice_free (FakeCamera, cam);
+}
+
+bool
+droid_media_camera_lock (DroidMediaCamera * camera)
+{
+  return true;
+}
+
+int32_t
+droid_media_camera_get_video_color_format (DroidMediaCamera * camera)
+{
+  return FAKE_CAMERA_YUV420_SEMI_PLANAR;
+}
+
+DroidMediaBufferQueue *
+droid_media_camera_get_buffer_queue (DroidMediaCamera * camera)
+{
+  /* always the preview frame callback */
+  return NULL;
+}
+
+void
+droid_media_camera_set_callbacks (DroidMediaCamera * camera,
+    DroidMediaCameraCallbacks * cb, void *data)
+{
+  FakeCamera *cam = (FakeCamera *) camera;
+
+  g_mutex_lock (&cam->lock);
+  cam->cb = *cb;
+  cam->cb_data = data;
+  g_mutex_unlock (&cam->lock);
+}
+
+bool
+droid_media_camera_send_command (DroidMediaCamera * camera, int32_t cmd,
+    int32_t arg1, int32_t arg2)
+{
+  return true;
+}
+
+bool
+droid_media_camera_enable_face_detection (DroidMediaCamera * camera,
+    DroidMediaCameraFaceDetectionType type, bool enable)
+{
+  /* and never finds any */
+  return true;
+}
+
+bool
+droid_media_camera_set_parameters (DroidMediaCamera * camera,
+    const char *params)
+{
+  FakeCamera *cam = (FakeCamera *) camera;
+
+  g_mutex_lock (&cam->lock);
+  g_free (cam->params);
+  cam->params = g_strdup (params);
+  fake_camera_parse_preview_size (cam, params);
+  g_mutex_unlock (&cam->lock);
+
+  return true;
+}
+
+char *
+droid_media_camera_get_parameters (DroidMediaCamera * camera)
+{
+  FakeCamera *cam = (FakeCamera *) camera;
+  char *params;
+
+  /* the caller frees it with free () */
+  g_mutex_lock (&cam->lock);
+  params = strdup (cam->params);
+  g_mutex_unlock (&cam->lock);
+
+  return params;
+}
+
+void
+droid_media_camera_set_preview_callback_flags (DroidMediaCamera * camera,
+    int flags)
+{
+  FakeCamera *cam = (FakeCamera *) camera;
+
+  g_mutex_lock (&cam->lock);
+  cam->callback_flags = flags;
+  g_mutex_unlock (&cam->lock);
+}
+
+bool
+droid_media_camera_start_preview (DroidMediaCamera * camera)
+{
+  FakeCamera *cam = (FakeCamera *) camera;
+  GstDroidFakeCameraConfig config;
+
+  g_mutex_lock (&fake_camera_lock);
+  config = fake_camera_config;
+  g_mutex_unlock (&fake_camera_lock);
+
+  if (config.start_preview_time > 0) {
+    g_usleep (GST_TIME_AS_USECONDS (config.start_preview_time));
+  }
+
+  g_mutex_lock (&cam->lock);
+
+  cam->previewing = TRUE;
+  cam->frame_interval =
+      config.preview_fps > 0 ? G_USEC_PER_SEC / config.preview_fps : 0;
+  cam->next_frame = g_get_monotonic_time () + cam->frame_interval;
+  g_cond_signal (&cam->cond);
+
+  g_mutex_unlock (&cam->lock);
+
+  return true;
+}
+
+void
+droid_media_camera_stop_preview (DroidMediaCamera * camera)
+{
+  FakeCamera *cam = (FakeCamera *) camera;
+
+  /* a frame callback already running is not waited for */
+  g_mutex_lock (&cam->lock);
+  cam->previewing = FALSE;
+  g_mutex_unlock (&cam->lock);
+}
+
+bool
+droid_media_camera_take_picture (DroidMediaCamera * camera, int msgType)
+{
+  FakeCamera *cam = (FakeCamera *) camera;
+  GstDroidFakeCameraConfig config;
+  gboolean ok;
+
+  g_mutex_lock (&fake_camera_lock);
+  config = fake_camera_config;
+  g_mutex_unlock (&fake_camera_lock);
+
+  g_mutex_lock (&cam->lock);
+
+  /* camera1 needs a running preview and takes one picture at a time */
+  ok = cam->previewing && !cam->picture_msgs;
+
+  if (ok) {
+    cam->previewing = FALSE;
+    cam->picture_msgs = msgType &
+        (FAKE_CAMERA_MSG_SHUTTER | FAKE_CAMERA_MSG_COMPRESSED_IMAGE);
+    cam->picture_due = g_get_monotonic_time () +
+        GST_TIME_AS_USECONDS (config.capture_time);
+    cam->picture_due_size = config.picture_size;
+    g_cond_signal (&cam->cond);
+  }
+
+  g_mutex_unlock (&cam->lock);
+
+  g_mutex_lock (&fake_camera_lock);
+  if (ok) {
+    fake_camera_stats.pictures_taken++;
+  } else {
+    fake_camera_stats.pictures_refused++;
+  }
+  g_mutex_unlock (&fake_camera_lock);
+
+  return ok ? true : false;
+}
@@ -0,0 +1,90 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2015-2021 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __GST_DROID_FAKE_CAMERA_H__
+#define __GST_DROID_FAKE_CAMERA_H__
+
+#include <gst/gst.h>
+#include "droidmediacamera.h"
+
+G_BEGIN_DECLS
+
+/*
+ * A stand-in for the droidmedia camera API. Linking it into a test
+ * executable overrides the droid_media_camera_* symbols of libdroidmedia
+ * so droidcamsrc can be run without Android.
+ *
+ * There is one back facing camera. It has no buffer queue, so the
+ * viewfinder only works through the preview frame callback, which
+ * delivers NV21 (OMX_COLOR_FormatYUV420SemiPlanar) frames at the
+ * preview-size last set. take_picture () stops the preview like camera1
+ * does, then delivers the shutter callback right away and a JPEG through
+ * the compressed image callback once the capture time is up. Raw and
+ * postview images are never delivered. Video recording is not faked.
+ *
+ * All callbacks come from a thread of the camera's own. Disconnecting
+ * waits for it, so like with a real HAL the camera must not be closed
+ * while a picture is still on its way.
+ */
+
+typedef struct
+{
+  /* preview frames per second */
+  guint preview_fps;
+
+  /* how long start_preview () takes */
+  GstClockTime start_preview_time;
+
+  /* the JPEG size and the time from take_picture () to its delivery */
+  gsize picture_size;
+  GstClockTime capture_time;
+} GstDroidFakeCameraConfig;
+
+typedef struct
+{
+  guint preview_frames;
+  /* the longest the element held on to a preview frame callback */
+  GstClockTime preview_callback_max;
+
+  guint pictures_taken;
+  /* take_picture () calls made while the camera could not take one */
+  guint pictures_refused;
+  /* compressed image callbacks that returned */
+  guint pictures_delivered;
+  /* how long the element held on to the last one */
+  GstClockTime picture_callback_last;
+} GstDroidFakeCameraStats;
+
+/*
+ * The preview settings apply from the next start_preview (), the picture
+ * settings from the next take_picture ()
+ */
+void gst_droid_fake_camera_configure (const GstDroidFakeCameraConfig *
+    config);
+
+void gst_droid_fake_camera_get_stats (GstDroidFakeCameraStats * stats);
+void gst_droid_fake_camera_reset_stats (void);
+
+/* registers droidcamsrc, without loading the plugin */
+gboolean gst_droid_fake_camera_register_elements (void);
+
+G_END_DECLS
+
+#endif /* __GST_DROID_FAKE_CAMERA_H__ */
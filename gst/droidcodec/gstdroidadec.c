@@ -38,6 +38,12 @@ G_DEFINE_TYPE (GstDroidADec, gst_droidadec, GST_TYPE_AUDIO_DECODER);
 GST_DEBUG_CATEGORY_EXTERN (gst_droid_adec_debug);
 #define GST_CAT_DEFAULT gst_droid_adec_debug
 
+enum
+{
+  PROP_0,
+  PROP_STATS,
+};
+
 static GstStaticPadTemplate gst_droidadec_src_template_factory =
 GST_STATIC_PAD_TEMPLATE (GST_AUDIO_DECODER_SRC_NAME,
     GST_PAD_SRC,
@@ -311,9 +317,7 @@ gst_droidadec_open (GstAudioDecoder * decoder)
 
   GST_DEBUG_OBJECT (dec, "open");
 
-  /* nothing to do here */
-
-  return TRUE;
+  return gst_droid_media_ensure_init (GST_ELEMENT (dec));
 }
 
 static gboolean
@@ -535,16 +539,13 @@ gst_droidadec_handle_frame (GstAudioDecoder * decoder, GstBuffer * buffer)
     dec->dirty = FALSE;
   }
 
-  if (!gst_droid_codec_process_decoder_data (dec->codec_type, buffer,
-          &data.data)) {
+  if (!gst_droid_codec_prepare_decoder_data (dec->codec_type, buffer,
+          &data.data, &cb)) {
     /* TODO: error */
     ret = GST_FLOW_ERROR;
     goto error;
   }
 
-  cb.unref = g_free;
-  cb.data = data.data.data;
-
   GST_DEBUG_OBJECT (dec, "decoding data of size %"G_GSIZE_FORMAT" (%"G_GSSIZE_FORMAT")",
       gst_buffer_get_size (buffer), data.data.size);
 
@@ -615,6 +616,41 @@ gst_droidadec_flush (GstAudioDecoder * decoder, gboolean hard)
   g_mutex_unlock (&dec->eos_lock);
 }
 
+static GstStructure *
+gst_droidadec_get_stats (GstDroidADec * dec)
+{
+  GstStructure *stats = gst_structure_new_empty ("GstDroidADecStats");
+
+  GST_AUDIO_DECODER_STREAM_LOCK (dec);
+
+  if (dec->codec_type) {
+    GstStructure *staging = gst_droid_codec_get_staging_stats (dec->codec_type);
+    gst_structure_set (stats, "input-staging", GST_TYPE_STRUCTURE, staging,
+        NULL);
+    gst_structure_free (staging);
+  }
+
+  GST_AUDIO_DECODER_STREAM_UNLOCK (dec);
+
+  return stats;
+}
+
+static void
+gst_droidadec_get_property (GObject * object, guint prop_id, GValue * value,
+    GParamSpec * pspec)
+{
+  GstDroidADec *dec = GST_DROIDADEC (object);
+
+  switch (prop_id) {
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_droidadec_get_stats (dec));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
 static void
 gst_droidadec_init (GstDroidADec * dec)
 {
@@ -660,6 +696,7 @@ gst_droidadec_class_init (GstDroidADecClass * klass)
       gst_static_pad_template_get (&gst_droidadec_src_template_factory));
 
   gobject_class->finalize = gst_droidadec_finalize;
+  gobject_class->get_property = gst_droidadec_get_property;
 
   gstaudiodecoder_class->open = GST_DEBUG_FUNCPTR (gst_droidadec_open);
   gstaudiodecoder_class->close = GST_DEBUG_FUNCPTR (gst_droidadec_close);
@@ -670,4 +707,9 @@ gst_droidadec_class_init (GstDroidADecClass * klass)
   gstaudiodecoder_class->handle_frame =
       GST_DEBUG_FUNCPTR (gst_droidadec_handle_frame);
   gstaudiodecoder_class->flush = GST_DEBUG_FUNCPTR (gst_droidadec_flush);
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Decoder statistics", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 }
@@ -0,0 +1,217 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2015-2021 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Runs droidaenc against the fake codec, which only reads its inputs
+ * once the stream is drained. By then every upstream buffer is gone and
+ * its memory poisoned, so an input that still points at upstream memory
+ * shows up as a wrong byte, and one that was copied reads back intact.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gstdroidfakecodec.h"
+#include <gst/app/gstappsrc.h>
+#include <gst/audio/audio.h>
+#include <stdlib.h>
+#include <string.h>             /* memset() */
+
+#define TEST_BUFFERS        16
+/* 1024 stereo S16 samples, which is one AAC frame */
+#define TEST_BUFFER_SIZE    (1024 * 2 * 2)
+#define TEST_POISON         0xdd
+#define TEST_TIMEOUT        (10 * GST_SECOND)
+
+typedef struct
+{
+  GMutex lock;
+  /* upstream memory, kept around after it is released so it stays poisoned */
+  guint8 *upstream[TEST_BUFFERS];
+  guint released;
+  /* what the codec has read so far */
+  gsize offset;
+  guint inputs;
+  gboolean failed;
+} TestState;
+
+static TestState state;
+
+static guint8
+test_pattern (gsize offset)
+{
+  return offset * 31 + 7;
+}
+
+static void
+test_release (gpointer data)
+{
+  memset (data, TEST_POISON, TEST_BUFFER_SIZE);
+
+  g_mutex_lock (&state.lock);
+  state.released++;
+  g_mutex_unlock (&state.lock);
+}
+
+static void
+test_input (const DroidMediaData * data, gpointer user_data)
+{
+  const guint8 *in = data->data;
+  gsize i;
+  guint b;
+
+  g_mutex_lock (&state.lock);
+
+  state.inputs++;
+
+  for (b = 0; b < TEST_BUFFERS; b++) {
+    if (in + data->size > state.upstream[b]
+        && in < state.upstream[b] + TEST_BUFFER_SIZE) {
+      g_printerr ("input %u points at upstream buffer %u\n", state.inputs, b);
+      state.failed = TRUE;
+    }
+  }
+
+  for (i = 0; i < data->size; i++) {
+    if (in[i] != test_pattern (state.offset + i)) {
+      g_printerr ("input %u differs at byte %" G_GSIZE_FORMAT
+          ": got 0x%02x, expected 0x%02x\n", state.inputs, state.offset + i,
+          in[i], test_pattern (state.offset + i));
+      state.failed = TRUE;
+      break;
+    }
+  }
+
+  state.offset += data->size;
+
+  g_mutex_unlock (&state.lock);
+}
+
+static gboolean
+test_run (void)
+{
+  GstDroidFakeCodecConfig config;
+  GstElement *pipeline, *src;
+  GstMessage *msg;
+  GError *err = NULL;
+  gboolean ret = FALSE;
+  guint b;
+  gsize i;
+
+  memset (&config, 0x0, sizeof (config));
+  config.input = test_input;
+  config.hold_input = TRUE;
+  gst_droid_fake_codec_configure (&config);
+
+  pipeline = gst_parse_launch ("appsrc name=src format=time "
+      "caps=audio/x-raw,format=" GST_AUDIO_NE (S16)
+      ",layout=interleaved,rate=44100,channels=2 "
+      "! droidaenc ! fakesink", &err);
+  if (!pipeline) {
+    g_printerr ("failed to create the pipeline: %s\n", err->message);
+    g_error_free (err);
+    return FALSE;
+  }
+
+  src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  for (b = 0; b < TEST_BUFFERS; b++) {
+    GstBuffer *buffer;
+
+    state.upstream[b] = g_malloc (TEST_BUFFER_SIZE);
+    for (i = 0; i < TEST_BUFFER_SIZE; i++) {
+      state.upstream[b][i] = test_pattern (b * TEST_BUFFER_SIZE + i);
+    }
+
+    buffer = gst_buffer_new_wrapped_full (0, state.upstream[b],
+        TEST_BUFFER_SIZE, 0, TEST_BUFFER_SIZE, state.upstream[b],
+        test_release);
+    GST_BUFFER_PTS (buffer) =
+        gst_util_uint64_scale (b * 1024, GST_SECOND, 44100);
+    GST_BUFFER_DURATION (buffer) =
+        gst_util_uint64_scale (1024, GST_SECOND, 44100);
+
+    gst_app_src_push_buffer (GST_APP_SRC (src), buffer);
+  }
+
+  gst_app_src_end_of_stream (GST_APP_SRC (src));
+
+  msg = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (pipeline), TEST_TIMEOUT,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  if (!msg) {
+    g_printerr ("timed out waiting for EOS\n");
+  } else if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+    gst_message_parse_error (msg, &err, NULL);
+    g_printerr ("pipeline error: %s\n", err->message);
+    g_error_free (err);
+  } else {
+    ret = TRUE;
+  }
+
+  if (msg) {
+    gst_message_unref (msg);
+  }
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (src);
+  gst_object_unref (pipeline);
+
+  if (state.released != TEST_BUFFERS) {
+    g_printerr ("%u of %u upstream buffers were released\n", state.released,
+        TEST_BUFFERS);
+    ret = FALSE;
+  }
+
+  if (state.offset != TEST_BUFFERS * TEST_BUFFER_SIZE) {
+    g_printerr ("the codec read %" G_GSIZE_FORMAT " of %d bytes\n",
+        state.offset, TEST_BUFFERS * TEST_BUFFER_SIZE);
+    ret = FALSE;
+  }
+
+  for (b = 0; b < TEST_BUFFERS; b++) {
+    g_free (state.upstream[b]);
+  }
+
+  return ret && !state.failed;
+}
+
+int
+main (int argc, char *argv[])
+{
+  gchar *cache = gst_droid_fake_codec_isolate_cache ();
+  gboolean ret = FALSE;
+
+  gst_init (&argc, &argv);
+
+  g_mutex_init (&state.lock);
+
+  if (!gst_droid_fake_codec_register_elements ()) {
+    g_printerr ("failed to register the elements\n");
+  } else {
+    ret = test_run ();
+  }
+
+  gst_droid_fake_codec_remove_cache (cache);
+
+  return ret ? EXIT_SUCCESS : EXIT_FAILURE;
+}
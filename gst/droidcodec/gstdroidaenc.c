@@ -43,6 +43,7 @@ enum
 {
   PROP_0,
   PROP_TARGET_BITRATE,
+  PROP_STATS,
 };
 
 #define GST_DROID_A_ENC_TARGET_BITRATE_DEFAULT 128000
@@ -309,6 +310,25 @@ gst_droidaenc_set_property (GObject * object, guint prop_id,
   }
 }
 
+static GstStructure *
+gst_droidaenc_get_stats (GstDroidAEnc * enc)
+{
+  GstStructure *stats = gst_structure_new_empty ("GstDroidAEncStats");
+
+  GST_AUDIO_ENCODER_STREAM_LOCK (enc);
+
+  if (enc->codec_type) {
+    GstStructure *staging = gst_droid_codec_get_staging_stats (enc->codec_type);
+    gst_structure_set (stats, "input-staging", GST_TYPE_STRUCTURE, staging,
+        NULL);
+    gst_structure_free (staging);
+  }
+
+  GST_AUDIO_ENCODER_STREAM_UNLOCK (enc);
+
+  return stats;
+}
+
 static void
 gst_droidaenc_get_property (GObject * object, guint prop_id, GValue * value,
     GParamSpec * pspec)
@@ -319,6 +339,9 @@ gst_droidaenc_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_TARGET_BITRATE:
       g_value_set_int (value, enc->target_bitrate);
       break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_droidaenc_get_stats (enc));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -347,9 +370,7 @@ gst_droidaenc_open (GstAudioEncoder * encoder)
 
   GST_DEBUG_OBJECT (enc, "open");
 
-  /* nothing to do here */
-
-  return TRUE;
+  return gst_droid_media_ensure_init (GST_ELEMENT (enc));
 }
 
 static gboolean
@@ -469,7 +490,6 @@ gst_droidaenc_handle_frame (GstAudioEncoder * encoder, GstBuffer * buffer)
   GstDroidAEnc *enc = GST_DROIDAENC (encoder);
   GstFlowReturn ret = GST_FLOW_ERROR;
   DroidMediaCodecData data;
-  GstMapInfo info;
   DroidMediaBufferCallbacks cb;
 
   GST_DEBUG_OBJECT (enc, "handle frame");
@@ -511,9 +531,11 @@ gst_droidaenc_handle_frame (GstAudioEncoder * encoder, GstBuffer * buffer)
 
   enc->finished = FALSE;
 
-  gst_buffer_map (buffer, &info, GST_MAP_READ);
-  data.data.size = info.size;
-  data.data.data = g_malloc (info.size);
+  if (!gst_droid_codec_prepare_encoder_data (enc->codec_type, buffer,
+          &data.data, &cb)) {
+    goto error;
+  }
+
   data.sync = false;
 
 /* Check if the buffer has a valid timestamp, and if not then set it from the
@@ -532,12 +554,6 @@ gst_droidaenc_handle_frame (GstAudioEncoder * encoder, GstBuffer * buffer)
     }
   }
   data.ts = GST_TIME_AS_USECONDS (ts);
-  memcpy (data.data.data, info.data, info.size);
-
-  gst_buffer_unmap (buffer, &info);
-
-  cb.unref = g_free;
-  cb.data = data.data.data;
 
   /* This can deadlock if droidmedia/stagefright input buffer queue is full thus we
    * cannot write the input buffer. We end up waiting for the write operation
@@ -656,4 +672,9 @@ gst_droidaenc_class_init (GstDroidAEncClass * klass)
           "Target bitrate", 0, G_MAXINT,
           GST_DROID_A_ENC_TARGET_BITRATE_DEFAULT,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Encoder statistics", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 }
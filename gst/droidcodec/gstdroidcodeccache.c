@@ -0,0 +1,506 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2015-2021 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gstdroidcodeccache.h"
+#include <string.h>             /* strcmp() */
+
+GST_DEBUG_CATEGORY_EXTERN (gst_droid_codec_debug);
+#define GST_CAT_DEFAULT gst_droid_codec_debug
+
+struct _GstDroidCodecCacheEntry
+{
+  DroidMediaCodec *codec;
+
+  /* the key */
+  gchar *type;
+  guint32 flags;
+  guint resolution_class;
+  GBytes *codec_data;
+
+  GMutex lock;
+  GCond cond;
+  DroidMediaCodecCallbacks cb;
+  DroidMediaCodecDataCallbacks data_cb;
+  void *data;                   /* the owner, NULL when there is none */
+  guint busy;                   /* callbacks running in the owner */
+  gboolean held;                /* callbacks wait while changing owners */
+  gboolean broken;
+  GArray *pending;              /* gint64 us, while parked */
+
+  /* protected by the cache lock */
+  gint64 parked_at;
+};
+
+/* the largest frame of each resolution class, anything bigger is the last */
+static const struct
+{
+  gint width;
+  gint height;
+} gst_droid_codec_cache_classes[] = {
+  {720, 576},
+  {1280, 720},
+  {1920, 1088},
+  {4096, 2304},
+};
+
+static GMutex cache_lock;
+static GCond cache_cond;
+static GQueue cache_parked = G_QUEUE_INIT;      /* oldest first */
+static gboolean cache_evicting;
+static guint64 cache_hits;
+static guint64 cache_misses;
+static guint64 cache_evictions;
+
+static guint
+gst_droid_codec_cache_resolution_class (gint width, gint height)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (gst_droid_codec_cache_classes); i++) {
+    if ((gint64) width * height <=
+        (gint64) gst_droid_codec_cache_classes[i].width *
+        gst_droid_codec_cache_classes[i].height) {
+      break;
+    }
+  }
+
+  return i;
+}
+
+/* call with the entry lock held, returns the owner with busy raised */
+static void *
+gst_droid_codec_cache_entry_enter (GstDroidCodecCacheEntry * entry)
+{
+  while (entry->held) {
+    g_cond_wait (&entry->cond, &entry->lock);
+  }
+
+  if (entry->data) {
+    entry->busy++;
+  }
+
+  return entry->data;
+}
+
+static void
+gst_droid_codec_cache_entry_leave (GstDroidCodecCacheEntry * entry)
+{
+  g_mutex_lock (&entry->lock);
+
+  if (--entry->busy == 0) {
+    g_cond_broadcast (&entry->cond);
+  }
+
+  g_mutex_unlock (&entry->lock);
+}
+
+static void
+gst_droid_codec_cache_signal_eos (void *data)
+{
+  GstDroidCodecCacheEntry *entry = (GstDroidCodecCacheEntry *) data;
+  DroidMediaCodecCallbacks cb;
+  void *owner;
+
+  g_mutex_lock (&entry->lock);
+  owner = gst_droid_codec_cache_entry_enter (entry);
+  cb = entry->cb;
+  g_mutex_unlock (&entry->lock);
+
+  if (owner) {
+    if (cb.signal_eos) {
+      cb.signal_eos (owner);
+    }
+
+    gst_droid_codec_cache_entry_leave (entry);
+  }
+}
+
+static void
+gst_droid_codec_cache_error (void *data, int err)
+{
+  GstDroidCodecCacheEntry *entry = (GstDroidCodecCacheEntry *) data;
+  DroidMediaCodecCallbacks cb;
+  void *owner;
+
+  g_mutex_lock (&entry->lock);
+  /* whatever happens next, nobody gets this one again */
+  entry->broken = TRUE;
+  owner = gst_droid_codec_cache_entry_enter (entry);
+  cb = entry->cb;
+  g_mutex_unlock (&entry->lock);
+
+  if (!owner) {
+    GST_WARNING ("parked %s decoder failed: 0x%x", entry->type, -err);
+    return;
+  }
+
+  if (cb.error) {
+    cb.error (owner, err);
+  }
+
+  gst_droid_codec_cache_entry_leave (entry);
+}
+
+static int
+gst_droid_codec_cache_size_changed (void *data, int32_t width, int32_t height)
+{
+  GstDroidCodecCacheEntry *entry = (GstDroidCodecCacheEntry *) data;
+  DroidMediaCodecCallbacks cb;
+  void *owner;
+  int ret = 0;
+
+  g_mutex_lock (&entry->lock);
+  owner = gst_droid_codec_cache_entry_enter (entry);
+  cb = entry->cb;
+  g_mutex_unlock (&entry->lock);
+
+  /* a new owner reads the size back from the codec anyway */
+  if (owner) {
+    if (cb.size_changed) {
+      ret = cb.size_changed (owner, width, height);
+    }
+
+    gst_droid_codec_cache_entry_leave (entry);
+  }
+
+  return ret;
+}
+
+static void
+gst_droid_codec_cache_data_available (void *data, DroidMediaCodecData * encoded)
+{
+  GstDroidCodecCacheEntry *entry = (GstDroidCodecCacheEntry *) data;
+  DroidMediaCodecDataCallbacks data_cb;
+  void *owner;
+
+  g_mutex_lock (&entry->lock);
+
+  owner = gst_droid_codec_cache_entry_enter (entry);
+
+  if (!owner) {
+    /* output is in queueing order so the oldest match is the one */
+    gint64 us = GST_TIME_AS_USECONDS (encoded->ts);
+    guint i;
+
+    for (i = 0; entry->pending && i < entry->pending->len; i++) {
+      if (g_array_index (entry->pending, gint64, i) == us) {
+        g_array_remove_index (entry->pending, i);
+        break;
+      }
+    }
+
+    g_mutex_unlock (&entry->lock);
+    return;
+  }
+
+  data_cb = entry->data_cb;
+  g_mutex_unlock (&entry->lock);
+
+  if (data_cb.data_available) {
+    data_cb.data_available (owner, encoded);
+  }
+
+  gst_droid_codec_cache_entry_leave (entry);
+}
+
+static void
+gst_droid_codec_cache_entry_free (GstDroidCodecCacheEntry * entry)
+{
+  GST_DEBUG ("destroying %s decoder", entry->type);
+
+  if (entry->codec) {
+    droid_media_codec_stop (entry->codec);
+    droid_media_codec_destroy (entry->codec);
+  }
+
+  if (entry->pending) {
+    g_array_unref (entry->pending);
+  }
+
+  g_bytes_unref (entry->codec_data);
+  g_free (entry->type);
+  g_mutex_clear (&entry->lock);
+  g_cond_clear (&entry->cond);
+
+  g_slice_free (GstDroidCodecCacheEntry, entry);
+}
+
+/* call with the cache lock held */
+static gboolean
+gst_droid_codec_cache_entry_matches (GstDroidCodecCacheEntry * entry,
+    const gchar * type, guint32 flags, guint resolution_class,
+    GBytes * codec_data)
+{
+  gboolean ret;
+
+  g_mutex_lock (&entry->lock);
+  ret = !entry->broken;
+  g_mutex_unlock (&entry->lock);
+
+  return ret && !strcmp (entry->type, type) && entry->flags == flags
+      && entry->resolution_class == resolution_class
+      && g_bytes_equal (entry->codec_data, codec_data);
+}
+
+static gpointer
+gst_droid_codec_cache_run (gpointer user_data)
+{
+  GstDroidCodecCacheEntry *entry;
+
+  g_mutex_lock (&cache_lock);
+
+  while ((entry = g_queue_peek_head (&cache_parked))) {
+    gint64 end_time = entry->parked_at + GST_DROID_CODEC_CACHE_IDLE_TIMEOUT;
+    gboolean broken;
+
+    g_mutex_lock (&entry->lock);
+    broken = entry->broken;
+    g_mutex_unlock (&entry->lock);
+
+    if (!broken && g_get_monotonic_time () < end_time) {
+      g_cond_wait_until (&cache_cond, &cache_lock, end_time);
+      continue;
+    }
+
+    g_queue_pop_head (&cache_parked);
+    cache_evictions++;
+
+    g_mutex_unlock (&cache_lock);
+    gst_droid_codec_cache_entry_free (entry);
+    g_mutex_lock (&cache_lock);
+  }
+
+  cache_evicting = FALSE;
+
+  g_mutex_unlock (&cache_lock);
+
+  return NULL;
+}
+
+GstDroidCodecCacheEntry *
+gst_droid_codec_cache_acquire (GstObject * owner,
+    DroidMediaCodecDecoderMetaData * md, GArray ** pending)
+{
+  DroidMediaCodecDecoderMetaData meta = *md;
+  GstDroidCodecCacheEntry *entry = NULL;
+  DroidMediaCodecCallbacks cb;
+  DroidMediaCodecDataCallbacks data_cb;
+  GBytes *codec_data;
+  guint resolution_class;
+  GList *l;
+
+  /* parked decoders have nobody to run an external loop */
+  meta.parent.flags &= ~DROID_MEDIA_CODEC_USE_EXTERNAL_LOOP;
+  resolution_class =
+      gst_droid_codec_cache_resolution_class (md->parent.width,
+      md->parent.height);
+  codec_data = g_bytes_new (md->codec_data.data, md->codec_data.size);
+
+  *pending = NULL;
+
+  g_mutex_lock (&cache_lock);
+
+  for (l = cache_parked.head; l; l = l->next) {
+    if (gst_droid_codec_cache_entry_matches (l->data, md->parent.type,
+            meta.parent.flags, resolution_class, codec_data)) {
+      entry = l->data;
+      g_queue_delete_link (&cache_parked, l);
+      break;
+    }
+  }
+
+  if (entry) {
+    cache_hits++;
+  } else {
+    cache_misses++;
+  }
+
+  g_mutex_unlock (&cache_lock);
+
+  if (entry) {
+    g_bytes_unref (codec_data);
+
+    g_mutex_lock (&entry->lock);
+    /* held until attached so no output slips past both owners */
+    entry->held = TRUE;
+    *pending = entry->pending;
+    entry->pending = NULL;
+    g_mutex_unlock (&entry->lock);
+
+    GST_INFO_OBJECT (owner, "adopting parked %s decoder with %u frames "
+        "pending", entry->type, (*pending)->len);
+
+    return entry;
+  }
+
+  GST_INFO_OBJECT (owner, "no parked %s decoder, creating one",
+      md->parent.type);
+
+  entry = g_slice_new0 (GstDroidCodecCacheEntry);
+  entry->type = g_strdup (md->parent.type);
+  entry->flags = meta.parent.flags;
+  entry->resolution_class = resolution_class;
+  entry->codec_data = codec_data;
+  entry->held = TRUE;
+  g_mutex_init (&entry->lock);
+  g_cond_init (&entry->cond);
+
+  entry->codec = droid_media_codec_create_decoder (&meta);
+  if (!entry->codec) {
+    GST_ERROR_OBJECT (owner, "failed to create %s decoder", entry->type);
+    goto error;
+  }
+
+  cb.signal_eos = gst_droid_codec_cache_signal_eos;
+  cb.error = gst_droid_codec_cache_error;
+  cb.size_changed = gst_droid_codec_cache_size_changed;
+  droid_media_codec_set_callbacks (entry->codec, &cb, entry);
+
+  data_cb.data_available = gst_droid_codec_cache_data_available;
+  droid_media_codec_set_data_callbacks (entry->codec, &data_cb, entry);
+
+  if (!droid_media_codec_start (entry->codec)) {
+    GST_ERROR_OBJECT (owner, "failed to start %s decoder", entry->type);
+    droid_media_codec_destroy (entry->codec);
+    entry->codec = NULL;
+    goto error;
+  }
+
+  return entry;
+
+error:
+  gst_droid_codec_cache_entry_free (entry);
+  return NULL;
+}
+
+DroidMediaCodec *
+gst_droid_codec_cache_entry_get_codec (GstDroidCodecCacheEntry * entry)
+{
+  return entry->codec;
+}
+
+void
+gst_droid_codec_cache_entry_attach (GstDroidCodecCacheEntry * entry,
+    DroidMediaCodecCallbacks * cb, DroidMediaCodecDataCallbacks * data_cb,
+    void *data)
+{
+  g_mutex_lock (&entry->lock);
+
+  entry->cb = *cb;
+  entry->data_cb = *data_cb;
+  entry->data = data;
+  entry->held = FALSE;
+  g_cond_broadcast (&entry->cond);
+
+  g_mutex_unlock (&entry->lock);
+}
+
+void
+gst_droid_codec_cache_entry_detach (GstDroidCodecCacheEntry * entry)
+{
+  g_mutex_lock (&entry->lock);
+
+  entry->data = NULL;
+  entry->held = TRUE;
+
+  while (entry->busy > 0) {
+    g_cond_wait (&entry->cond, &entry->lock);
+  }
+
+  g_mutex_unlock (&entry->lock);
+}
+
+void
+gst_droid_codec_cache_release (GstDroidCodecCacheEntry * entry,
+    GArray * pending, gboolean reusable)
+{
+  GstDroidCodecCacheEntry *evicted = NULL;
+
+  g_mutex_lock (&entry->lock);
+
+  reusable = reusable && !entry->broken;
+  if (reusable) {
+    entry->pending = pending;
+    pending = NULL;
+  }
+
+  entry->held = FALSE;
+  g_cond_broadcast (&entry->cond);
+
+  g_mutex_unlock (&entry->lock);
+
+  if (pending) {
+    g_array_unref (pending);
+  }
+
+  if (!reusable) {
+    gst_droid_codec_cache_entry_free (entry);
+    return;
+  }
+
+  GST_DEBUG ("parking %s decoder", entry->type);
+
+  g_mutex_lock (&cache_lock);
+
+  entry->parked_at = g_get_monotonic_time ();
+  g_queue_push_tail (&cache_parked, entry);
+
+  if (cache_parked.length > GST_DROID_CODEC_CACHE_MAX_SIZE) {
+    evicted = g_queue_pop_head (&cache_parked);
+    cache_evictions++;
+  }
+
+  if (!cache_evicting) {
+    cache_evicting = TRUE;
+    g_thread_unref (g_thread_new ("droidcodeccache",
+            gst_droid_codec_cache_run, NULL));
+  }
+
+  g_cond_signal (&cache_cond);
+
+  g_mutex_unlock (&cache_lock);
+
+  if (evicted) {
+    gst_droid_codec_cache_entry_free (evicted);
+  }
+}
+
+GstStructure *
+gst_droid_codec_cache_get_stats (void)
+{
+  GstStructure *stats;
+
+  g_mutex_lock (&cache_lock);
+
+  stats = gst_structure_new ("GstDroidCodecCacheStats",
+      "max-size", G_TYPE_UINT, GST_DROID_CODEC_CACHE_MAX_SIZE,
+      "parked", G_TYPE_UINT, cache_parked.length,
+      "hits", G_TYPE_UINT64, cache_hits,
+      "misses", G_TYPE_UINT64, cache_misses,
+      "evictions", G_TYPE_UINT64, cache_evictions, NULL);
+
+  g_mutex_unlock (&cache_lock);
+
+  return stats;
+}
@@ -0,0 +1,80 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2015-2021 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __GST_DROID_CODEC_CACHE_H__
+#define __GST_DROID_CODEC_CACHE_H__
+
+#include <gst/gst.h>
+#include "droidmediacodec.h"
+
+G_BEGIN_DECLS
+
+#define GST_DROID_CODEC_CACHE_MAX_SIZE        2
+#define GST_DROID_CODEC_CACHE_IDLE_TIMEOUT    (5 * G_TIME_SPAN_SECOND)
+
+typedef struct _GstDroidCodecCacheEntry GstDroidCodecCacheEntry;
+
+/*
+ * A process wide cache of started system memory decoders, keyed by droid
+ * type, codec_data, resolution class and output colour path. The HAL
+ * colour format is not part of the key, owners read it back from the
+ * codec on the first output like they do for a new decoder.
+ *
+ * Decoders from the cache run droidmedia's own loop instead of an external
+ * one so a parked decoder keeps emptying its pipeline with nobody
+ * listening. Their callbacks go through the cache, which hands them to the
+ * current owner and drops them while the decoder is parked.
+ */
+
+/*
+ * Adopts a parked decoder matching md or creates and starts a new one.
+ * For an adopted decoder pending is set to the timestamps (us) of the
+ * inputs its previous owner queued that have not come out yet, for a new
+ * one it is set to NULL.
+ */
+GstDroidCodecCacheEntry *gst_droid_codec_cache_acquire (GstObject * owner,
+    DroidMediaCodecDecoderMetaData * md, GArray ** pending);
+
+DroidMediaCodec *gst_droid_codec_cache_entry_get_codec (GstDroidCodecCacheEntry
+    * entry);
+
+void gst_droid_codec_cache_entry_attach (GstDroidCodecCacheEntry * entry,
+    DroidMediaCodecCallbacks * cb, DroidMediaCodecDataCallbacks * data_cb,
+    void *data);
+
+/*
+ * Stops handing callbacks to the owner and waits for the running ones.
+ * Later callbacks are held back until the entry is released. Callers must
+ * not hold any lock the callbacks need.
+ */
+void gst_droid_codec_cache_entry_detach (GstDroidCodecCacheEntry * entry);
+
+/*
+ * Parks a detached decoder, taking pending as the timestamps (us) of the
+ * inputs that have not come out yet, or destroys it if it can't be reused.
+ */
+void gst_droid_codec_cache_release (GstDroidCodecCacheEntry * entry,
+    GArray * pending, gboolean reusable);
+
+GstStructure *gst_droid_codec_cache_get_stats (void);
+
+G_END_DECLS
+
+#endif /* __GST_DROID_CODEC_CACHE_H__ */
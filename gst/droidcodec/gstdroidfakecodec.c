@@ -0,0 +1,498 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2015-2021 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gstdroidfakecodec.h"
+#include "gstdroidaenc.h"
+#include "gstdroidvdec.h"
+#include "plugin.h"
+#include <glib/gstdio.h>
+#include <string.h>             /* memset() */
+
+/* what plugin.c would otherwise provide */
+GST_DEBUG_CATEGORY (gst_droid_aenc_debug);
+GST_DEBUG_CATEGORY (gst_droid_vdec_debug);
+GST_DEBUG_CATEGORY (gst_droid_codec_debug);
+
+/* OpenMAX IL values */
+#define FAKE_CODEC_YUV420_PLANAR          19
+#define FAKE_CODEC_YUV420_PACKED_PLANAR   20
+#define FAKE_CODEC_YUV420_SEMI_PLANAR     21
+
+/* how often droid_media_codec_loop () comes back without input */
+#define FAKE_CODEC_LOOP_TIMEOUT           (10 * G_TIME_SPAN_MILLISECOND)
+
+#define ALIGN_SIZE(size, to) (((size) + to  - 1) & ~(to - 1))
+
+/* AAC LC, 44100 Hz, stereo */
+static const guint8 fake_codec_aac_config[] = { 0x12, 0x10 };
+static const guint8 fake_codec_output[16] = { 0 };
+
+typedef enum
+{
+  FAKE_CODEC_IDLE,
+  FAKE_CODEC_OUTPUT,
+  FAKE_CODEC_EOS,
+  FAKE_CODEC_STOPPED,
+} FakeCodecStep;
+
+typedef struct
+{
+  DroidMediaCodecData data;
+  DroidMediaBufferCallbacks cb;
+} FakeCodecInput;
+
+typedef struct
+{
+  GstDroidFakeCodecConfig config;
+  gboolean decoder;
+  gboolean external_loop;
+  gint32 width;
+  gint32 height;
+  /* one frame of output for decoders */
+  guint8 *frame;
+  gsize frame_size;
+
+  DroidMediaCodecCallbacks cb;
+  void *cb_data;
+  DroidMediaCodecDataCallbacks data_cb;
+  void *data_cb_data;
+
+  GMutex lock;
+  GCond cond;
+  GQueue inputs;
+  gboolean running;
+  gboolean draining;
+  gboolean config_sent;
+  /* unless the caller runs the loop */
+  GThread *thread;
+} FakeCodec;
+
+static GMutex fake_codec_config_lock;
+static GstDroidFakeCodecConfig fake_codec_config;
+
+void
+gst_droid_fake_codec_configure (const GstDroidFakeCodecConfig * config)
+{
+  g_mutex_lock (&fake_codec_config_lock);
+  fake_codec_config = *config;
+  g_mutex_unlock (&fake_codec_config_lock);
+}
+
+gchar *
+gst_droid_fake_codec_isolate_cache (void)
+{
+  gchar *dir = g_dir_make_tmp ("gstdroid-fake-XXXXXX", NULL);
+
+  if (dir) {
+    g_setenv ("XDG_CACHE_HOME", dir, TRUE);
+  }
+
+  return dir;
+}
+
+static void
+fake_codec_remove_tree (const gchar * path)
+{
+  GDir *dir = g_dir_open (path, 0, NULL);
+  const gchar *name;
+
+  if (dir) {
+    while ((name = g_dir_read_name (dir))) {
+      gchar *child = g_build_filename (path, name, NULL);
+
+      fake_codec_remove_tree (child);
+      g_free (child);
+    }
+
+    g_dir_close (dir);
+  }
+
+  g_remove (path);
+}
+
+void
+gst_droid_fake_codec_remove_cache (gchar * dir)
+{
+  if (dir) {
+    fake_codec_remove_tree (dir);
+    g_free (dir);
+  }
+}
+
+gboolean
+gst_droid_fake_codec_register_elements (void)
+{
+  gboolean ok = TRUE;
+
+  GST_DEBUG_CATEGORY_INIT (gst_droid_aenc_debug, "droidaenc",
+      0, "Android HAL audio encoder");
+
+  GST_DEBUG_CATEGORY_INIT (gst_droid_vdec_debug, "droidvdec",
+      0, "Android HAL video decoder");
+
+  GST_DEBUG_CATEGORY_INIT (gst_droid_codec_debug, "droidcodec",
+      0, "Android HAL codec");
+
+  ok &= gst_element_register (NULL, "droidaenc", GST_RANK_NONE,
+      GST_TYPE_DROIDAENC);
+
+  ok &= gst_element_register (NULL, "droidvdec", GST_RANK_NONE,
+      GST_TYPE_DROIDVDEC);
+
+  return ok;
+}
+
+gboolean
+gst_droid_media_ensure_init (GstElement * element)
+{
+  return TRUE;
+}
+
+static void
+fake_codec_release_input (FakeCodecInput * input)
+{
+  if (input->cb.unref) {
+    input->cb.unref (input->cb.data);
+  }
+
+  g_slice_free (FakeCodecInput, input);
+}
+
+/* called without the lock */
+static void
+fake_codec_process (FakeCodec * codec, FakeCodecInput * input)
+{
+  DroidMediaCodecData out;
+
+  if (codec->config.frame_time > 0) {
+    g_usleep (GST_TIME_AS_USECONDS (codec->config.frame_time));
+  }
+
+  memset (&out, 0x0, sizeof (out));
+
+  if (!codec->decoder && !codec->config_sent) {
+    out.data.data = (void *) fake_codec_aac_config;
+    out.data.size = sizeof (fake_codec_aac_config);
+    out.codec_config = true;
+    codec->data_cb.data_available (codec->data_cb_data, &out);
+    codec->config_sent = TRUE;
+  }
+
+  if (codec->config.input) {
+    codec->config.input (&input->data.data, codec->config.user_data);
+  }
+
+  if (codec->decoder) {
+    out.data.data = codec->frame;
+    out.data.size = codec->frame_size;
+    /* decoders report nanoseconds */
+    out.ts = input->data.ts * GST_USECOND;
+  } else {
+    out.data.data = (void *) fake_codec_output;
+    out.data.size = sizeof (fake_codec_output);
+    out.ts = input->data.ts;
+  }
+
+  out.decoding_ts = out.ts;
+  out.sync = true;
+  out.codec_config = false;
+
+  /* droidmedia is done with the input before it delivers the output */
+  fake_codec_release_input (input);
+
+  codec->data_cb.data_available (codec->data_cb_data, &out);
+}
+
+/*
+ * Produces at most one output. Waits until end_time for enough input,
+ * G_MAXINT64 waits until there is something to do.
+ */
+static FakeCodecStep
+fake_codec_step (FakeCodec * codec, gint64 end_time)
+{
+  FakeCodecInput *input;
+  guint held = codec->config.hold_input ? G_MAXUINT : codec->config.latency;
+
+  g_mutex_lock (&codec->lock);
+
+  while (codec->running && !codec->draining && codec->inputs.length <= held) {
+    if (end_time == G_MAXINT64) {
+      g_cond_wait (&codec->cond, &codec->lock);
+    } else if (!g_cond_wait_until (&codec->cond, &codec->lock, end_time)) {
+      g_mutex_unlock (&codec->lock);
+      return FAKE_CODEC_IDLE;
+    }
+  }
+
+  if (!codec->running) {
+    g_mutex_unlock (&codec->lock);
+    return FAKE_CODEC_STOPPED;
+  }
+
+  input = g_queue_pop_head (&codec->inputs);
+  if (!input) {
+    /* drained */
+    codec->draining = FALSE;
+    g_mutex_unlock (&codec->lock);
+
+    /* decoders can be destroyed as soon as this returns */
+    codec->cb.signal_eos (codec->cb_data);
+    return FAKE_CODEC_EOS;
+  }
+
+  g_mutex_unlock (&codec->lock);
+
+  fake_codec_process (codec, input);
+
+  return FAKE_CODEC_OUTPUT;
+}
+
+static gpointer
+fake_codec_thread (gpointer user_data)
+{
+  FakeCodec *codec = user_data;
+
+  while (fake_codec_step (codec, G_MAXINT64) != FAKE_CODEC_STOPPED) {
+    /* one output at a time until stopped */
+  }
+
+  return NULL;
+}
+
+static FakeCodec *
+fake_codec_new (DroidMediaCodecMetaData * meta, gboolean decoder)
+{
+  FakeCodec *codec = g_slice_new0 (FakeCodec);
+
+  g_mutex_lock (&fake_codec_config_lock);
+  codec->config = fake_codec_config;
+  g_mutex_unlock (&fake_codec_config_lock);
+
+  codec->decoder = decoder;
+  codec->external_loop =
+      (meta->flags & DROID_MEDIA_CODEC_USE_EXTERNAL_LOOP) != 0;
+
+  g_mutex_init (&codec->lock);
+  g_cond_init (&codec->cond);
+  g_queue_init (&codec->inputs);
+
+  if (codec->config.create_time > 0) {
+    g_usleep (GST_TIME_AS_USECONDS (codec->config.create_time));
+  }
+
+  return codec;
+}
+
+bool
+droid_media_init ()
+{
+  return true;
+}
+
+void
+droid_media_colour_format_constants_init (DroidMediaColourFormatConstants * c)
+{
+  /* anything we don't set can't be matched by what the codec reports */
+  memset (c, 0x0, sizeof (*c));
+
+  c->OMX_COLOR_FormatYUV420Planar = FAKE_CODEC_YUV420_PLANAR;
+  c->OMX_COLOR_FormatYUV420PackedPlanar = FAKE_CODEC_YUV420_PACKED_PLANAR;
+  c->OMX_COLOR_FormatYUV420SemiPlanar = FAKE_CODEC_YUV420_SEMI_PLANAR;
+}
+
+DroidMediaConvert *
+droid_media_convert_create ()
+{
+  /* use our own converters */
+  return NULL;
+}
+
+void
+droid_media_buffer_queue_set_callbacks (DroidMediaBufferQueue * queue,
+    DroidMediaBufferQueueCallbacks * cb, void *data)
+{
+  /* we never hand out a buffer queue */
+}
+
+bool
+droid_media_codec_is_supported (DroidMediaCodecMetaData * meta, bool encoder)
+{
+  return true;
+}
+
+DroidMediaCodec *
+droid_media_codec_create_decoder (DroidMediaCodecDecoderMetaData * meta)
+{
+  FakeCodec *codec = fake_codec_new (&meta->parent, TRUE);
+
+  codec->width = meta->parent.width;
+  codec->height = meta->parent.height;
+  /* NV12 with the slice height aligned to 16 lines */
+  codec->frame_size =
+      (gsize) codec->width * ALIGN_SIZE (codec->height, 16) * 3 / 2;
+  codec->frame = g_malloc0 (codec->frame_size);
+
+  return (DroidMediaCodec *) codec;
+}
+
+DroidMediaCodec *
+droid_media_codec_create_encoder (DroidMediaCodecEncoderMetaData * meta)
+{
+  return (DroidMediaCodec *) fake_codec_new (&meta->parent, FALSE);
+}
+
+DroidMediaBufferQueue *
+droid_media_codec_get_buffer_queue (DroidMediaCodec * codec)
+{
+  /* always the data callbacks */
+  return NULL;
+}
+
+void
+droid_media_codec_get_output_info (DroidMediaCodec * codec,
+    DroidMediaCodecMetaData * info, DroidMediaRect * crop)
+{
+  FakeCodec *fake = (FakeCodec *) codec;
+
+  info->width = fake->width;
+  info->height = fake->height;
+  info->hal_format = FAKE_CODEC_YUV420_SEMI_PLANAR;
+
+  crop->left = 0;
+  crop->top = 0;
+  crop->right = fake->width;
+  crop->bottom = fake->height;
+}
+
+void
+droid_media_codec_set_callbacks (DroidMediaCodec * codec,
+    DroidMediaCodecCallbacks * cb, void *data)
+{
+  FakeCodec *fake = (FakeCodec *) codec;
+
+  fake->cb = *cb;
+  fake->cb_data = data;
+}
+
+void
+droid_media_codec_set_data_callbacks (DroidMediaCodec * codec,
+    DroidMediaCodecDataCallbacks * cb, void *data)
+{
+  FakeCodec *fake = (FakeCodec *) codec;
+
+  fake->data_cb = *cb;
+  fake->data_cb_data = data;
+}
+
+bool
+droid_media_codec_start (DroidMediaCodec * codec)
+{
+  FakeCodec *fake = (FakeCodec *) codec;
+
+  fake->running = TRUE;
+
+  if (!fake->external_loop) {
+    fake->thread = g_thread_new ("fakecodec", fake_codec_thread, fake);
+  }
+
+  return true;
+}
+
+DroidMediaCodecLoopReturn
+droid_media_codec_loop (DroidMediaCodec * codec)
+{
+  FakeCodec *fake = (FakeCodec *) codec;
+
+  switch (fake_codec_step (fake,
+          g_get_monotonic_time () + FAKE_CODEC_LOOP_TIMEOUT)) {
+    case FAKE_CODEC_IDLE:
+    case FAKE_CODEC_OUTPUT:
+      return DROID_MEDIA_CODEC_LOOP_OK;
+    case FAKE_CODEC_EOS:
+      return DROID_MEDIA_CODEC_LOOP_EOS;
+    case FAKE_CODEC_STOPPED:
+    default:
+      return DROID_MEDIA_CODEC_LOOP_ERROR;
+  }
+}
+
+void
+droid_media_codec_queue (DroidMediaCodec * codec, DroidMediaCodecData * data,
+    DroidMediaBufferCallbacks * cb)
+{
+  FakeCodec *fake = (FakeCodec *) codec;
+  FakeCodecInput *input = g_slice_new (FakeCodecInput);
+
+  input->data = *data;
+  input->cb = *cb;
+
+  g_mutex_lock (&fake->lock);
+  g_queue_push_tail (&fake->inputs, input);
+  g_cond_signal (&fake->cond);
+  g_mutex_unlock (&fake->lock);
+}
+
+void
+droid_media_codec_drain (DroidMediaCodec * codec)
+{
+  FakeCodec *fake = (FakeCodec *) codec;
+
+  /* the caller holds locks signal_eos needs, so it comes from our thread */
+  g_mutex_lock (&fake->lock);
+  fake->draining = TRUE;
+  g_cond_signal (&fake->cond);
+  g_mutex_unlock (&fake->lock);
+}
+
+void
+droid_media_codec_stop (DroidMediaCodec * codec)
+{
+  FakeCodec *fake = (FakeCodec *) codec;
+  FakeCodecInput *input;
+
+  g_mutex_lock (&fake->lock);
+  fake->running = FALSE;
+  g_cond_signal (&fake->cond);
+  g_mutex_unlock (&fake->lock);
+
+  if (fake->thread) {
+    g_thread_join (fake->thread);
+    fake->thread = NULL;
+  }
+
+  while ((input = g_queue_pop_head (&fake->inputs))) {
+    fake_codec_release_input (input);
+  }
+}
+
+void
+droid_media_codec_destroy (DroidMediaCodec * codec)
+{
+  FakeCodec *fake = (FakeCodec *) codec;
+
+  g_free (fake->frame);
+  g_mutex_clear (&fake->lock);
+  g_cond_clear (&fake->cond);
+  g_slice_free (FakeCodec, fake);
+}
@@ -0,0 +1,81 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2015-2021 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __GST_DROID_FAKE_CODEC_H__
+#define __GST_DROID_FAKE_CODEC_H__
+
+#include <gst/gst.h>
+#include "droidmediacodec.h"
+
+G_BEGIN_DECLS
+
+/*
+ * A stand-in for the droidmedia codec API. Linking it into a test
+ * executable overrides the droid_media_codec_* symbols of libdroidmedia,
+ * for our elements and for libgstdroid alike, so the elements can be run
+ * without Android.
+ *
+ * Encoders get a codec_config buffer followed by one output per input,
+ * decoders one NV12 (OMX_COLOR_FormatYUV420SemiPlanar) frame per input,
+ * all through the data callbacks. Output is produced on a thread of the
+ * codec's own like stagefright does, or from droid_media_codec_loop ()
+ * for codecs created with DROID_MEDIA_CODEC_USE_EXTERNAL_LOOP.
+ */
+
+/*
+ * Called on the codec thread for every input right before droidmedia
+ * would hand it back through its unref callback.
+ */
+typedef void (*GstDroidFakeCodecInputFunc) (const DroidMediaData * data,
+    gpointer user_data);
+
+typedef struct
+{
+  GstDroidFakeCodecInputFunc input;
+  gpointer user_data;
+
+  /* keep all inputs until the codec is drained */
+  gboolean hold_input;
+
+  /* inputs held back before output starts, like a real codec pipeline */
+  guint latency;
+
+  /* how long creating and starting a codec, and each frame, takes */
+  GstClockTime create_time;
+  GstClockTime frame_time;
+} GstDroidFakeCodecConfig;
+
+/* applies to codecs created afterwards */
+void gst_droid_fake_codec_configure (const GstDroidFakeCodecConfig * config);
+
+/*
+ * Points the user cache directory, where the codec probe results are
+ * kept, at a new temporary directory so neither the real results nor
+ * ours leak across. Call before gst_init ().
+ */
+gchar *gst_droid_fake_codec_isolate_cache (void);
+void gst_droid_fake_codec_remove_cache (gchar * dir);
+
+/* registers the codec elements, without loading the plugin */
+gboolean gst_droid_fake_codec_register_elements (void);
+
+G_END_DECLS
+
+#endif /* __GST_DROID_FAKE_CODEC_H__ */
@@ -0,0 +1,264 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2021 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gstdroidsubmitter.h"
+
+GST_DEBUG_CATEGORY_EXTERN (gst_droid_codec_debug);
+#define GST_CAT_DEFAULT gst_droid_codec_debug
+
+typedef struct
+{
+  DroidMediaCodec *codec;
+  DroidMediaCodecData data;
+  DroidMediaBufferCallbacks cb;
+} GstDroidSubmitterItem;
+
+struct _GstDroidSubmitter
+{
+  /* used for logging only, not reffed */
+  GstObject *parent;
+  GThread *thread;
+
+  GMutex lock;
+  GCond item_cond;
+  GCond space_cond;
+  gboolean stopping;
+
+  /* items stay in the ring until droid_media_codec_queue () returns */
+  GstDroidSubmitterItem *items;
+  guint depth;
+  guint head;
+  guint count;
+
+  /* statistics, protected by lock */
+  guint64 submitted;
+  guint max_fill;
+  guint64 enqueue_waits;
+  GstClockTime enqueue_wait_time;
+  GstClockTime max_enqueue_wait_time;
+  GstClockTime codec_queue_time;
+};
+
+static gpointer
+gst_droid_submitter_run (gpointer user_data)
+{
+  GstDroidSubmitter *sub = (GstDroidSubmitter *) user_data;
+  GstDroidSubmitterItem item;
+  GstClockTime start;
+
+  g_mutex_lock (&sub->lock);
+
+  while (TRUE) {
+    while (sub->count == 0 && !sub->stopping) {
+      g_cond_wait (&sub->item_cond, &sub->lock);
+    }
+
+    if (sub->stopping) {
+      break;
+    }
+
+    item = sub->items[sub->head];
+
+    g_mutex_unlock (&sub->lock);
+
+    start = gst_util_get_timestamp ();
+    droid_media_codec_queue (item.codec, &item.data, &item.cb);
+    start = gst_util_get_timestamp () - start;
+
+    g_mutex_lock (&sub->lock);
+
+    sub->codec_queue_time += start;
+    sub->submitted++;
+    sub->head = (sub->head + 1) % sub->depth;
+    sub->count--;
+
+    g_cond_broadcast (&sub->space_cond);
+  }
+
+  g_mutex_unlock (&sub->lock);
+
+  return NULL;
+}
+
+GstDroidSubmitter *
+gst_droid_submitter_new (GstObject * parent, guint depth)
+{
+  GstDroidSubmitter *sub;
+
+  g_return_val_if_fail (depth > 0, NULL);
+
+  GST_INFO_OBJECT (parent, "starting submitter with depth %u", depth);
+
+  sub = g_slice_new0 (GstDroidSubmitter);
+  sub->parent = parent;
+  sub->depth = depth;
+  sub->items = g_new0 (GstDroidSubmitterItem, depth);
+
+  g_mutex_init (&sub->lock);
+  g_cond_init (&sub->item_cond);
+  g_cond_init (&sub->space_cond);
+
+  sub->thread = g_thread_new ("droidsubmit", gst_droid_submitter_run, sub);
+
+  return sub;
+}
+
+void
+gst_droid_submitter_free (GstDroidSubmitter * sub)
+{
+  GST_DEBUG_OBJECT (sub->parent, "stopping submitter");
+
+  g_mutex_lock (&sub->lock);
+  sub->stopping = TRUE;
+  g_cond_signal (&sub->item_cond);
+  g_mutex_unlock (&sub->lock);
+
+  g_thread_join (sub->thread);
+
+  if (sub->count > 0) {
+    GST_INFO_OBJECT (sub->parent, "releasing %u pending items", sub->count);
+  }
+
+  while (sub->count > 0) {
+    GstDroidSubmitterItem *item = &sub->items[sub->head];
+
+    if (item->cb.unref) {
+      item->cb.unref (item->cb.data);
+    }
+
+    sub->head = (sub->head + 1) % sub->depth;
+    sub->count--;
+  }
+
+  GST_INFO_OBJECT (sub->parent, "submitted %" G_GUINT64_FORMAT " items, "
+      "waited %" G_GUINT64_FORMAT " times for %" GST_TIME_FORMAT,
+      sub->submitted, sub->enqueue_waits,
+      GST_TIME_ARGS (sub->enqueue_wait_time));
+
+  g_cond_clear (&sub->space_cond);
+  g_cond_clear (&sub->item_cond);
+  g_mutex_clear (&sub->lock);
+  g_free (sub->items);
+  g_slice_free (GstDroidSubmitter, sub);
+}
+
+/* call with the lock held and room in the ring */
+static void
+gst_droid_submitter_add (GstDroidSubmitter * sub, DroidMediaCodec * codec,
+    DroidMediaCodecData * data, DroidMediaBufferCallbacks * cb)
+{
+  GstDroidSubmitterItem *item =
+      &sub->items[(sub->head + sub->count) % sub->depth];
+
+  item->codec = codec;
+  item->data = *data;
+  item->cb = *cb;
+
+  sub->count++;
+  sub->max_fill = MAX (sub->max_fill, sub->count);
+
+  g_cond_signal (&sub->item_cond);
+}
+
+gboolean
+gst_droid_submitter_try_push (GstDroidSubmitter * sub,
+    DroidMediaCodec * codec, DroidMediaCodecData * data,
+    DroidMediaBufferCallbacks * cb)
+{
+  gboolean ret = FALSE;
+
+  g_mutex_lock (&sub->lock);
+
+  if (sub->count < sub->depth) {
+    gst_droid_submitter_add (sub, codec, data, cb);
+    ret = TRUE;
+  }
+
+  g_mutex_unlock (&sub->lock);
+
+  return ret;
+}
+
+void
+gst_droid_submitter_push (GstDroidSubmitter * sub, DroidMediaCodec * codec,
+    DroidMediaCodecData * data, DroidMediaBufferCallbacks * cb)
+{
+  GstClockTime start = GST_CLOCK_TIME_NONE;
+
+  g_mutex_lock (&sub->lock);
+
+  if (sub->count == sub->depth) {
+    GST_LOG_OBJECT (sub->parent, "waiting for room in the submit queue");
+
+    start = gst_util_get_timestamp ();
+
+    while (sub->count == sub->depth) {
+      g_cond_wait (&sub->space_cond, &sub->lock);
+    }
+
+    start = gst_util_get_timestamp () - start;
+
+    sub->enqueue_waits++;
+    sub->enqueue_wait_time += start;
+    sub->max_enqueue_wait_time = MAX (sub->max_enqueue_wait_time, start);
+  }
+
+  gst_droid_submitter_add (sub, codec, data, cb);
+
+  g_mutex_unlock (&sub->lock);
+}
+
+void
+gst_droid_submitter_wait_empty (GstDroidSubmitter * sub)
+{
+  g_mutex_lock (&sub->lock);
+
+  while (sub->count > 0) {
+    g_cond_wait (&sub->space_cond, &sub->lock);
+  }
+
+  g_mutex_unlock (&sub->lock);
+}
+
+GstStructure *
+gst_droid_submitter_get_stats (GstDroidSubmitter * sub)
+{
+  GstStructure *stats;
+
+  g_mutex_lock (&sub->lock);
+
+  stats = gst_structure_new ("GstDroidSubmitterStats",
+      "depth", G_TYPE_UINT, sub->depth,
+      "pending", G_TYPE_UINT, sub->count,
+      "max-pending", G_TYPE_UINT, sub->max_fill,
+      "submitted", G_TYPE_UINT64, sub->submitted,
+      "enqueue-waits", G_TYPE_UINT64, sub->enqueue_waits,
+      "enqueue-wait-time", G_TYPE_UINT64, sub->enqueue_wait_time,
+      "max-enqueue-wait-time", G_TYPE_UINT64, sub->max_enqueue_wait_time,
+      "codec-queue-time", G_TYPE_UINT64, sub->codec_queue_time, NULL);
+
+  g_mutex_unlock (&sub->lock);
+
+  return stats;
+}
@@ -0,0 +1,61 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2021 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __GST_DROID_SUBMITTER_H__
+#define __GST_DROID_SUBMITTER_H__
+
+#include <gst/gst.h>
+#include "droidmediacodec.h"
+
+G_BEGIN_DECLS
+
+#define GST_DROID_SUBMITTER_MAX_DEPTH      32
+
+typedef struct _GstDroidSubmitter GstDroidSubmitter;
+
+/*
+ * Feeds droid_media_codec_queue () from its own thread so the streaming
+ * thread does not block for the codec input latency.
+ */
+GstDroidSubmitter *gst_droid_submitter_new (GstObject * parent, guint depth);
+
+/* Releases anything still waiting without queueing it */
+void gst_droid_submitter_free (GstDroidSubmitter * sub);
+
+/* Returns FALSE without taking the data if the ring is full */
+gboolean gst_droid_submitter_try_push (GstDroidSubmitter * sub,
+    DroidMediaCodec * codec, DroidMediaCodecData * data,
+    DroidMediaBufferCallbacks * cb);
+
+/*
+ * Waits for room in the ring. Callers must not hold any lock the codec
+ * callbacks need
+ */
+void gst_droid_submitter_push (GstDroidSubmitter * sub, DroidMediaCodec * codec,
+    DroidMediaCodecData * data, DroidMediaBufferCallbacks * cb);
+
+/* Waits until everything pushed so far has been queued to the codec */
+void gst_droid_submitter_wait_empty (GstDroidSubmitter * sub);
+
+GstStructure *gst_droid_submitter_get_stats (GstDroidSubmitter * sub);
+
+G_END_DECLS
+
+#endif /* __GST_DROID_SUBMITTER_H__ */
@@ -0,0 +1,276 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2015-2021 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Times seek to first frame in droidvdec against the fake codec, with and
+ * without fast-flush. A seek is a flush followed by a new segment and a
+ * GOP from the seek position; the time runs until the first frame of the
+ * new GOP reaches the sink. Frames from before the seek that make it to
+ * the sink afterwards are counted as leaked.
+ *
+ * The fake codec is given a creation cost and a pipeline depth in the
+ * range stagefright shows for hardware decoders, so the numbers compare
+ * the two flush modes rather than predict any particular device.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gstdroidfakecodec.h"
+#include <stdlib.h>
+#include <string.h>             /* memset() */
+
+#define BENCH_SEEKS         30
+#define BENCH_GOP           15
+#define BENCH_WIDTH         1280
+#define BENCH_HEIGHT        720
+#define BENCH_FRAME         (GST_SECOND / 30)
+#define BENCH_TIMEOUT       (5 * G_TIME_SPAN_SECOND)
+
+#define BENCH_CREATE_TIME   (80 * GST_MSECOND)
+#define BENCH_FRAME_TIME    (2 * GST_MSECOND)
+#define BENCH_LATENCY       4
+
+typedef struct
+{
+  GMutex lock;
+  GCond cond;
+  /* the first frame of the current segment */
+  GstClockTime target;
+  gboolean arrived;
+  guint leaked;
+} BenchState;
+
+static BenchState state;
+
+static void
+bench_handoff (GstElement * sink, GstBuffer * buffer, GstPad * pad,
+    gpointer user_data)
+{
+  GstClockTime pts = GST_BUFFER_PTS (buffer);
+
+  g_mutex_lock (&state.lock);
+
+  if (pts == state.target) {
+    state.arrived = TRUE;
+    g_cond_signal (&state.cond);
+  } else if (!state.arrived || pts < state.target) {
+    /* nothing but the new GOP belongs to this segment */
+    state.leaked++;
+  }
+
+  g_mutex_unlock (&state.lock);
+}
+
+static gboolean
+bench_push_gop (GstPad * pad, GstClockTime start)
+{
+  guint i;
+
+  for (i = 0; i < BENCH_GOP; i++) {
+    GstBuffer *buffer = gst_buffer_new_allocate (NULL, 1024, NULL);
+
+    gst_buffer_memset (buffer, 0, i, 1024);
+    GST_BUFFER_PTS (buffer) = start + i * BENCH_FRAME;
+    GST_BUFFER_DTS (buffer) = GST_BUFFER_PTS (buffer);
+    GST_BUFFER_DURATION (buffer) = BENCH_FRAME;
+    if (i > 0) {
+      GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+    }
+
+    if (gst_pad_push (pad, buffer) != GST_FLOW_OK) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+static gboolean
+bench_wait (void)
+{
+  gint64 end_time = g_get_monotonic_time () + BENCH_TIMEOUT;
+  gboolean ret = TRUE;
+
+  g_mutex_lock (&state.lock);
+
+  while (!state.arrived && ret) {
+    ret = g_cond_wait_until (&state.cond, &state.lock, end_time);
+  }
+
+  g_mutex_unlock (&state.lock);
+
+  return ret;
+}
+
+static void
+bench_set_target (GstClockTime target)
+{
+  g_mutex_lock (&state.lock);
+  state.target = target;
+  state.arrived = FALSE;
+  g_mutex_unlock (&state.lock);
+}
+
+static gboolean
+bench_segment (GstPad * pad, GstClockTime start)
+{
+  GstSegment segment;
+
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  segment.start = start;
+  segment.time = start;
+
+  return gst_pad_push_event (pad, gst_event_new_segment (&segment));
+}
+
+static gint
+bench_compare (gconstpointer a, gconstpointer b)
+{
+  gint64 x = *(const gint64 *) a;
+  gint64 y = *(const gint64 *) b;
+
+  return x < y ? -1 : x > y;
+}
+
+static gboolean
+bench_run (gboolean fast_flush)
+{
+  GstElement *pipeline, *dec, *sink;
+  GstPad *src, *sinkpad;
+  GstCaps *caps;
+  GstStructure *stats;
+  gint64 times[BENCH_SEEKS];
+  guint codecs = 0, i;
+  gboolean ret = FALSE;
+
+  pipeline = gst_pipeline_new (NULL);
+  dec = gst_element_factory_make ("droidvdec", NULL);
+  sink = gst_element_factory_make ("fakesink", NULL);
+  g_object_set (dec, "fast-flush", fast_flush, NULL);
+  g_object_set (sink, "sync", FALSE, "signal-handoffs", TRUE, NULL);
+  g_signal_connect (sink, "handoff", G_CALLBACK (bench_handoff), NULL);
+
+  gst_bin_add_many (GST_BIN (pipeline), dec, sink, NULL);
+  gst_element_link (dec, sink);
+
+  src = gst_pad_new ("src", GST_PAD_SRC);
+  sinkpad = gst_element_get_static_pad (dec, "sink");
+  gst_pad_set_active (src, TRUE);
+  gst_pad_link (src, sinkpad);
+  gst_object_unref (sinkpad);
+
+  state.leaked = 0;
+
+  if (gst_element_set_state (pipeline,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+    g_printerr ("failed to start the pipeline\n");
+    goto out;
+  }
+
+  caps = gst_caps_new_simple ("video/x-vp8",
+      "width", G_TYPE_INT, BENCH_WIDTH, "height", G_TYPE_INT, BENCH_HEIGHT,
+      "framerate", GST_TYPE_FRACTION, 30, 1, NULL);
+  gst_pad_push_event (src, gst_event_new_stream_start ("seek"));
+  gst_pad_push_event (src, gst_event_new_caps (caps));
+  gst_caps_unref (caps);
+
+  /* the first GOP brings the codec up */
+  bench_set_target (0);
+  if (!bench_segment (src, 0) || !bench_push_gop (src, 0) || !bench_wait ()) {
+    g_printerr ("no output before seeking\n");
+    goto out;
+  }
+
+  for (i = 0; i < BENCH_SEEKS; i++) {
+    /* somewhere else in a 10 minute stream */
+    GstClockTime target = (i * 7919 % 600) * GST_SECOND;
+    gint64 start;
+
+    /* decoded but not yet delivered frames are in flight here */
+    bench_push_gop (src, target + BENCH_GOP * BENCH_FRAME);
+
+    start = g_get_monotonic_time ();
+
+    gst_pad_push_event (src, gst_event_new_flush_start ());
+    /* the sink is flushing, anything it renders from now on is ours */
+    bench_set_target (target);
+    gst_pad_push_event (src, gst_event_new_flush_stop (TRUE));
+
+    if (!bench_segment (src, target) || !bench_push_gop (src, target)
+        || !bench_wait ()) {
+      g_printerr ("no output after seek %u\n", i);
+      goto out;
+    }
+
+    times[i] = g_get_monotonic_time () - start;
+  }
+
+  g_object_get (dec, "stats", &stats, NULL);
+  gst_structure_get_uint (stats, "codecs-created", &codecs);
+  gst_structure_free (stats);
+
+  qsort (times, BENCH_SEEKS, sizeof (gint64), bench_compare);
+
+  g_print ("%-10s p50 %8.2f ms  p99 %8.2f ms  codecs %3u  leaked %3u\n",
+      fast_flush ? "fast-flush" : "recreate", times[BENCH_SEEKS / 2] / 1000.0,
+      times[BENCH_SEEKS * 99 / 100] / 1000.0, codecs, state.leaked);
+
+  ret = TRUE;
+
+out:
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_pad_set_active (src, FALSE);
+  gst_object_unref (src);
+  gst_object_unref (pipeline);
+
+  return ret;
+}
+
+int
+main (int argc, char *argv[])
+{
+  gchar *cache = gst_droid_fake_codec_isolate_cache ();
+  GstDroidFakeCodecConfig config;
+  gboolean ret = FALSE;
+
+  gst_init (&argc, &argv);
+
+  g_mutex_init (&state.lock);
+  g_cond_init (&state.cond);
+
+  memset (&config, 0x0, sizeof (config));
+  config.latency = BENCH_LATENCY;
+  config.create_time = BENCH_CREATE_TIME;
+  config.frame_time = BENCH_FRAME_TIME;
+  gst_droid_fake_codec_configure (&config);
+
+  if (!gst_droid_fake_codec_register_elements ()) {
+    g_printerr ("failed to register the elements\n");
+  } else {
+    ret = bench_run (FALSE);
+    ret &= bench_run (TRUE);
+  }
+
+  gst_droid_fake_codec_remove_cache (cache);
+
+  return ret ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,270 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2015-2021 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Times time to first frame in droidvdec against the fake codec, with and
+ * without codec-cache. Every stream is a new pipeline which is torn down
+ * mid-stream, like skipping through a playlist of short clips. The time
+ * runs from the caps to the first frame of the stream reaching the sink.
+ * Frames of an earlier stream that reach a later stream's sink are counted
+ * as leaked.
+ *
+ * The fake codec is given a creation cost and a pipeline depth in the
+ * range stagefright shows for hardware decoders, so the numbers compare
+ * the two modes rather than predict any particular device.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gstdroidfakecodec.h"
+#include <stdlib.h>
+#include <string.h>             /* memset() */
+
+#define BENCH_STREAMS       20
+#define BENCH_GOP           15
+#define BENCH_WIDTH         1280
+#define BENCH_HEIGHT        720
+#define BENCH_FRAME         (GST_SECOND / 30)
+#define BENCH_TIMEOUT       (5 * G_TIME_SPAN_SECOND)
+
+#define BENCH_CREATE_TIME   (80 * GST_MSECOND)
+#define BENCH_FRAME_TIME    (2 * GST_MSECOND)
+#define BENCH_LATENCY       4
+
+typedef struct
+{
+  GMutex lock;
+  GCond cond;
+  /* the first frame of the current stream */
+  GstClockTime target;
+  gboolean arrived;
+  guint leaked;
+} BenchState;
+
+static BenchState state;
+
+static void
+bench_handoff (GstElement * sink, GstBuffer * buffer, GstPad * pad,
+    gpointer user_data)
+{
+  GstClockTime pts = GST_BUFFER_PTS (buffer);
+
+  g_mutex_lock (&state.lock);
+
+  if (pts == state.target) {
+    state.arrived = TRUE;
+    g_cond_signal (&state.cond);
+  } else if (!state.arrived || pts < state.target) {
+    /* every stream starts later than the one before */
+    state.leaked++;
+  }
+
+  g_mutex_unlock (&state.lock);
+}
+
+static gboolean
+bench_push_gop (GstPad * pad, GstClockTime start)
+{
+  guint i;
+
+  for (i = 0; i < BENCH_GOP; i++) {
+    GstBuffer *buffer = gst_buffer_new_allocate (NULL, 1024, NULL);
+
+    gst_buffer_memset (buffer, 0, i, 1024);
+    GST_BUFFER_PTS (buffer) = start + i * BENCH_FRAME;
+    GST_BUFFER_DTS (buffer) = GST_BUFFER_PTS (buffer);
+    GST_BUFFER_DURATION (buffer) = BENCH_FRAME;
+    if (i > 0) {
+      GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+    }
+
+    if (gst_pad_push (pad, buffer) != GST_FLOW_OK) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+static gboolean
+bench_wait (void)
+{
+  gint64 end_time = g_get_monotonic_time () + BENCH_TIMEOUT;
+  gboolean ret = TRUE;
+
+  g_mutex_lock (&state.lock);
+
+  while (!state.arrived && ret) {
+    ret = g_cond_wait_until (&state.cond, &state.lock, end_time);
+  }
+
+  g_mutex_unlock (&state.lock);
+
+  return ret;
+}
+
+static gint
+bench_compare (gconstpointer a, gconstpointer b)
+{
+  gint64 x = *(const gint64 *) a;
+  gint64 y = *(const gint64 *) b;
+
+  return x < y ? -1 : x > y;
+}
+
+/* plays the first GOP of one stream, returns the time to its first frame */
+static gint64
+bench_stream (gboolean codec_cache, GstClockTime start, guint * codecs,
+    guint * adopted)
+{
+  GstElement *pipeline, *dec, *sink;
+  GstPad *src, *sinkpad;
+  GstCaps *caps;
+  GstSegment segment;
+  GstStructure *stats;
+  gint64 begin, ret = -1;
+  guint n;
+
+  pipeline = gst_pipeline_new (NULL);
+  dec = gst_element_factory_make ("droidvdec", NULL);
+  sink = gst_element_factory_make ("fakesink", NULL);
+  g_object_set (dec, "codec-cache", codec_cache, NULL);
+  g_object_set (sink, "sync", FALSE, "signal-handoffs", TRUE, NULL);
+  g_signal_connect (sink, "handoff", G_CALLBACK (bench_handoff), NULL);
+
+  gst_bin_add_many (GST_BIN (pipeline), dec, sink, NULL);
+  gst_element_link (dec, sink);
+
+  src = gst_pad_new ("src", GST_PAD_SRC);
+  sinkpad = gst_element_get_static_pad (dec, "sink");
+  gst_pad_set_active (src, TRUE);
+  gst_pad_link (src, sinkpad);
+  gst_object_unref (sinkpad);
+
+  g_mutex_lock (&state.lock);
+  state.target = start;
+  state.arrived = FALSE;
+  g_mutex_unlock (&state.lock);
+
+  if (gst_element_set_state (pipeline,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+    g_printerr ("failed to start the pipeline\n");
+    goto out;
+  }
+
+  begin = g_get_monotonic_time ();
+
+  caps = gst_caps_new_simple ("video/x-vp8",
+      "width", G_TYPE_INT, BENCH_WIDTH, "height", G_TYPE_INT, BENCH_HEIGHT,
+      "framerate", GST_TYPE_FRACTION, 30, 1, NULL);
+  gst_pad_push_event (src, gst_event_new_stream_start ("ttff"));
+  gst_pad_push_event (src, gst_event_new_caps (caps));
+  gst_caps_unref (caps);
+
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  segment.start = start;
+  segment.time = start;
+  gst_pad_push_event (src, gst_event_new_segment (&segment));
+
+  if (!bench_push_gop (src, start) || !bench_wait ()) {
+    g_printerr ("no output for the stream at %" GST_TIME_FORMAT "\n",
+        GST_TIME_ARGS (start));
+    goto out;
+  }
+
+  ret = g_get_monotonic_time () - begin;
+
+  g_object_get (dec, "stats", &stats, NULL);
+  if (gst_structure_get_uint (stats, "codecs-created", &n)) {
+    *codecs += n;
+  }
+  if (gst_structure_get_uint (stats, "codecs-adopted", &n)) {
+    *adopted += n;
+  }
+  gst_structure_free (stats);
+
+out:
+  /* the rest of the GOP is still in the codec */
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_pad_set_active (src, FALSE);
+  gst_object_unref (src);
+  gst_object_unref (pipeline);
+
+  return ret;
+}
+
+static gboolean
+bench_run (gboolean codec_cache)
+{
+  gint64 times[BENCH_STREAMS];
+  guint codecs = 0, adopted = 0, i;
+
+  state.leaked = 0;
+
+  for (i = 0; i < BENCH_STREAMS; i++) {
+    /* every stream comes after the previous one on the timeline */
+    times[i] = bench_stream (codec_cache, i * 10 * GST_SECOND, &codecs,
+        &adopted);
+    if (times[i] < 0) {
+      return FALSE;
+    }
+  }
+
+  qsort (times, BENCH_STREAMS, sizeof (gint64), bench_compare);
+
+  g_print ("%-12s p50 %8.2f ms  p99 %8.2f ms  codecs %3u  adopted %3u  "
+      "leaked %3u\n", codec_cache ? "codec-cache" : "recreate",
+      times[BENCH_STREAMS / 2] / 1000.0,
+      times[BENCH_STREAMS * 99 / 100] / 1000.0, codecs, adopted, state.leaked);
+
+  return TRUE;
+}
+
+int
+main (int argc, char *argv[])
+{
+  gchar *cache = gst_droid_fake_codec_isolate_cache ();
+  GstDroidFakeCodecConfig config;
+  gboolean ret = FALSE;
+
+  gst_init (&argc, &argv);
+
+  g_mutex_init (&state.lock);
+  g_cond_init (&state.cond);
+
+  memset (&config, 0x0, sizeof (config));
+  config.latency = BENCH_LATENCY;
+  config.create_time = BENCH_CREATE_TIME;
+  config.frame_time = BENCH_FRAME_TIME;
+  gst_droid_fake_codec_configure (&config);
+
+  if (!gst_droid_fake_codec_register_elements ()) {
+    g_printerr ("failed to register the elements\n");
+  } else {
+    ret = bench_run (FALSE);
+    ret &= bench_run (TRUE);
+  }
+
+  gst_droid_fake_codec_remove_cache (cache);
+
+  return ret ? EXIT_SUCCESS : EXIT_FAILURE;
+}
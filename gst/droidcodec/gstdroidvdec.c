@@ -38,6 +38,19 @@
 #endif
 
 #define GST_DROID_DEC_NUM_BUFFERS         2
+#define GST_DROID_DEC_SCRATCH_ALIGN       64
+#define GST_DROID_DEC_CONVERSION_THREADS_DEFAULT  0
+#define GST_DROID_DEC_FAST_FLUSH_DEFAULT          FALSE
+#define GST_DROID_DEC_QUEUE_DEPTH_DEFAULT         0
+#define GST_DROID_DEC_CODEC_CACHE_DEFAULT         FALSE
+/* frames which never produce output are forgotten after this many */
+#define GST_DROID_DEC_MAX_QUEUED_FRAMES           256
+
+typedef struct _GstDroidVDecQueuedFrame
+{
+  gint64 ts;                    /* us, as handed to droidmedia */
+  guint generation;
+} GstDroidVDecQueuedFrame;
 
 #define gst_droidvdec_parent_class parent_class
 G_DEFINE_TYPE (GstDroidVDec, gst_droidvdec, GST_TYPE_VIDEO_DECODER);
@@ -51,11 +64,22 @@ GST_DEBUG_CATEGORY_EXTERN (gst_droid_vdec_debug);
 #define GST_DROIDVDEC_STATE_UNLOCK(decoder) \
     g_mutex_unlock (&(decoder)->state_lock)
 
+enum
+{
+  PROP_0,
+  PROP_STATS,
+  PROP_CONVERSION_THREADS,
+  PROP_FAST_FLUSH,
+  PROP_QUEUE_DEPTH,
+  PROP_CODEC_CACHE,
+};
+
 typedef struct
 {
   int *hal_format;
   GstVideoFormat gst_format;
-  GstDroidVideoConvertToI420 convert_to_i420;
+  GstDroidVideoConvertFunc convert_to_i420;
+  GstDroidVideoConvertFunc convert_to_nv12;
   gsize bytes_per_pixel;
   gsize h_align;
   gsize v_align;
@@ -69,7 +93,7 @@ static GstStaticPadTemplate gst_droidvdec_src_template_factory =
     GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE_WITH_FEATURES
         (GST_CAPS_FEATURE_MEMORY_DROID_MEDIA_QUEUE_BUFFER,
             GST_DROID_MEDIA_BUFFER_MEMORY_VIDEO_FORMATS) ";"
-        GST_VIDEO_CAPS_MAKE ("I420")));
+        GST_VIDEO_CAPS_MAKE ("{ I420, NV12 }")));
 
 static gboolean gst_droidvdec_configure_state (GstVideoDecoder * decoder,
     guint width, guint height);
@@ -77,6 +101,8 @@ static void gst_droidvdec_error (void *data, int err);
 static int gst_droidvdec_size_changed (void *data, int32_t width,
     int32_t height);
 static void gst_droidvdec_signal_eos (void *data);
+static void gst_droidvdec_clear_queued_frames (GstDroidVDec * dec);
+static void gst_droidvdec_track_queued_frame (GstDroidVDec * dec, gint64 ts);
 static void gst_droidvdec_buffers_released (void *user);
 static bool gst_droidvdec_buffer_created (void *user,
     DroidMediaBuffer * buffer);
@@ -103,58 +129,54 @@ gst_droidvdec_loop (GstDroidVDec * dec)
   }
 }
 
-static void
-gst_droidvec_copy_plane (guint8 * out, gint stride_out, guint8 * in,
-    gint stride_in, gint width, gint height)
+#define ALIGN_SIZE(size, to) (((size) + to  - 1) & ~(to - 1))
+
+static guint8 *
+gst_droidvdec_ensure_scratch (GstDroidVDec * dec, gsize size)
 {
-  int i;
-  for (i = 0; i < height; i++) {
-    orc_memcpy (out, in, width);
-    out += stride_out;
-    in += stride_in;
+  if (dec->scratch_size != size) {
+    GST_INFO_OBJECT (dec, "allocating %" G_GSIZE_FORMAT
+        " bytes of scratch memory", size);
+
+    g_free (dec->scratch);
+    dec->scratch = g_malloc (size + GST_DROID_DEC_SCRATCH_ALIGN - 1);
+    dec->scratch_size = size;
+    dec->scratch_allocations++;
   }
+
+  return (guint8 *) ALIGN_SIZE ((guintptr) dec->scratch,
+      GST_DROID_DEC_SCRATCH_ALIGN);
 }
 
 static void
-gst_droidvec_copy_packed_planes (guint8 * out0, guint8 * out1, gint stride_out,
-    guint8 * in, gint stride_in, gint width, gint height)
+gst_droidvdec_free_scratch (GstDroidVDec * dec)
 {
-  int x, y;
-  for (y = 0; y < height; y++) {
-    guint8 *row = in;
-    for (x = 0; x < width; x++) {
-      out0[x] = row[0];
-      out1[x] = row[1];
-      row += 2;
-    }
-
-    out0 += stride_out;
-    out1 += stride_out;
-    in += stride_in;
-  }
+  g_free (dec->scratch);
+  dec->scratch = NULL;
+  dec->scratch_size = 0;
 }
 
-#define ALIGN_SIZE(size, to) (((size) + to  - 1) & ~(to - 1))
-
 static gboolean
-gst_droidvdec_convert_native_to_i420 (GstDroidVDec * dec, GstMapInfo * out,
-    DroidMediaData * in, GstVideoInfo * info, gsize width, gsize height)
+gst_droidvdec_convert_native_to_i420 (GstDroidVideoConverter * conv,
+    GstMapInfo * out, DroidMediaData * in, GstVideoInfo * info, gsize width,
+    gsize height)
 {
+  GstDroidVDec *dec = GST_DROIDVDEC (conv->parent);
   gsize size = width * height * 3 / 2;
   gboolean use_external_buffer = out->size != size;
   guint8 *data = NULL;
   gboolean ret = TRUE;
 
   if (use_external_buffer) {
-    GST_DEBUG_OBJECT (dec, "using an external buffer for I420 conversion.");
-    data = g_malloc (size);
+    GST_LOG_OBJECT (dec, "using scratch memory for I420 conversion.");
+    /* This is sized by _configure_state () so it should not allocate */
+    data = gst_droidvdec_ensure_scratch (dec, size);
   } else {
     data = out->data;
   }
 
   if (droid_media_convert_to_i420 (dec->convert, in, data) != true) {
-    GST_ELEMENT_ERROR (dec, LIBRARY, FAILED, (NULL),
-        ("failed to convert frame"));
+    GST_ERROR_OBJECT (dec, "droid_media_convert_to_i420 failed");
 
     ret = FALSE;
   } else if (use_external_buffer) {
@@ -165,114 +187,137 @@ gst_droidvdec_convert_native_to_i420 (GstDroidVDec * dec, GstMapInfo * out,
     gint strideUV = GST_VIDEO_INFO_COMP_STRIDE (info, 1);
     guint8 *p = data;
     guint8 *dst = out->data;
-    int i;
     int x;
 
     /* Y */
-    for (i = 0; i < info->height; i++) {
-      orc_memcpy (dst, p, info->width);
-      dst += stride;
-      p += width;
-    }
-
+    gst_droid_video_convert_copy_plane (conv, dst, stride, p, width,
+        info->width, info->height);
+    dst += info->height * stride;
     /* NOP if height == info->height */
-    p += (height - info->height) * width;
+    p += height * width;
+
     /* U and V */
     for (x = 0; x < 2; x++) {
-      for (i = 0; i < info->height / 2; i++) {
-        orc_memcpy (dst, p, info->width / 2);
-        dst += strideUV;
-        p += width / 2;
-      }
+      gst_droid_video_convert_copy_plane (conv, dst, strideUV, p, width / 2,
+          info->width / 2, info->height / 2);
+      dst += info->height / 2 * strideUV;
+      p += info->height / 2 * (width / 2);
 
       /* NOP if height == info->height */
       p += (height - info->height) / 2 * width / 2;
     }
   }
 
-  if (use_external_buffer && data) {
-    g_free (data);
+  return ret;
+}
+
+static gboolean
+gst_droidvdec_peer_supports_format (GstDroidVDec * dec, GstVideoFormat format)
+{
+  GstCaps *filter, *caps;
+  gboolean ret;
+
+  filter = gst_caps_new_simple ("video/x-raw", "format", G_TYPE_STRING,
+      gst_video_format_to_string (format), NULL);
+  caps = gst_pad_peer_query_caps (GST_VIDEO_DECODER_SRC_PAD (dec), filter);
+
+  ret = caps && !gst_caps_is_empty (caps);
+
+  GST_DEBUG_OBJECT (dec, "peer supports %s: %d",
+      gst_video_format_to_string (format), ret);
+
+  if (caps) {
+    gst_caps_unref (caps);
   }
 
+  gst_caps_unref (filter);
+
   return ret;
 }
 
-static gboolean
-gst_droidvdec_convert_yuv420_planar_to_i420 (GstDroidVDec * dec,
-    GstMapInfo * out, DroidMediaData * in, GstVideoInfo * info, gsize width,
-    gsize height)
+/*
+ * An adopted codec still has the previous owner's frames in flight. They
+ * are tracked as queued before a flush so their output gets dropped.
+ */
+static void
+gst_droidvdec_attach_codec (GstDroidVDec * dec, GArray * pending)
 {
-  /* Buffer is already I420, so we can copy it straight over */
-  /* though we need to handle the cropping */
-
-  GST_DEBUG_OBJECT (dec, "Copying I420 buffer");
-  gint top = dec->crop_rect.top;
-  gint left = dec->crop_rect.left;
-  gint crop_width = dec->crop_rect.right - left;
-  gint crop_height = dec->crop_rect.bottom - top;
-
-  guint8 *y = in->data + (top * width) + left;
-  guint8 *u = in->data + (width * height) + (top * width / 2) + (left / 2);
-  guint8 *v =
-      in->data + (width * height) + (width * height / 4) +
-      (top * width / 2) + (left / 2);
-
-  gst_droidvec_copy_plane (out->data + info->offset[0],
-      info->stride[0], y, width, crop_width, crop_height);
-  gst_droidvec_copy_plane (out->data + info->offset[1],
-      info->stride[1], u, width / 2, crop_width / 2, crop_height / 2);
-  gst_droidvec_copy_plane (out->data + info->offset[2],
-      info->stride[2], v, width / 2, crop_width / 2, crop_height / 2);
+  DroidMediaCodecCallbacks cb;
+  DroidMediaCodecDataCallbacks data_cb;
+  guint i;
+
+  if (pending) {
+    for (i = 0; i < pending->len; i++) {
+      gst_droidvdec_track_queued_frame (dec,
+          g_array_index (pending, gint64, i));
+    }
 
-  return TRUE;
+    GST_INFO_OBJECT (dec, "adopted codec with %u frames in flight",
+        pending->len);
+
+    g_array_unref (pending);
+    dec->flush_generation++;
+    dec->codecs_adopted++;
+  } else {
+    dec->codecs_created++;
+  }
+
+  cb.signal_eos = gst_droidvdec_signal_eos;
+  cb.error = gst_droidvdec_error;
+  cb.size_changed = gst_droidvdec_size_changed;
+  data_cb.data_available = gst_droidvdec_data_available;
+  gst_droid_codec_cache_entry_attach (dec->cache_entry, &cb, &data_cb, dec);
 }
 
-static gboolean
-gst_droidvdec_convert_yuv420_semi_planar_to_i420 (GstDroidVDec * dec,
-    GstMapInfo * out, DroidMediaData * in, GstVideoInfo * info, gsize width,
-    gsize height)
+/*
+ * Parks the codec in the cache. Call without the stream lock, after
+ * taking the codec away under it.
+ */
+static void
+gst_droidvdec_park_codec (GstDroidVDec * dec, GstDroidCodecCacheEntry * entry)
 {
-  GST_DEBUG_OBJECT (dec, "Converting from OMX_COLOR_FormatYUV420SemiPlanar");
-  gint stride = width;
-  gint slice_height = ALIGN_SIZE (height, 16);
-  gint top = dec->crop_rect.top;
-  gint left = dec->crop_rect.left;
+  GstVideoDecoder *decoder = GST_VIDEO_DECODER (dec);
+  GArray *pending;
+  GList *l;
 
-  guint8 *y = in->data + (top * stride) + left;
-  guint8 *uv = in->data + (stride * slice_height) + (top * stride / 2) + left;
+  GST_INFO_OBJECT (dec, "parking codec");
 
-  gst_droidvec_copy_plane (out->data + info->offset[0],
-      info->stride[0], y, stride, info->width, info->height);
-  gst_droidvec_copy_packed_planes (out->data + info->offset[1],
-      out->data + info->offset[2], info->stride[1], uv, stride,
-      info->width / 2, info->height / 2);
+  if (dec->submitter) {
+    gst_droid_submitter_wait_empty (dec->submitter);
+  }
 
-  return TRUE;
+  gst_droid_codec_cache_entry_detach (entry);
+
+  /* everything still tracked comes out of the codec after we are gone */
+  GST_VIDEO_DECODER_STREAM_LOCK (decoder);
+
+  pending = g_array_sized_new (FALSE, FALSE, sizeof (gint64),
+      dec->queued_frames.length);
+  for (l = dec->queued_frames.head; l; l = l->next) {
+    g_array_append_val (pending, ((GstDroidVDecQueuedFrame *) l->data)->ts);
+  }
+
+  gst_droidvdec_clear_queued_frames (dec);
+
+  GST_VIDEO_DECODER_STREAM_UNLOCK (decoder);
+
+  gst_droid_codec_cache_release (entry, pending, TRUE);
 }
 
-static gboolean
-gst_droidvdec_convert_yuv420_packed_semi_planar_to_i420 (GstDroidVDec * dec,
-    GstMapInfo * out, DroidMediaData * in, GstVideoInfo * info, gsize width,
-    gsize height)
+/* call without any lock the codec callbacks need, unless the codec is drained */
+static void
+gst_droidvdec_destroy_codec (GstDroidVDec * dec)
 {
-  /* copy to the output buffer swapping the u and v planes and cropping if necessary */
-  /* NV12 format with 128 byte alignment */
-  GST_DEBUG_OBJECT (dec, "Converting from qcom NV12 semi planar");
-  gint stride = ALIGN_SIZE (width, 128);
-  gint slice_height = ALIGN_SIZE (height, 32);
-  gint top = ALIGN_SIZE (dec->crop_rect.top, 2);
-  gint left = ALIGN_SIZE (dec->crop_rect.left, 2);
-
-  guint8 *y = in->data + (top * stride) + left;
-  guint8 *uv = in->data + (stride * slice_height) + (top * stride / 2) + left;
-
-  gst_droidvec_copy_plane (out->data + info->offset[0],
-      info->stride[0], y, stride, info->width, info->height);
-  gst_droidvec_copy_packed_planes (out->data + info->offset[1],
-      out->data + info->offset[2], info->stride[1], uv, stride,
-      info->width / 2, info->height / 2);
+  if (dec->cache_entry) {
+    gst_droid_codec_cache_entry_detach (dec->cache_entry);
+    gst_droid_codec_cache_release (dec->cache_entry, NULL, FALSE);
+    dec->cache_entry = NULL;
+  } else {
+    droid_media_codec_stop (dec->codec);
+    droid_media_codec_destroy (dec->codec);
+  }
 
-  return TRUE;
+  dec->codec = NULL;
 }
 
 static gboolean
@@ -281,6 +326,8 @@ gst_droidvdec_create_codec (GstDroidVDec * dec, GstBuffer * input)
   DroidMediaCodecDecoderMetaData md;
   DroidMediaBufferQueue *queue;
   const gchar *droid = gst_droid_codec_get_droid_type (dec->codec_type);
+  GstClockTime start = gst_util_get_timestamp ();
+  GArray *pending = NULL;
 
   GST_INFO_OBJECT (dec, "create codec of type %s: %dx%d",
       droid, dec->in_state->info.width, dec->in_state->info.height);
@@ -314,7 +361,19 @@ gst_droidvdec_create_codec (GstDroidVDec * dec, GstBuffer * input)
       goto error;
   }
 
-  dec->codec = droid_media_codec_create_decoder (&md);
+  /* a new codec has nothing queued from earlier flushes */
+  gst_droidvdec_clear_queued_frames (dec);
+  dec->needs_sync = FALSE;
+
+  if (dec->codec_cache && !dec->use_hardware_buffers) {
+    dec->cache_entry =
+        gst_droid_codec_cache_acquire (GST_OBJECT (dec), &md, &pending);
+    if (dec->cache_entry) {
+      dec->codec = gst_droid_codec_cache_entry_get_codec (dec->cache_entry);
+    }
+  } else {
+    dec->codec = droid_media_codec_create_decoder (&md);
+  }
 
   if (md.codec_data.size > 0) {
     g_free (md.codec_data.data);
@@ -327,6 +386,11 @@ gst_droidvdec_create_codec (GstDroidVDec * dec, GstBuffer * input)
     goto error;
   }
 
+  if (dec->cache_entry) {
+    gst_droidvdec_attach_codec (dec, pending);
+    goto started;
+  }
+
   queue = droid_media_codec_get_buffer_queue (dec->codec);
 
   {
@@ -359,6 +423,25 @@ gst_droidvdec_create_codec (GstDroidVDec * dec, GstBuffer * input)
     goto error;
   }
 
+  dec->codecs_created++;
+
+started:
+  dec->codec_startup_time = gst_util_get_timestamp () - start;
+  dec->first_frame_start = start;
+
+  GST_INFO_OBJECT (dec, "codec ready in %" GST_TIME_FORMAT,
+      GST_TIME_ARGS (dec->codec_startup_time));
+
+  if (dec->queue_depth > 0 && !dec->submitter) {
+    dec->submitter =
+        gst_droid_submitter_new (GST_OBJECT (dec), dec->queue_depth);
+  }
+
+  if (dec->cache_entry) {
+    /* codecs from the cache run their own loop */
+    return TRUE;
+  }
+
   /* now start our task */
   GST_LOG_OBJECT (dec, "starting task");
 
@@ -426,35 +509,55 @@ gst_droidvdec_buffer_created (void *user, DroidMediaBuffer * buffer)
   return ret;
 }
 
+static void
+gst_droidvdec_get_frame_size (GstDroidVDec * dec, GstVideoInfo * info,
+    gsize * width, gsize * height)
+{
+  *width = info->width;
+  *height = info->height;
+
+  if (dec->codec_type->quirks & USE_CODEC_SUPPLIED_WIDTH_VALUE) {
+    *width = dec->codec_reported_width;
+    GST_INFO_OBJECT (dec, "using codec supplied width %"G_GSIZE_FORMAT, *width);
+  }
+
+  if (dec->codec_type->quirks & USE_CODEC_SUPPLIED_HEIGHT_VALUE) {
+    *height = dec->codec_reported_height;
+    GST_INFO_OBJECT (dec, "using codec supplied height %"G_GSIZE_FORMAT,
+        *height);
+  }
+}
+
 static gboolean
 gst_droidvdec_convert_buffer (GstDroidVDec * dec,
     GstBuffer * out, DroidMediaData * in, GstVideoInfo * info)
 {
-  gsize height = info->height;
-  gsize width = info->width;
+  gsize height;
+  gsize width;
   gboolean ret;
   GstMapInfo map_info;
+  GstDroidVideoConvertFunc convert;
 
   GST_DEBUG_OBJECT (dec, "convert buffer");
 
-  if (dec->codec_type->quirks & USE_CODEC_SUPPLIED_WIDTH_VALUE) {
-    width = dec->codec_reported_width;
-    GST_INFO_OBJECT (dec, "using codec supplied width %"G_GSIZE_FORMAT, width);
-  }
+  gst_droidvdec_get_frame_size (dec, info, &width, &height);
 
-  if (dec->codec_type->quirks & USE_CODEC_SUPPLIED_HEIGHT_VALUE) {
-    height = dec->codec_reported_height;
-    GST_INFO_OBJECT (dec, "using codec supplied height %"G_GSIZE_FORMAT, height);
-  }
+  convert = dec->format == GST_VIDEO_FORMAT_NV12 ? dec->convert_to_nv12 :
+      dec->convert_to_i420;
 
-  if (!dec->convert_to_i420) {
-    GST_ERROR_OBJECT (dec, "no i420 conversion function");
+  if (!convert) {
+    GST_ERROR_OBJECT (dec, "no conversion function for %s",
+        gst_video_format_to_string (dec->format));
     ret = FALSE;
   } else if (!gst_buffer_map (out, &map_info, GST_MAP_WRITE)) {
     GST_ERROR_OBJECT (dec, "failed to map buffer");
     ret = FALSE;
   } else {
-    ret = dec->convert_to_i420 (dec, &map_info, in, info, width, height);
+    ret = convert (&dec->converter, &map_info, in, info, width, height);
+    if (!ret) {
+      GST_ELEMENT_ERROR (dec, LIBRARY, FAILED, (NULL),
+          ("failed to convert frame"));
+    }
 
     gst_buffer_unmap (out, &map_info);
   }
@@ -462,6 +565,94 @@ gst_droidvdec_convert_buffer (GstDroidVDec * dec,
   return ret;
 }
 
+/* call with the stream lock held */
+static gboolean
+gst_droidvdec_is_stale_output (GstDroidVDec * dec, gint64 ts)
+{
+  gint64 us = GST_TIME_AS_USECONDS (ts);
+  GstDroidVDecQueuedFrame *queued = NULL;
+  guint generation;
+  GList *l;
+
+  /*
+   * The codec hands back output in queueing order as far as flushes are
+   * concerned so if a timestamp was queued more than once (seek to the
+   * same position, looping, broken pts) the oldest entry is the one this
+   * output belongs to.
+   */
+  for (l = dec->queued_frames.head; l; l = l->next) {
+    if (((GstDroidVDecQueuedFrame *) l->data)->ts == us) {
+      queued = l->data;
+      g_queue_delete_link (&dec->queued_frames, l);
+      break;
+    }
+  }
+
+  if (!queued) {
+    return FALSE;
+  }
+
+  generation = queued->generation;
+  g_slice_free (GstDroidVDecQueuedFrame, queued);
+
+  if (generation == dec->flush_generation) {
+    return FALSE;
+  }
+
+  GST_DEBUG_OBJECT (dec, "dropping output %" GST_TIME_FORMAT
+      " queued before flush", GST_TIME_ARGS (ts));
+
+  dec->stale_frames_dropped++;
+
+  return TRUE;
+}
+
+/* call with the stream lock held */
+static void
+gst_droidvdec_track_queued_frame (GstDroidVDec * dec, gint64 ts)
+{
+  GstDroidVDecQueuedFrame *queued = g_slice_new (GstDroidVDecQueuedFrame);
+
+  queued->ts = ts;
+  queued->generation = dec->flush_generation;
+  g_queue_push_tail (&dec->queued_frames, queued);
+
+  if (dec->queued_frames.length > GST_DROID_DEC_MAX_QUEUED_FRAMES) {
+    g_slice_free (GstDroidVDecQueuedFrame,
+        g_queue_pop_head (&dec->queued_frames));
+  }
+}
+
+/* call with the stream lock held */
+static void
+gst_droidvdec_prune_queued_frames (GstDroidVDec * dec)
+{
+  GList *l = dec->queued_frames.head;
+
+  /* anything older than the previous generation is never coming back */
+  while (l) {
+    GList *next = l->next;
+    GstDroidVDecQueuedFrame *queued = l->data;
+
+    if (queued->generation + 1 < dec->flush_generation) {
+      g_slice_free (GstDroidVDecQueuedFrame, queued);
+      g_queue_delete_link (&dec->queued_frames, l);
+    }
+
+    l = next;
+  }
+}
+
+static void
+gst_droidvdec_clear_queued_frames (GstDroidVDec * dec)
+{
+  GstDroidVDecQueuedFrame *queued;
+
+  while ((queued = g_queue_pop_head (&dec->queued_frames))) {
+    g_slice_free (GstDroidVDecQueuedFrame, queued);
+  }
+}
+
 static bool
 gst_droidvdec_frame_available (void *user, DroidMediaBuffer * buffer)
 {
@@ -490,6 +681,12 @@ gst_droidvdec_frame_available (void *user, DroidMediaBuffer * buffer)
     goto error;
   }
 
+  droid_media_buffer_get_info (buffer, &droid_info);
+
+  if (gst_droidvdec_is_stale_output (dec, droid_info.timestamp)) {
+    goto error;
+  }
+
   pool = gst_video_decoder_get_buffer_pool (decoder);
 
   if (G_UNLIKELY (!pool)) {
@@ -506,8 +703,6 @@ gst_droidvdec_frame_available (void *user, DroidMediaBuffer * buffer)
     goto error;
   }
 
-  droid_media_buffer_get_info (buffer, &droid_info);
-
   if (dec->bytes_per_pixel != 0) {
     width = ALIGN_SIZE (droid_info.stride, dec->h_align) / dec->bytes_per_pixel;
     height = ALIGN_SIZE (droid_info.height, dec->v_align);
@@ -579,6 +774,15 @@ gst_droidvdec_data_available (void *data, DroidMediaCodecData * encoded)
 
   GST_VIDEO_DECODER_STREAM_LOCK (decoder);
 
+  /*
+   * Check first so the frame is no longer tracked whatever happens to it,
+   * a parked codec must not wait for output that already came out.
+   */
+  if (gst_droidvdec_is_stale_output (dec, encoded->ts)) {
+    flow_ret = dec->downstream_flow_ret;
+    goto out;
+  }
+
   if (dec->dirty) {
     flow_ret = dec->downstream_flow_ret;
     goto out;
@@ -601,9 +805,10 @@ gst_droidvdec_data_available (void *data, DroidMediaCodecData * encoded)
 
   buff = gst_video_decoder_allocate_output_buffer (decoder);
 
-  gst_buffer_add_video_meta (buff, GST_VIDEO_FRAME_FLAG_NONE,
-      GST_VIDEO_FORMAT_I420, dec->out_state->info.width,
-      dec->out_state->info.height);
+  gst_buffer_add_video_meta_full (buff, GST_VIDEO_FRAME_FLAG_NONE,
+      dec->format, dec->out_state->info.width, dec->out_state->info.height,
+      GST_VIDEO_INFO_N_PLANES (&dec->out_state->info),
+      dec->out_state->info.offset, dec->out_state->info.stride);
 
   if (!gst_droidvdec_convert_buffer (dec, buff, &encoded->data,
           &dec->out_state->info)) {
@@ -644,10 +849,20 @@ static GstFlowReturn
 gst_droidvdec_finish_frame (GstVideoDecoder * decoder,
     GstVideoCodecFrame * frame)
 {
+  GstDroidVDec *dec = GST_DROIDVDEC (decoder);
   GstFlowReturn flow_ret;
 
   GST_DEBUG_OBJECT (decoder, "finish frame");
 
+  if (G_UNLIKELY (GST_CLOCK_TIME_IS_VALID (dec->first_frame_start))) {
+    dec->first_frame_latency =
+        gst_util_get_timestamp () - dec->first_frame_start;
+    dec->first_frame_start = GST_CLOCK_TIME_NONE;
+
+    GST_INFO_OBJECT (dec, "first frame %" GST_TIME_FORMAT
+        " after creating the codec", GST_TIME_ARGS (dec->first_frame_latency));
+  }
+
   flow_ret = gst_video_decoder_finish_frame (decoder, frame);
 
   if (flow_ret == GST_FLOW_OK || flow_ret == GST_FLOW_FLUSHING) {
@@ -746,45 +961,49 @@ gst_droidvdec_configure_state (GstVideoDecoder * decoder, guint width,
   const GstDroidVideoFormatMap formats[] = {
     {&constants.QOMX_COLOR_FormatYUV420PackedSemiPlanar32m,
           GST_VIDEO_FORMAT_NV12,
-        gst_droidvdec_convert_yuv420_packed_semi_planar_to_i420, 1, 128, 32},
+          gst_droid_video_convert_yuv420_packed_semi_planar_to_i420,
+        gst_droid_video_convert_yuv420_packed_semi_planar_to_nv12, 1, 128, 32},
     {&constants.QOMX_COLOR_FormatYUV420PackedSemiPlanar64x32Tile2m8ka,
-        GST_VIDEO_FORMAT_NV12_64Z32, NULL, 0, 0, 0},
+          GST_VIDEO_FORMAT_NV12_64Z32,
+          gst_droid_video_convert_yuv420_64x32_tiled_to_i420,
+        gst_droid_video_convert_yuv420_64x32_tiled_to_nv12, 0, 0, 0},
     {&constants.OMX_COLOR_FormatYUV420Planar,
           GST_VIDEO_FORMAT_I420,
-        gst_droidvdec_convert_yuv420_planar_to_i420, 1, 4, 1},
+        gst_droid_video_convert_yuv420_planar_to_i420, NULL, 1, 4, 1},
     {&constants.OMX_COLOR_FormatYUV420PackedPlanar,
-          GST_VIDEO_FORMAT_I420, NULL,
+          GST_VIDEO_FORMAT_I420, NULL, NULL,
         1, 1, 1},
     {&constants.OMX_COLOR_FormatYUV420SemiPlanar, GST_VIDEO_FORMAT_NV12,
-        gst_droidvdec_convert_yuv420_semi_planar_to_i420, 1, 1, 1},
-    {&constants.OMX_COLOR_FormatL8, GST_VIDEO_FORMAT_GRAY8, NULL, 1, 1,
-        1},
+          gst_droid_video_convert_yuv420_semi_planar_to_i420,
+        gst_droid_video_convert_yuv420_semi_planar_to_nv12, 1, 1, 1},
+    {&constants.OMX_COLOR_FormatL8, GST_VIDEO_FORMAT_GRAY8, NULL, NULL, 1,
+        1, 1},
     {&constants.OMX_COLOR_FormatYUV422SemiPlanar, GST_VIDEO_FORMAT_NV16,
-          NULL,
+          NULL, NULL,
+        1, 1, 1},
+    {&constants.OMX_COLOR_FormatYCbYCr, GST_VIDEO_FORMAT_YUY2, NULL, NULL,
+        1, 1, 1},
+    {&constants.OMX_COLOR_FormatYCrYCb, GST_VIDEO_FORMAT_YVYU, NULL, NULL,
+        1, 1, 1},
+    {&constants.OMX_COLOR_FormatCbYCrY, GST_VIDEO_FORMAT_UYVY, NULL, NULL,
         1, 1, 1},
-    {&constants.OMX_COLOR_FormatYCbYCr, GST_VIDEO_FORMAT_YUY2, NULL, 1,
-        1, 1},
-    {&constants.OMX_COLOR_FormatYCrYCb, GST_VIDEO_FORMAT_YVYU, NULL, 1,
-        1, 1},
-    {&constants.OMX_COLOR_FormatCbYCrY, GST_VIDEO_FORMAT_UYVY, NULL, 1,
-        1, 1},
     {&constants.OMX_COLOR_Format32bitARGB8888,
           /* There is a mismatch in omxil specification 4.2.1 between
            * OMX_COLOR_Format32bitARGB8888 and its description
            * Follow the description */
           GST_VIDEO_FORMAT_ABGR,
-          NULL,
+          NULL, NULL,
         4, 4, 1},
     {&constants.OMX_COLOR_Format32bitBGRA8888,
           /* Same issue as OMX_COLOR_Format32bitARGB8888 */
           GST_VIDEO_FORMAT_ARGB,
-          NULL,
+          NULL, NULL,
         4, 4, 1},
     {&constants.OMX_COLOR_Format16bitRGB565, GST_VIDEO_FORMAT_RGB16,
-          NULL, 2, 4,
+          NULL, NULL, 2, 4,
         1},
     {&constants.OMX_COLOR_Format16bitBGR565, GST_VIDEO_FORMAT_BGR16,
-          NULL, 2, 4,
+          NULL, NULL, 2, 4,
         1}
   };
 
@@ -838,17 +1057,23 @@ gst_droidvdec_configure_state (GstVideoDecoder * decoder, guint width,
       dec->v_align = 0;
     }
   } else {
-    if (dec->convert) {
+    dec->convert_to_i420 = NULL;
+    dec->convert_to_nv12 = NULL;
+
+    if (format_index < format_count && formats[format_index].convert_to_nv12
+        && gst_droidvdec_peer_supports_format (dec, GST_VIDEO_FORMAT_NV12)) {
+      /* The HAL already produces NV12 so all we need is a crop aware copy */
+      dec->convert_to_nv12 = formats[format_index].convert_to_nv12;
+      dec->format = GST_VIDEO_FORMAT_NV12;
+    } else if (dec->convert) {
       dec->convert_to_i420 = gst_droidvdec_convert_native_to_i420;
+      dec->format = GST_VIDEO_FORMAT_I420;
     } else if (format_index < format_count) {
       dec->convert_to_i420 = formats[format_index].convert_to_i420;
-    } else {
-      dec->convert_to_i420 = NULL;
-    }
-
-    if (dec->convert_to_i420) {
       dec->format = GST_VIDEO_FORMAT_I420;
+    }
 
+    if (dec->convert_to_i420 || dec->convert_to_nv12) {
       width = rect.right - rect.left;
       height = rect.bottom - rect.top;
     } else {
@@ -874,9 +1099,9 @@ gst_droidvdec_configure_state (GstVideoDecoder * decoder, guint width,
         NULL);
     gst_caps_set_features (dec->out_state->caps, 0, feature);
   } else {
-    memcpy (&dec->crop_rect, &rect, sizeof (rect));
+    memcpy (&dec->converter.crop_rect, &rect, sizeof (rect));
 
-    if (dec->convert) {
+    if (dec->convert_to_i420 == gst_droidvdec_convert_native_to_i420) {
       droid_media_convert_set_crop_rect (dec->convert, rect, md.width,
           md.height);
       GST_INFO_OBJECT (dec, "using colour conversion for output buffers");
@@ -891,6 +1116,24 @@ gst_droidvdec_configure_state (GstVideoDecoder * decoder, guint width,
 
   GST_DEBUG_OBJECT (dec, "output caps %" GST_PTR_FORMAT, dec->out_state->caps);
 
+  if (!dec->use_hardware_buffers) {
+    gst_droid_video_converter_set_threads (&dec->converter,
+        dec->conversion_threads, &dec->out_state->info);
+  }
+
+  if (dec->convert_to_i420 == gst_droidvdec_convert_native_to_i420) {
+    gsize frame_width, frame_height, size;
+
+    /* Size the conversion scratch memory once instead of per frame */
+    gst_droidvdec_get_frame_size (dec, &dec->out_state->info, &frame_width,
+        &frame_height);
+    size = frame_width * frame_height * 3 / 2;
+
+    if (size != dec->out_state->info.size) {
+      gst_droidvdec_ensure_scratch (dec, size);
+    }
+  }
+
   return TRUE;
 
 error:
@@ -988,10 +1231,13 @@ gst_droidvdec_stop (GstVideoDecoder * decoder)
 
   GST_DEBUG_OBJECT (dec, "stop");
 
+  if (dec->submitter) {
+    gst_droid_submitter_free (dec->submitter);
+    dec->submitter = NULL;
+  }
+
   if (dec->codec) {
-    droid_media_codec_stop (dec->codec);
-    droid_media_codec_destroy (dec->codec);
-    dec->codec = NULL;
+    gst_droidvdec_destroy_codec (dec);
   }
 
   if (dec->in_state) {
@@ -1006,6 +1252,8 @@ gst_droidvdec_stop (GstVideoDecoder * decoder)
 
   gst_buffer_replace (&dec->codec_data, NULL);
 
+  gst_droidvdec_clear_queued_frames (dec);
+
   if (dec->codec_type) {
     gst_droid_codec_unref (dec->codec_type);
     dec->codec_type = NULL;
@@ -1016,6 +1264,12 @@ gst_droidvdec_stop (GstVideoDecoder * decoder)
     dec->convert = NULL;
   }
 
+  gst_droidvdec_free_scratch (dec);
+  gst_droid_video_converter_free_threads (&dec->converter);
+
+  GST_INFO_OBJECT (dec, "scratch memory allocations: %u",
+      dec->scratch_allocations);
+
   return TRUE;
 }
 
@@ -1048,10 +1302,109 @@ gst_droidvdec_finalize (GObject * object)
 
   g_mutex_clear (&dec->state_lock);
   g_cond_clear (&dec->state_cond);
+  gst_droid_video_converter_clear (&dec->converter);
+
+  gst_droidvdec_clear_queued_frames (dec);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+static GstStructure *
+gst_droidvdec_get_stats (GstDroidVDec * dec)
+{
+  GstStructure *stats;
+
+  stats = gst_structure_new ("GstDroidVDecStats",
+      "scratch-allocations", G_TYPE_UINT, dec->scratch_allocations,
+      "scratch-size", G_TYPE_UINT64, (guint64) dec->scratch_size,
+      "conversion-threads", G_TYPE_UINT, dec->converter.n_threads,
+      "fast-flushes", G_TYPE_UINT, dec->fast_flushes,
+      "stale-frames-dropped", G_TYPE_UINT64, dec->stale_frames_dropped,
+      "codecs-created", G_TYPE_UINT, dec->codecs_created,
+      "codecs-adopted", G_TYPE_UINT, dec->codecs_adopted,
+      "codec-startup-time", G_TYPE_UINT64, dec->codec_startup_time,
+      "first-frame-latency", G_TYPE_UINT64, dec->first_frame_latency, NULL);
+
+  GST_VIDEO_DECODER_STREAM_LOCK (dec);
+
+  if (dec->codec_type) {
+    GstStructure *staging = gst_droid_codec_get_staging_stats (dec->codec_type);
+    gst_structure_set (stats, "input-staging", GST_TYPE_STRUCTURE, staging,
+        NULL);
+    gst_structure_free (staging);
+  }
+
+  if (dec->submitter) {
+    GstStructure *submitter = gst_droid_submitter_get_stats (dec->submitter);
+    gst_structure_set (stats, "submitter", GST_TYPE_STRUCTURE, submitter,
+        NULL);
+    gst_structure_free (submitter);
+  }
+
+  GST_VIDEO_DECODER_STREAM_UNLOCK (dec);
+
+  if (dec->codec_cache) {
+    GstStructure *cache = gst_droid_codec_cache_get_stats ();
+    gst_structure_set (stats, "codec-cache", GST_TYPE_STRUCTURE, cache, NULL);
+    gst_structure_free (cache);
+  }
+
+  return stats;
+}
+
+static void
+gst_droidvdec_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstDroidVDec *dec = GST_DROIDVDEC (object);
+
+  switch (prop_id) {
+    case PROP_CONVERSION_THREADS:
+      dec->conversion_threads = g_value_get_int (value);
+      break;
+    case PROP_FAST_FLUSH:
+      dec->fast_flush = g_value_get_boolean (value);
+      break;
+    case PROP_QUEUE_DEPTH:
+      dec->queue_depth = g_value_get_uint (value);
+      break;
+    case PROP_CODEC_CACHE:
+      dec->codec_cache = g_value_get_boolean (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_droidvdec_get_property (GObject * object, guint prop_id, GValue * value,
+    GParamSpec * pspec)
+{
+  GstDroidVDec *dec = GST_DROIDVDEC (object);
+
+  switch (prop_id) {
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_droidvdec_get_stats (dec));
+      break;
+    case PROP_CONVERSION_THREADS:
+      g_value_set_int (value, dec->conversion_threads);
+      break;
+    case PROP_FAST_FLUSH:
+      g_value_set_boolean (value, dec->fast_flush);
+      break;
+    case PROP_QUEUE_DEPTH:
+      g_value_set_uint (value, dec->queue_depth);
+      break;
+    case PROP_CODEC_CACHE:
+      g_value_set_boolean (value, dec->codec_cache);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
 static gboolean
 gst_droidvdec_open (GstVideoDecoder * decoder)
 {
@@ -1059,9 +1412,7 @@ gst_droidvdec_open (GstVideoDecoder * decoder)
 
   GST_DEBUG_OBJECT (dec, "open");
 
-  /* nothing to do here */
-
-  return TRUE;
+  return gst_droid_media_ensure_init (GST_ELEMENT (dec));
 }
 
 static gboolean
@@ -1091,6 +1442,11 @@ gst_droidvdec_start (GstVideoDecoder * decoder)
   dec->format = GST_VIDEO_FORMAT_UNKNOWN;
   dec->codec_reported_height = -1;
   dec->codec_reported_width = -1;
+  dec->codecs_created = 0;
+  dec->codecs_adopted = 0;
+  dec->codec_startup_time = GST_CLOCK_TIME_NONE;
+  dec->first_frame_start = GST_CLOCK_TIME_NONE;
+  dec->first_frame_latency = GST_CLOCK_TIME_NONE;
 
   return TRUE;
 }
@@ -1190,6 +1546,16 @@ gst_droidvdec_finish (GstVideoDecoder * decoder)
 
     GST_INFO_OBJECT (dec, "draining");
     dec->state = GST_DROID_VDEC_STATE_WAITING_FOR_EOS;
+
+    if (dec->submitter) {
+      /* everything already handed to the submitter must reach the codec first */
+      GST_DROIDVDEC_STATE_UNLOCK (dec);
+      GST_VIDEO_DECODER_STREAM_UNLOCK (decoder);
+      gst_droid_submitter_wait_empty (dec->submitter);
+      GST_VIDEO_DECODER_STREAM_LOCK (decoder);
+      GST_DROIDVDEC_STATE_LOCK (dec);
+    }
+
     droid_media_codec_drain (dec->codec);
 
     /* release the lock to allow _frame_available () to do its job */
@@ -1213,9 +1579,7 @@ gst_droidvdec_finish (GstVideoDecoder * decoder)
     GST_LOG_OBJECT (dec, "acquired stream lock");
 
     if (dec->codec) {
-      droid_media_codec_stop (dec->codec);
-      droid_media_codec_destroy (dec->codec);
-      dec->codec = NULL;
+      gst_droidvdec_destroy_codec (dec);
     }
 
     dec->dirty = TRUE;
@@ -1238,6 +1602,7 @@ gst_droidvdec_handle_frame (GstVideoDecoder * decoder,
   GstFlowReturn ret;
   DroidMediaCodecData data;
   DroidMediaBufferCallbacks cb;
+  DroidMediaCodec *codec;
 
   GST_DEBUG_OBJECT (dec, "handle frame");
 
@@ -1296,6 +1661,15 @@ gst_droidvdec_handle_frame (GstVideoDecoder * decoder,
     }
 
     dec->dirty = FALSE;
+  } else if (G_UNLIKELY (dec->needs_sync)) {
+    /* The codec survived a flush so it still references the old stream */
+    if (!GST_VIDEO_CODEC_FRAME_IS_SYNC_POINT (frame)) {
+      ret = GST_FLOW_OK;
+      gst_video_decoder_drop_frame (decoder, frame);
+      goto out;
+    }
+
+    dec->needs_sync = FALSE;
   }
 
   if (!gst_droid_codec_prepare_decoder_frame (dec->codec_type, frame,
@@ -1317,17 +1691,39 @@ gst_droidvdec_handle_frame (GstVideoDecoder * decoder,
       dts);
   data.sync = GST_VIDEO_CODEC_FRAME_IS_SYNC_POINT (frame) ? true : false;
 
+  /*
+   * remember which flush generation the output for this frame belongs to,
+   * cached codecs need it when they change owners
+   */
+  if (dec->fast_flush || dec->cache_entry) {
+    gst_droidvdec_track_queued_frame (dec, data.ts);
+  }
+
   /* This can deadlock if droidmedia/stagefright input buffer queue is full thus we
    * cannot write the input buffer. We end up waiting for the write operation
    * which does not happen because stagefright needs us to provide
    * output buffers to be filled (which can not happen because _loop() tries
    * to call get_oldest_frame() which acquires the stream lock the base class
    * is holding before calling us
+   *
+   * With a submitter we only need to do that when its queue is full.
    */
-  GST_LOG_OBJECT (dec, "releasing stream lock");
-  GST_VIDEO_DECODER_STREAM_UNLOCK (decoder);
-  droid_media_codec_queue (dec->codec, &data, &cb);
-  GST_VIDEO_DECODER_STREAM_LOCK (decoder);
+  /* the codec can be parked while we are not holding the stream lock */
+  codec = dec->codec;
+
+  if (dec->submitter && gst_droid_submitter_try_push (dec->submitter,
+          codec, &data, &cb)) {
+    GST_LOG_OBJECT (dec, "handed frame to submitter");
+  } else {
+    GST_LOG_OBJECT (dec, "releasing stream lock");
+    GST_VIDEO_DECODER_STREAM_UNLOCK (decoder);
+    if (dec->submitter) {
+      gst_droid_submitter_push (dec->submitter, codec, &data, &cb);
+    } else {
+      droid_media_codec_queue (codec, &data, &cb);
+    }
+    GST_VIDEO_DECODER_STREAM_LOCK (decoder);
+  }
 
   GST_LOG_OBJECT (dec, "acquired stream lock");
 
@@ -1382,14 +1778,28 @@ gst_droidvdec_flush (GstVideoDecoder * decoder)
    * This will lead to frames being repeated if the flush happens in the beginning
    * or inaccurate seeking.
    * We will just mark the decoder as "dirty" so the next handle_frame can recreate it
+   *
+   * With fast-flush we keep the codec instead and bump the flush generation.
+   * Output for anything queued before the flush is dropped when it shows up
+   * and we wait for a sync point before queueing again.
    */
 
-
-
   dec->downstream_flow_ret = GST_FLOW_OK;
   GST_DROIDVDEC_STATE_LOCK (dec);
   if (dec->state != GST_DROID_VDEC_STATE_WAITING_FOR_EOS) {
-    dec->dirty = TRUE;
+    if (dec->fast_flush && dec->codec && !dec->dirty
+        && dec->state == GST_DROID_VDEC_STATE_OK) {
+      dec->flush_generation++;
+      dec->needs_sync = TRUE;
+      dec->fast_flushes++;
+
+      gst_droidvdec_prune_queued_frames (dec);
+
+      GST_DEBUG_OBJECT (dec, "keeping codec, flush generation %u",
+          dec->flush_generation);
+    } else {
+      dec->dirty = TRUE;
+    }
     dec->state = GST_DROID_VDEC_STATE_OK;
   }
   GST_DROIDVDEC_STATE_UNLOCK (dec);
@@ -1412,8 +1822,19 @@ gst_droidvdec_change_state (GstElement * element, GstStateChange transition)
   if (transition == GST_STATE_CHANGE_PAUSED_TO_READY) {
     GstVideoDecoder *decoder = GST_VIDEO_DECODER (dec);
     GstFlowReturn finish_res = GST_FLOW_OK;
+    GstDroidCodecCacheEntry *entry = NULL;
 
     GST_VIDEO_DECODER_STREAM_LOCK (decoder);
+    GST_DROIDVDEC_STATE_LOCK (dec);
+    if (dec->cache_entry && dec->state == GST_DROID_VDEC_STATE_OK) {
+      /* a healthy codec is worth more to the next stream than a drained one */
+      entry = dec->cache_entry;
+      dec->cache_entry = NULL;
+      dec->codec = NULL;
+      dec->dirty = TRUE;
+    }
+    GST_DROIDVDEC_STATE_UNLOCK (dec);
+
     /*
      * _loop() can be waiting in droid_media_codec_loop() thus we must make
      * sure the stagefright decoder is not doing anything otherwise
@@ -1428,6 +1849,10 @@ gst_droidvdec_change_state (GstElement * element, GstStateChange transition)
     }
 
     GST_VIDEO_DECODER_STREAM_UNLOCK (decoder);
+
+    if (entry) {
+      gst_droidvdec_park_codec (dec, entry);
+    }
   }
 
   ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
@@ -1455,6 +1880,26 @@ gst_droidvdec_init (GstDroidVDec * dec)
   dec->in_state = NULL;
   dec->out_state = NULL;
   dec->convert = NULL;
+  dec->scratch = NULL;
+  dec->scratch_size = 0;
+  dec->scratch_allocations = 0;
+  dec->conversion_threads = GST_DROID_DEC_CONVERSION_THREADS_DEFAULT;
+  dec->fast_flush = GST_DROID_DEC_FAST_FLUSH_DEFAULT;
+  dec->queue_depth = GST_DROID_DEC_QUEUE_DEPTH_DEFAULT;
+  dec->submitter = NULL;
+  dec->flush_generation = 0;
+  dec->needs_sync = FALSE;
+  dec->fast_flushes = 0;
+  dec->stale_frames_dropped = 0;
+  dec->codecs_created = 0;
+  dec->codec_startup_time = GST_CLOCK_TIME_NONE;
+  dec->first_frame_start = GST_CLOCK_TIME_NONE;
+  dec->first_frame_latency = GST_CLOCK_TIME_NONE;
+  dec->codec_cache = GST_DROID_DEC_CODEC_CACHE_DEFAULT;
+  dec->cache_entry = NULL;
+  dec->codecs_adopted = 0;
+  g_queue_init (&dec->queued_frames);
+  gst_droid_video_converter_init (&dec->converter, GST_OBJECT (dec));
 }
 
 static void
@@ -1483,6 +1928,8 @@ gst_droidvdec_class_init (GstDroidVDecClass * klass)
       gst_static_pad_template_get (&gst_droidvdec_src_template_factory));
 
   gobject_class->finalize = gst_droidvdec_finalize;
+  gobject_class->set_property = gst_droidvdec_set_property;
+  gobject_class->get_property = gst_droidvdec_get_property;
 
   gstelement_class->change_state =
       GST_DEBUG_FUNCPTR (gst_droidvdec_change_state);
@@ -1498,4 +1945,38 @@ gst_droidvdec_class_init (GstDroidVDecClass * klass)
   gstvideodecoder_class->handle_frame =
       GST_DEBUG_FUNCPTR (gst_droidvdec_handle_frame);
   gstvideodecoder_class->flush = GST_DEBUG_FUNCPTR (gst_droidvdec_flush);
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Decoder statistics", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_CONVERSION_THREADS,
+      g_param_spec_int ("conversion-threads", "Conversion threads",
+          "Number of threads used to copy and convert output frames in "
+          "system memory (0 = automatic, based on resolution)",
+          0, GST_DROID_VIDEO_CONVERT_THREADS_MAX,
+          GST_DROID_DEC_CONVERSION_THREADS_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_FAST_FLUSH,
+      g_param_spec_boolean ("fast-flush", "Fast flush",
+          "Keep the codec running when flushing and drop output queued "
+          "before the flush instead of recreating the codec",
+          GST_DROID_DEC_FAST_FLUSH_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_QUEUE_DEPTH,
+      g_param_spec_uint ("queue-depth", "Queue depth",
+          "Number of input frames queued to the codec from a separate "
+          "thread (0 = queue from the streaming thread)",
+          0, GST_DROID_SUBMITTER_MAX_DEPTH, GST_DROID_DEC_QUEUE_DEPTH_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_CODEC_CACHE,
+      g_param_spec_boolean ("codec-cache", "Codec cache",
+          "Park the system memory codec for the next stream when stopping "
+          "instead of destroying it, and take a parked one when starting",
+          GST_DROID_DEC_CODEC_CACHE_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
@@ -26,6 +26,9 @@
 #include <gst/video/gstvideodecoder.h>
 #include "gst/droid/gstdroidcodec.h"
 #include "droidmediaconvert.h"
+#include "gstdroidvideoconvert.h"
+#include "gstdroidsubmitter.h"
+#include "gstdroidcodeccache.h"
 
 G_BEGIN_DECLS
 
@@ -44,10 +47,6 @@ typedef struct _GstDroidVDec GstDroidVDec;
 typedef struct _GstDroidVDecClass GstDroidVDecClass;
 typedef enum _GstDroidVDecState GstDroidVDecState;
 
-typedef gboolean (*GstDroidVideoConvertToI420) (GstDroidVDec * dec,
-    GstMapInfo * out, DroidMediaData * in, GstVideoInfo * info, gsize width,
-    gsize height);
-
 enum _GstDroidVDecState
 {
   GST_DROID_VDEC_STATE_OK,
@@ -72,7 +71,6 @@ struct _GstDroidVDec
   GstFlowReturn downstream_flow_ret;
   GstBuffer *codec_data;
   gboolean dirty;
-  DroidMediaRect crop_rect;
   gboolean running;
   gboolean use_hardware_buffers;
   GstVideoFormat format;
@@ -86,8 +84,41 @@ struct _GstDroidVDec
   GstVideoCodecState *in_state;
   GstVideoCodecState *out_state;
   DroidMediaConvert *convert;
-  GstDroidVideoConvertToI420 convert_to_i420;
+  GstDroidVideoConvertFunc convert_to_i420;
+  GstDroidVideoConvertFunc convert_to_nv12;
   gint32 hal_format;
+
+  /* scratch memory for droid_media_convert_to_i420 () */
+  guint8 *scratch;
+  gsize scratch_size;
+  guint scratch_allocations;
+
+  /* copies and conversions for system memory output */
+  GstDroidVideoConverter converter;
+  gint conversion_threads;
+
+  /* flushing without recreating the codec, protected by stream lock */
+  gboolean fast_flush;
+  guint flush_generation;
+  gboolean needs_sync;
+  GQueue queued_frames;         /* GstDroidVDecQueuedFrame, oldest first */
+  guint fast_flushes;
+  guint64 stale_frames_dropped;
+
+  /* startup timing, protected by stream lock */
+  guint codecs_created;
+  GstClockTime codec_startup_time;
+  GstClockTime first_frame_start;
+  GstClockTime first_frame_latency;
+
+  /* keeping started decoders around between streams */
+  gboolean codec_cache;
+  GstDroidCodecCacheEntry *cache_entry;
+  guint codecs_adopted;
+
+  /* optional input submission thread */
+  guint queue_depth;
+  GstDroidSubmitter *submitter;
 };
 
 struct _GstDroidVDecClass
@@ -36,6 +36,8 @@ GST_DEBUG_CATEGORY_EXTERN (gst_droid_venc_debug);
 #define GST_CAT_DEFAULT gst_droid_venc_debug
 
 #define GST_DROIDVENC_EOS_TIMEOUT_SEC          2
+#define GST_DROIDVENC_OUTPUT_POOL_MIN_BUFFERS  2
+#define GST_DROIDVENC_OUTPUT_POOL_ALIGN        4096
 
 static GstStaticPadTemplate gst_droidvenc_sink_template_factory =
 GST_STATIC_PAD_TEMPLATE (GST_VIDEO_ENCODER_SINK_NAME,
@@ -48,9 +50,12 @@ enum
 {
   PROP_0,
   PROP_TARGET_BITRATE,
+  PROP_STATS,
+  PROP_QUEUE_DEPTH,
 };
 
 #define GST_DROID_ENC_TARGET_BITRATE_DEFAULT 192000
+#define GST_DROID_ENC_QUEUE_DEPTH_DEFAULT    0
 
 typedef struct
 {
@@ -122,6 +127,7 @@ gst_droidvenc_create_codec (GstDroidVEnc * enc)
 {
   DroidMediaCodecEncoderMetaData md;
   GstQuery *query;
+  GstClockTime start = gst_util_get_timestamp ();
 
   const gchar *droid = gst_droid_codec_get_droid_type (enc->codec_type);
 
@@ -192,6 +198,18 @@ gst_droidvenc_create_codec (GstDroidVEnc * enc)
     return FALSE;
   }
 
+  enc->codecs_created++;
+  enc->codec_startup_time = gst_util_get_timestamp () - start;
+  enc->first_frame_start = start;
+
+  GST_INFO_OBJECT (enc, "codec created and started in %" GST_TIME_FORMAT,
+      GST_TIME_ARGS (enc->codec_startup_time));
+
+  if (enc->queue_depth > 0 && !enc->submitter) {
+    enc->submitter =
+        gst_droid_submitter_new (GST_OBJECT (enc), enc->queue_depth);
+  }
+
   return TRUE;
 }
 
@@ -238,6 +256,84 @@ out:
   g_mutex_unlock (&enc->eos_lock);
 }
 
+static void
+gst_droidvenc_free_output_pool (GstDroidVEnc * enc)
+{
+  if (enc->output_pool) {
+    /* buffers still owned by downstream are freed when they come back */
+    gst_buffer_pool_set_active (enc->output_pool, FALSE);
+    gst_object_unref (enc->output_pool);
+    enc->output_pool = NULL;
+  }
+
+  enc->output_pool_size = 0;
+}
+
+static gboolean
+gst_droidvenc_create_output_pool (GstDroidVEnc * enc, gsize size)
+{
+  GstStructure *config;
+  gsize pool_size;
+
+  gst_droidvenc_free_output_pool (enc);
+
+  /* leave some room so a slightly bigger key frame does not make us
+   * reallocate everything */
+  pool_size = size + size / 2 + GST_DROIDVENC_OUTPUT_POOL_ALIGN - 1;
+  pool_size &= ~(GST_DROIDVENC_OUTPUT_POOL_ALIGN - 1);
+
+  GST_INFO_OBJECT (enc, "creating output pool with buffers of %"
+      G_GSIZE_FORMAT " bytes", pool_size);
+
+  enc->output_pool = gst_buffer_pool_new ();
+  config = gst_buffer_pool_get_config (enc->output_pool);
+  gst_buffer_pool_config_set_params (config, NULL, pool_size,
+      GST_DROIDVENC_OUTPUT_POOL_MIN_BUFFERS, 0);
+
+  if (!gst_buffer_pool_set_config (enc->output_pool, config)) {
+    GST_WARNING_OBJECT (enc, "failed to configure output pool");
+    goto error;
+  }
+
+  if (!gst_buffer_pool_set_active (enc->output_pool, TRUE)) {
+    GST_WARNING_OBJECT (enc, "failed to activate output pool");
+    goto error;
+  }
+
+  enc->output_pool_size = pool_size;
+  enc->output_pool_allocations++;
+
+  return TRUE;
+
+error:
+  gst_object_unref (enc->output_pool);
+  enc->output_pool = NULL;
+
+  return FALSE;
+}
+
+static GstBuffer *
+gst_droidvenc_acquire_output_buffer (GstDroidVEnc * enc, gsize size)
+{
+  GstBuffer *buffer = NULL;
+
+  if (!enc->output_pool || size > enc->output_pool_size) {
+    gst_droidvenc_create_output_pool (enc, size);
+  }
+
+  if (enc->output_pool
+      && gst_buffer_pool_acquire_buffer (enc->output_pool, &buffer,
+          NULL) == GST_FLOW_OK) {
+    return buffer;
+  }
+
+  GST_WARNING_OBJECT (enc, "failed to acquire output buffer from pool");
+
+  enc->output_fallback_allocations++;
+
+  return gst_buffer_new_allocate (NULL, size, NULL);
+}
+
 static void
 gst_droidvenc_data_available (void *data, DroidMediaCodecData * encoded)
 {
@@ -285,8 +381,19 @@ gst_droidvenc_data_available (void *data, DroidMediaCodecData * encoded)
     return;
   }
 
-  frame->output_buffer =
-      gst_droid_codec_prepare_encoded_data (enc->codec_type, &encoded->data);
+  /*
+   * droidmedia releases the encoded data as soon as we return so we
+   * need one copy. Do it into a recycled buffer to avoid allocating
+   * one big block for each frame.
+   */
+  frame->output_buffer = gst_droidvenc_acquire_output_buffer (enc,
+      gst_droid_codec_get_encoded_size (enc->codec_type, &encoded->data));
+  if (!gst_droid_codec_fill_encoded_data (enc->codec_type, &encoded->data,
+          frame->output_buffer)) {
+    gst_buffer_unref (frame->output_buffer);
+    frame->output_buffer = NULL;
+  }
+
   if (!frame->output_buffer) {
     GST_ELEMENT_ERROR (enc, LIBRARY, ENCODE, (NULL),
         ("failed to process encoded data"));
@@ -297,6 +404,8 @@ gst_droidvenc_data_available (void *data, DroidMediaCodecData * encoded)
     return;
   }
 
+  enc->output_frames++;
+
   GST_BUFFER_PTS (frame->output_buffer) = encoded->ts;
   GST_BUFFER_DTS (frame->output_buffer) = encoded->decoding_ts;
 
@@ -304,6 +413,15 @@ gst_droidvenc_data_available (void *data, DroidMediaCodecData * encoded)
     GST_VIDEO_CODEC_FRAME_SET_SYNC_POINT (frame);
   }
 
+  if (G_UNLIKELY (GST_CLOCK_TIME_IS_VALID (enc->first_frame_start))) {
+    enc->first_frame_latency =
+        gst_util_get_timestamp () - enc->first_frame_start;
+    enc->first_frame_start = GST_CLOCK_TIME_NONE;
+
+    GST_INFO_OBJECT (enc, "first frame %" GST_TIME_FORMAT
+        " after creating the codec", GST_TIME_ARGS (enc->first_frame_latency));
+  }
+
   flow_ret = gst_video_encoder_finish_frame (GST_VIDEO_ENCODER (enc), frame);
   /* release our ref */
   gst_video_codec_frame_unref (frame);
@@ -353,12 +471,44 @@ gst_droidvenc_set_property (GObject * object, guint prop_id,
     case PROP_TARGET_BITRATE:
       enc->target_bitrate = g_value_get_int (value);
       break;
+    case PROP_QUEUE_DEPTH:
+      enc->queue_depth = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
 }
 
+static GstStructure *
+gst_droidvenc_get_stats (GstDroidVEnc * enc)
+{
+  GstStructure *stats;
+
+  stats = gst_structure_new ("GstDroidVEncStats",
+      "output-frames", G_TYPE_UINT64, enc->output_frames,
+      "output-pool-allocations", G_TYPE_UINT, enc->output_pool_allocations,
+      "output-pool-buffer-size", G_TYPE_UINT64, (guint64) enc->output_pool_size,
+      "output-fallback-allocations", G_TYPE_UINT,
+      enc->output_fallback_allocations,
+      "codecs-created", G_TYPE_UINT, enc->codecs_created,
+      "codec-startup-time", G_TYPE_UINT64, enc->codec_startup_time,
+      "first-frame-latency", G_TYPE_UINT64, enc->first_frame_latency, NULL);
+
+  GST_VIDEO_ENCODER_STREAM_LOCK (enc);
+
+  if (enc->submitter) {
+    GstStructure *submitter = gst_droid_submitter_get_stats (enc->submitter);
+    gst_structure_set (stats, "submitter", GST_TYPE_STRUCTURE, submitter,
+        NULL);
+    gst_structure_free (submitter);
+  }
+
+  GST_VIDEO_ENCODER_STREAM_UNLOCK (enc);
+
+  return stats;
+}
+
 static void
 gst_droidvenc_get_property (GObject * object, guint prop_id, GValue * value,
     GParamSpec * pspec)
@@ -369,6 +519,12 @@ gst_droidvenc_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_TARGET_BITRATE:
       g_value_set_int (value, enc->target_bitrate);
       break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_droidvenc_get_stats (enc));
+      break;
+    case PROP_QUEUE_DEPTH:
+      g_value_set_uint (value, enc->queue_depth);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -397,9 +553,7 @@ gst_droidvenc_open (GstVideoEncoder * encoder)
 
   GST_DEBUG_OBJECT (enc, "open");
 
-  /* nothing to do here */
-
-  return TRUE;
+  return gst_droid_media_ensure_init (GST_ELEMENT (enc));
 }
 
 static gboolean
@@ -424,6 +578,10 @@ gst_droidvenc_start (GstVideoEncoder * encoder)
   enc->eos = FALSE;
   enc->downstream_flow_ret = GST_FLOW_OK;
   enc->dirty = TRUE;
+  enc->codecs_created = 0;
+  enc->codec_startup_time = GST_CLOCK_TIME_NONE;
+  enc->first_frame_start = GST_CLOCK_TIME_NONE;
+  enc->first_frame_latency = GST_CLOCK_TIME_NONE;
 
   return TRUE;
 }
@@ -435,6 +593,11 @@ gst_droidvenc_stop (GstVideoEncoder * encoder)
 
   GST_DEBUG_OBJECT (enc, "stop");
 
+  if (enc->submitter) {
+    gst_droid_submitter_free (enc->submitter);
+    enc->submitter = NULL;
+  }
+
   if (enc->codec) {
     droid_media_codec_stop (enc->codec);
     droid_media_codec_destroy (enc->codec);
@@ -457,6 +620,12 @@ gst_droidvenc_stop (GstVideoEncoder * encoder)
     enc->codec_type = NULL;
   }
 
+  gst_droidvenc_free_output_pool (enc);
+
+  GST_INFO_OBJECT (enc, "%" G_GUINT64_FORMAT " frames, %u output pool "
+      "allocations, %u fallback allocations", enc->output_frames,
+      enc->output_pool_allocations, enc->output_fallback_allocations);
+
   return TRUE;
 }
 
@@ -512,6 +681,15 @@ gst_droidvenc_finish (GstVideoEncoder * encoder)
   g_mutex_lock (&enc->eos_lock);
   enc->eos = TRUE;
 
+  if (enc->codec && enc->submitter) {
+    /* everything already handed to the submitter must reach the codec first */
+    g_mutex_unlock (&enc->eos_lock);
+    GST_VIDEO_ENCODER_STREAM_UNLOCK (encoder);
+    gst_droid_submitter_wait_empty (enc->submitter);
+    GST_VIDEO_ENCODER_STREAM_LOCK (encoder);
+    g_mutex_lock (&enc->eos_lock);
+  }
+
   if (enc->codec) {
     droid_media_codec_drain (enc->codec);
   } else {
@@ -605,10 +783,21 @@ gst_droidvenc_handle_frame (GstVideoEncoder * encoder,
    * output buffers to be filled (which can not happen because _loop() tries
    * to call get_oldest_frame() which acquires the stream lock the base class
    * is holding before calling us
+   *
+   * With a submitter we only need to do that when its queue is full.
    */
-  GST_VIDEO_ENCODER_STREAM_UNLOCK (encoder);
-  droid_media_codec_queue (enc->codec, &data, &cb);
-  GST_VIDEO_ENCODER_STREAM_LOCK (encoder);
+  if (enc->submitter && gst_droid_submitter_try_push (enc->submitter,
+          enc->codec, &data, &cb)) {
+    GST_LOG_OBJECT (enc, "handed frame to submitter");
+  } else {
+    GST_VIDEO_ENCODER_STREAM_UNLOCK (encoder);
+    if (enc->submitter) {
+      gst_droid_submitter_push (enc->submitter, enc->codec, &data, &cb);
+    } else {
+      droid_media_codec_queue (enc->codec, &data, &cb);
+    }
+    GST_VIDEO_ENCODER_STREAM_LOCK (encoder);
+  }
 
   if (enc->downstream_flow_ret != GST_FLOW_OK) {
     GST_DEBUG_OBJECT (enc, "not handling frame in error state: %s",
@@ -665,7 +854,18 @@ gst_droidvenc_init (GstDroidVEnc * enc)
   enc->in_state = NULL;
   enc->out_state = NULL;
   enc->target_bitrate = GST_DROID_ENC_TARGET_BITRATE_DEFAULT;
+  enc->queue_depth = GST_DROID_ENC_QUEUE_DEPTH_DEFAULT;
+  enc->submitter = NULL;
   enc->downstream_flow_ret = GST_FLOW_OK;
+  enc->output_pool = NULL;
+  enc->output_pool_size = 0;
+  enc->output_frames = 0;
+  enc->output_pool_allocations = 0;
+  enc->output_fallback_allocations = 0;
+  enc->codecs_created = 0;
+  enc->codec_startup_time = GST_CLOCK_TIME_NONE;
+  enc->first_frame_start = GST_CLOCK_TIME_NONE;
+  enc->first_frame_latency = GST_CLOCK_TIME_NONE;
   g_mutex_init (&enc->eos_lock);
   g_cond_init (&enc->eos_cond);
 }
@@ -773,4 +973,16 @@ gst_droidvenc_class_init (GstDroidVEncClass * klass)
           "Target bitrate", 0, G_MAXINT,
           GST_DROID_ENC_TARGET_BITRATE_DEFAULT,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Encoder statistics", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_QUEUE_DEPTH,
+      g_param_spec_uint ("queue-depth", "Queue depth",
+          "Number of input frames queued to the codec from a separate "
+          "thread (0 = queue from the streaming thread)",
+          0, GST_DROID_SUBMITTER_MAX_DEPTH, GST_DROID_ENC_QUEUE_DEPTH_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
@@ -25,6 +25,7 @@
 #include <gst/gst.h>
 #include <gst/video/gstvideoencoder.h>
 #include "gst/droid/gstdroidcodec.h"
+#include "gstdroidsubmitter.h"
 
 G_BEGIN_DECLS
 
@@ -60,6 +61,23 @@ struct _GstDroidVEnc
   /* protected by decoder stream lock */
   GstFlowReturn downstream_flow_ret;
   gboolean dirty;
+
+  /* recycled buffers for encoded output */
+  GstBufferPool *output_pool;
+  gsize output_pool_size;
+  guint64 output_frames;
+  guint output_pool_allocations;
+  guint output_fallback_allocations;
+
+  /* startup timing, protected by stream lock */
+  guint codecs_created;
+  GstClockTime codec_startup_time;
+  GstClockTime first_frame_start;
+  GstClockTime first_frame_latency;
+
+  /* optional input submission thread */
+  guint queue_depth;
+  GstDroidSubmitter *submitter;
 };
 
 struct _GstDroidVEncClass
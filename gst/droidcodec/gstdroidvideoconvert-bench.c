@@ -0,0 +1,191 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2015-2021 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Times the HAL to system memory frame conversions on synthetic 720p,
+ * 1080p and 4K frames. Throughput is given in output bytes per second.
+ * Every conversion is run with 1 up to as many threads as the converter
+ * would use on this machine, then with the count the decoder picks, so
+ * the scaling and the auto choice can be read off the same table.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gstdroidvideoconvert.h"
+#include <stdlib.h>
+#include <string.h>             /* memset() */
+
+#define BENCH_MIN_FRAMES    10
+#define BENCH_MIN_TIME      (G_USEC_PER_SEC / 2)
+
+#define ALIGN_SIZE(size, to) (((size) + to  - 1) & ~(to - 1))
+
+GST_DEBUG_CATEGORY (gst_droid_vdec_debug);
+
+typedef struct
+{
+  const gchar *name;
+  GstDroidVideoConvertFunc convert;
+  GstVideoFormat format;
+  /* size of the HAL frame */
+  gsize (*frame_size) (gsize width, gsize height);
+} BenchConversion;
+
+typedef struct
+{
+  const gchar *name;
+  gint width;
+  gint height;
+} BenchResolution;
+
+static gsize
+bench_packed_semi_planar_size (gsize width, gsize height)
+{
+  return ALIGN_SIZE (width, 128) * ALIGN_SIZE (height, 32) * 3 / 2;
+}
+
+static gsize
+bench_64x32_tiled_size (gsize width, gsize height)
+{
+  gsize y_plane = ALIGN_SIZE (ALIGN_SIZE (width, 128) * ALIGN_SIZE (height,
+          32), 8192);
+
+  return y_plane + ALIGN_SIZE (width, 128) * ALIGN_SIZE (height / 2, 32);
+}
+
+static const BenchConversion conversions[] = {
+  {"packed-semi-planar -> I420",
+      gst_droid_video_convert_yuv420_packed_semi_planar_to_i420,
+      GST_VIDEO_FORMAT_I420, bench_packed_semi_planar_size},
+  {"packed-semi-planar -> NV12",
+      gst_droid_video_convert_yuv420_packed_semi_planar_to_nv12,
+      GST_VIDEO_FORMAT_NV12, bench_packed_semi_planar_size},
+  {"64x32-tiled -> I420",
+      gst_droid_video_convert_yuv420_64x32_tiled_to_i420,
+      GST_VIDEO_FORMAT_I420, bench_64x32_tiled_size},
+  {"64x32-tiled -> NV12",
+      gst_droid_video_convert_yuv420_64x32_tiled_to_nv12,
+      GST_VIDEO_FORMAT_NV12, bench_64x32_tiled_size},
+};
+
+static const BenchResolution resolutions[] = {
+  {"720p", 1280, 720},
+  {"1080p", 1920, 1080},
+  {"4K", 3840, 2160},
+};
+
+static gboolean
+bench_run (const BenchConversion * conversion,
+    const BenchResolution * resolution, guint threads)
+{
+  GstDroidVideoConverter conv;
+  GstVideoInfo info;
+  GstMapInfo out;
+  DroidMediaData in;
+  gint64 start, elapsed;
+  guint frames = 0;
+  gboolean ret = FALSE;
+  guint8 *data;
+  gsize size, i;
+
+  gst_video_info_set_format (&info, conversion->format, resolution->width,
+      resolution->height);
+
+  size = conversion->frame_size (resolution->width, resolution->height);
+  data = g_malloc (size);
+  /* something other than zeros so no page is shared */
+  for (i = 0; i < size; i++) {
+    data[i] = i * 31;
+  }
+
+  in.data = data;
+  in.size = size;
+
+  memset (&out, 0x0, sizeof (out));
+  out.size = info.size;
+  out.data = g_malloc0 (out.size);
+
+  gst_droid_video_converter_init (&conv, NULL);
+  conv.crop_rect.left = 0;
+  conv.crop_rect.top = 0;
+  conv.crop_rect.right = resolution->width;
+  conv.crop_rect.bottom = resolution->height;
+  gst_droid_video_converter_set_threads (&conv, threads, &info);
+
+  /* warm up the caches, the thread pool and orc */
+  if (!conversion->convert (&conv, &out, &in, &info, resolution->width,
+          resolution->height)) {
+    g_printerr ("%s failed for %s\n", conversion->name, resolution->name);
+    goto out;
+  }
+
+  start = g_get_monotonic_time ();
+  do {
+    conversion->convert (&conv, &out, &in, &info, resolution->width,
+        resolution->height);
+    frames++;
+    elapsed = g_get_monotonic_time () - start;
+  } while (frames < BENCH_MIN_FRAMES || elapsed < BENCH_MIN_TIME);
+
+  g_print ("%-28s %-6s %2u thread(s): %9.1f MB/s %12.0f ns/frame\n",
+      conversion->name, resolution->name, conv.n_threads,
+      (gdouble) info.size * frames / elapsed,
+      (gdouble) elapsed * 1000 / frames);
+
+  ret = TRUE;
+
+out:
+  gst_droid_video_converter_clear (&conv);
+  g_free (out.data);
+  g_free (data);
+
+  return ret;
+}
+
+int
+main (int argc, char *argv[])
+{
+  gboolean ret = TRUE;
+  guint c, r, t, max_threads;
+
+  gst_init (&argc, &argv);
+
+  GST_DEBUG_CATEGORY_INIT (gst_droid_vdec_debug, "droidvdec", 0,
+      "Android HAL decoder");
+
+  max_threads = MIN (g_get_num_processors (),
+      GST_DROID_VIDEO_CONVERT_THREADS_MAX);
+
+  for (r = 0; r < G_N_ELEMENTS (resolutions); r++) {
+    for (c = 0; c < G_N_ELEMENTS (conversions); c++) {
+      for (t = 1; t <= max_threads; t++) {
+        ret &= bench_run (&conversions[c], &resolutions[r], t);
+      }
+
+      /* and whatever the decoder would pick */
+      g_print ("%-28s %-6s auto:\n", conversions[c].name, resolutions[r].name);
+      ret &= bench_run (&conversions[c], &resolutions[r], 0);
+    }
+  }
+
+  return ret ? EXIT_SUCCESS : EXIT_FAILURE;
+}
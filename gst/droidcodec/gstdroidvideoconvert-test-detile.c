@@ -0,0 +1,322 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2015-2021 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Golden test for the 64x32 tiled NV12 detiler. A tiled frame is built
+ * from a known linear pattern, with its own copy of the ZFLIPZ_2X2 tile
+ * order, and the detiled I420 and NV12 output is checked pixel by pixel.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gstdroidvideoconvert.h"
+#include <stdlib.h>
+#include <string.h>             /* memset() */
+
+#define TILE_WIDTH          64
+#define TILE_HEIGHT         32
+#define TILE_SIZE           (TILE_WIDTH * TILE_HEIGHT)
+#define TILE_PLANE_ALIGN    8192
+/* fills the gap between the planes so reading from it shows up */
+#define TEST_FILLER         0xaa
+
+#define ALIGN_SIZE(size, to) (((size) + to  - 1) & ~(to - 1))
+
+GST_DEBUG_CATEGORY (gst_droid_vdec_debug);
+
+typedef struct
+{
+  gint width;
+  gint height;
+  gint left;
+  gint top;
+  gint crop_width;
+  gint crop_height;
+} TestFrame;
+
+static const TestFrame test_frames[] = {
+  /* a single tile */
+  {64, 32, 0, 0, 64, 32},
+  /* neither dimension on a tile boundary */
+  {90, 46, 0, 0, 90, 46},
+  {90, 46, 4, 2, 80, 40},
+  /* odd number of tile rows and a luma plane that is not a multiple of
+   * 8K, so the chroma plane starts after a gap */
+  {360, 90, 0, 0, 360, 90},
+  {360, 90, 70, 34, 250, 50},
+  {176, 144, 0, 0, 176, 144},
+  {1920, 1080, 0, 0, 1920, 1080},
+  {1280, 720, 66, 36, 1152, 648},
+};
+
+/* ZFLIPZ_2X2 order for a 4x2 tile grid */
+static const guint test_golden_order[2][4] = {
+  {0, 1, 6, 7},
+  {2, 3, 4, 5},
+};
+
+static guint8
+test_luma (gint x, gint y)
+{
+  return x * 7 + y * 13;
+}
+
+static guint8
+test_chroma (gint x, gint y)
+{
+  return x * 3 + y * 11 + 0x80;
+}
+
+/*
+ * Tiles are ordered in Z shaped groups of four, with every other pair of
+ * tile rows mirrored. The last tile row of an odd number of rows is
+ * plain linear.
+ */
+static guint
+test_tile_index (gint x, gint y, gint x_tiles, gint y_tiles)
+{
+  guint index = (y & ~1) * x_tiles + x;
+
+  if (y & 1) {
+    index += (x & ~3) + 2;
+  } else if ((y_tiles & 1) == 0 || y != y_tiles - 1) {
+    index += (x + 2) & ~3;
+  }
+
+  return index;
+}
+
+static void
+test_tile_plane (guint8 * out, gint x_tiles, gint y_tiles,
+    guint8 (*pattern) (gint x, gint y))
+{
+  gint tx, ty, x, y;
+
+  for (ty = 0; ty < y_tiles; ty++) {
+    for (tx = 0; tx < x_tiles; tx++) {
+      guint8 *tile =
+          out + test_tile_index (tx, ty, x_tiles, y_tiles) * TILE_SIZE;
+
+      for (y = 0; y < TILE_HEIGHT; y++) {
+        for (x = 0; x < TILE_WIDTH; x++) {
+          tile[y * TILE_WIDTH + x] =
+              pattern (tx * TILE_WIDTH + x, ty * TILE_HEIGHT + y);
+        }
+      }
+    }
+  }
+}
+
+static gboolean
+test_golden_tile_order (void)
+{
+  gint x, y;
+
+  for (y = 0; y < 2; y++) {
+    for (x = 0; x < 4; x++) {
+      if (test_tile_index (x, y, 4, 2) != test_golden_order[y][x]) {
+        g_printerr ("tile %d,%d has index %u, expected %u\n", x, y,
+            test_tile_index (x, y, 4, 2), test_golden_order[y][x]);
+        return FALSE;
+      }
+
+      /* and the converter agrees with us */
+      if (gst_video_tile_get_index (GST_VIDEO_TILE_MODE_ZFLIPZ_2X2, x, y, 4,
+              2) != test_golden_order[y][x]) {
+        g_printerr ("gst_video_tile_get_index disagrees for tile %d,%d\n", x,
+            y);
+        return FALSE;
+      }
+    }
+  }
+
+  return TRUE;
+}
+
+static gboolean
+test_check_plane (const gchar * what, guint8 * out, gint stride, gint width,
+    gint height, gint left, gint top, gint step, gint phase,
+    guint8 (*pattern) (gint x, gint y))
+{
+  gint x, y;
+
+  for (y = 0; y < height; y++) {
+    for (x = 0; x < width; x++) {
+      guint8 expected = pattern (left + x * step + phase, top + y);
+
+      if (out[y * stride + x] != expected) {
+        g_printerr ("%s differs at %d,%d: got 0x%02x, expected 0x%02x\n",
+            what, x, y, out[y * stride + x], expected);
+        return FALSE;
+      }
+    }
+  }
+
+  return TRUE;
+}
+
+static gboolean
+test_detile (const TestFrame * frame, gboolean planar)
+{
+  GstDroidVideoConverter conv;
+  GstVideoInfo info;
+  GstMapInfo out;
+  DroidMediaData in;
+  gint x_tiles = ALIGN_SIZE (frame->width, 128) / TILE_WIDTH;
+  gint y_tiles = ALIGN_SIZE (frame->height, 32) / TILE_HEIGHT;
+  gint uv_y_tiles = ALIGN_SIZE (frame->height / 2, 32) / TILE_HEIGHT;
+  gsize y_size = (gsize) x_tiles * y_tiles * TILE_SIZE;
+  gsize uv_offset = ALIGN_SIZE (y_size, TILE_PLANE_ALIGN);
+  gsize size = uv_offset + (gsize) x_tiles * uv_y_tiles * TILE_SIZE;
+  guint8 *data = g_malloc (size);
+  gint chroma_width, chroma_height;
+  gboolean ret = FALSE;
+
+  memset (data, TEST_FILLER, size);
+  test_tile_plane (data, x_tiles, y_tiles, test_luma);
+  test_tile_plane (data + uv_offset, x_tiles, uv_y_tiles, test_chroma);
+
+  in.data = data;
+  in.size = size;
+
+  gst_video_info_set_format (&info,
+      planar ? GST_VIDEO_FORMAT_I420 : GST_VIDEO_FORMAT_NV12,
+      frame->crop_width, frame->crop_height);
+  chroma_width = GST_VIDEO_INFO_COMP_WIDTH (&info, 1);
+  chroma_height = GST_VIDEO_INFO_COMP_HEIGHT (&info, 1);
+
+  memset (&out, 0x0, sizeof (out));
+  out.size = info.size;
+  out.data = g_malloc0 (out.size);
+
+  gst_droid_video_converter_init (&conv, NULL);
+  conv.crop_rect.left = frame->left;
+  conv.crop_rect.top = frame->top;
+  conv.crop_rect.right = frame->left + frame->crop_width;
+  conv.crop_rect.bottom = frame->top + frame->crop_height;
+
+  if (!(planar ? gst_droid_video_convert_yuv420_64x32_tiled_to_i420 :
+          gst_droid_video_convert_yuv420_64x32_tiled_to_nv12) (&conv, &out,
+          &in, &info, frame->width, frame->height)) {
+    g_printerr ("conversion failed\n");
+    goto out;
+  }
+
+  if (!test_check_plane ("Y", out.data + info.offset[0], info.stride[0],
+          frame->crop_width, frame->crop_height, frame->left, frame->top, 1, 0,
+          test_luma)) {
+    goto out;
+  }
+
+  if (planar) {
+    if (!test_check_plane ("U", out.data + info.offset[1], info.stride[1],
+            chroma_width, chroma_height, frame->left, frame->top / 2, 2, 0,
+            test_chroma)
+        || !test_check_plane ("V", out.data + info.offset[2],
+            info.stride[2], chroma_width, chroma_height, frame->left,
+            frame->top / 2, 2, 1, test_chroma)) {
+      goto out;
+    }
+  } else if (!test_check_plane ("UV", out.data + info.offset[1],
+          info.stride[1], chroma_width * 2, chroma_height, frame->left,
+          frame->top / 2, 1, 0, test_chroma)) {
+    goto out;
+  }
+
+  ret = TRUE;
+
+out:
+  if (!ret) {
+    g_printerr ("%s: %dx%d cropped to %dx%d at %d,%d\n",
+        planar ? "I420" : "NV12", frame->width, frame->height,
+        frame->crop_width, frame->crop_height, frame->left, frame->top);
+  }
+
+  gst_droid_video_converter_clear (&conv);
+  g_free (out.data);
+  g_free (data);
+
+  return ret;
+}
+
+static gboolean
+test_short_frame (void)
+{
+  const TestFrame *frame = &test_frames[3];
+  GstDroidVideoConverter conv;
+  GstVideoInfo info;
+  GstMapInfo out;
+  DroidMediaData in;
+  guint8 *data;
+  gboolean ret;
+
+  /* 6x3 luma tiles rounded up to 8K, 6x2 chroma tiles, one byte short */
+  in.size = ALIGN_SIZE (18 * TILE_SIZE, TILE_PLANE_ALIGN) + 12 * TILE_SIZE - 1;
+  data = g_malloc0 (in.size);
+  in.data = data;
+
+  gst_video_info_set_format (&info, GST_VIDEO_FORMAT_NV12, frame->width,
+      frame->height);
+
+  memset (&out, 0x0, sizeof (out));
+  out.size = info.size;
+  out.data = g_malloc0 (out.size);
+
+  gst_droid_video_converter_init (&conv, NULL);
+  conv.crop_rect.right = frame->width;
+  conv.crop_rect.bottom = frame->height;
+
+  ret = !gst_droid_video_convert_yuv420_64x32_tiled_to_nv12 (&conv, &out, &in,
+      &info, frame->width, frame->height);
+  if (!ret) {
+    g_printerr ("a truncated tiled frame was accepted\n");
+  }
+
+  gst_droid_video_converter_clear (&conv);
+  g_free (out.data);
+  g_free (data);
+
+  return ret;
+}
+
+int
+main (int argc, char *argv[])
+{
+  gboolean ret = TRUE;
+  guint i;
+
+  gst_init (&argc, &argv);
+
+  GST_DEBUG_CATEGORY_INIT (gst_droid_vdec_debug, "droidvdec", 0,
+      "Android HAL decoder");
+
+  ret &= test_golden_tile_order ();
+
+  for (i = 0; i < G_N_ELEMENTS (test_frames); i++) {
+    ret &= test_detile (&test_frames[i], TRUE);
+    ret &= test_detile (&test_frames[i], FALSE);
+  }
+
+  ret &= test_short_frame ();
+
+  return ret ? EXIT_SUCCESS : EXIT_FAILURE;
+}
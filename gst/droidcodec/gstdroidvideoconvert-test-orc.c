@@ -0,0 +1,218 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2015-2021 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Checks that the orc chroma deinterleave gives exactly the same bytes as
+ * the scalar loop. The converter is pulled in as source so the static
+ * helpers can be called directly.
+ */
+
+#include "gstdroidvideoconvert.c"
+#include <stdlib.h>
+
+/* meson treats this exit code as a skipped test */
+#define TEST_SKIP           77
+
+#define TEST_CANARY         0xcd
+
+GST_DEBUG_CATEGORY (gst_droid_vdec_debug);
+
+static const gint test_widths[] =
+    { 1, 2, 3, 7, 8, 15, 16, 17, 31, 33, 63, 64, 65, 127, 129, 641 };
+static const gint test_heights[] = { 1, 2, 3, 17 };
+static const gint test_in_pads[] = { 0, 1, 62 };
+static const gint test_out_pads[] = { 0, 3 };
+/* crop offsets, in chroma samples and rows */
+static const gint test_lefts[] = { 0, 1, 5 };
+static const gint test_tops[] = { 0, 3 };
+
+static gboolean
+test_deinterleave (GRand * rand, gint width, gint height, gint in_pad,
+    gint out_pad, gint left, gint top, gint out_skew)
+{
+  gint stride_in = (left + width) * 2 + in_pad;
+  gint stride_out = width + out_pad;
+  gsize in_size = (gsize) stride_in * (top + height);
+  gsize out_size = (gsize) stride_out * height + out_skew;
+  guint8 *in = g_malloc (in_size);
+  guint8 *ref = g_malloc (out_size * 2);
+  guint8 *res = g_malloc (out_size * 2);
+  guint8 *src = in + top * stride_in + left * 2;
+  gboolean ret;
+  gsize i;
+
+  for (i = 0; i < in_size; i++) {
+    in[i] = g_rand_int (rand);
+  }
+
+  memset (ref, TEST_CANARY, out_size * 2);
+  memset (res, TEST_CANARY, out_size * 2);
+
+  gst_droid_video_convert_copy_packed_planes_c (ref + out_skew,
+      ref + out_size + out_skew, stride_out, src, stride_in, width, height);
+  gst_droid_video_convert_copy_packed_planes_simd (res + out_skew,
+      res + out_size + out_skew, stride_out, src, stride_in, width, height);
+
+  ret = memcmp (ref, res, out_size * 2) == 0;
+  if (!ret) {
+    g_printerr ("mismatch: width %d height %d stride in %d out %d "
+        "left %d top %d skew %d\n", width, height, stride_in, stride_out,
+        left, top, out_skew);
+  }
+
+  g_free (in);
+  g_free (ref);
+  g_free (res);
+
+  return ret;
+}
+
+/* the whole conversion, banded over threads, against a naive copy */
+static gboolean
+test_convert_i420 (GRand * rand, gint width, gint height, gint left, gint top,
+    guint threads)
+{
+  GstDroidVideoConverter conv;
+  GstVideoInfo info;
+  GstMapInfo out;
+  DroidMediaData in;
+  gint stride = ALIGN_SIZE (width, 128);
+  gint slice_height = ALIGN_SIZE (height, 32);
+  gint crop_width = width - left;
+  gint crop_height = height - top;
+  gsize in_size = (gsize) stride * slice_height * 3 / 2;
+  guint8 *data = g_malloc (in_size);
+  guint8 *uv = data + stride * slice_height;
+  gboolean ret = TRUE;
+  gint x, y;
+  gsize i;
+
+  for (i = 0; i < in_size; i++) {
+    data[i] = g_rand_int (rand);
+  }
+
+  in.data = data;
+  in.size = in_size;
+
+  gst_video_info_set_format (&info, GST_VIDEO_FORMAT_I420, crop_width,
+      crop_height);
+
+  memset (&out, 0x0, sizeof (out));
+  out.size = info.size;
+  out.data = g_malloc0 (out.size);
+
+  gst_droid_video_converter_init (&conv, NULL);
+  conv.crop_rect.left = left;
+  conv.crop_rect.top = top;
+  conv.crop_rect.right = width;
+  conv.crop_rect.bottom = height;
+  gst_droid_video_converter_set_threads (&conv, threads, &info);
+
+  gst_droid_video_convert_yuv420_packed_semi_planar_to_i420 (&conv, &out, &in,
+      &info, width, height);
+
+  for (y = 0; y < crop_height && ret; y++) {
+    for (x = 0; x < crop_width; x++) {
+      if (out.data[info.offset[0] + y * info.stride[0] + x] !=
+          data[(top + y) * stride + left + x]) {
+        ret = FALSE;
+        break;
+      }
+    }
+  }
+
+  for (y = 0; y < crop_height / 2 && ret; y++) {
+    guint8 *row = uv + (top / 2 + y) * stride + left;
+
+    for (x = 0; x < crop_width / 2; x++) {
+      if (out.data[info.offset[1] + y * info.stride[1] + x] != row[x * 2]
+          || out.data[info.offset[2] + y * info.stride[2] + x] !=
+          row[x * 2 + 1]) {
+        ret = FALSE;
+        break;
+      }
+    }
+  }
+
+  if (!ret) {
+    g_printerr ("mismatch: %dx%d cropped at %d,%d with %u threads\n", width,
+        height, left, top, conv.n_threads);
+  }
+
+  gst_droid_video_converter_clear (&conv);
+  g_free (out.data);
+  g_free (data);
+
+  return ret;
+}
+
+int
+main (int argc, char *argv[])
+{
+  GRand *rand;
+  gboolean ret = TRUE;
+  guint w, h, ip, op, l, t, s;
+
+  gst_init (&argc, &argv);
+
+  GST_DEBUG_CATEGORY_INIT (gst_droid_vdec_debug, "droidvdec", 0,
+      "Android HAL decoder");
+
+#ifdef HAVE_ORC
+  {
+    OrcProgram *p = gst_droid_video_convert_create_deinterleave_program (NULL);
+
+    if (!p) {
+      g_print ("orc has no backend for this CPU, nothing to compare\n");
+      return TEST_SKIP;
+    }
+
+    orc_program_free (p);
+  }
+#else
+  g_print ("built without orc, nothing to compare\n");
+  return TEST_SKIP;
+#endif
+
+  /* a fixed seed so a failure can be reproduced */
+  rand = g_rand_new_with_seed (0x64726f69);
+
+  for (w = 0; w < G_N_ELEMENTS (test_widths); w++)
+    for (h = 0; h < G_N_ELEMENTS (test_heights); h++)
+      for (ip = 0; ip < G_N_ELEMENTS (test_in_pads); ip++)
+        for (op = 0; op < G_N_ELEMENTS (test_out_pads); op++)
+          for (l = 0; l < G_N_ELEMENTS (test_lefts); l++)
+            for (t = 0; t < G_N_ELEMENTS (test_tops); t++)
+              for (s = 0; s < 2; s++)
+                ret &= test_deinterleave (rand, test_widths[w],
+                    test_heights[h], test_in_pads[ip], test_out_pads[op],
+                    test_lefts[l], test_tops[t], s);
+
+  ret &= test_convert_i420 (rand, 1280, 720, 0, 0, 1);
+  ret &= test_convert_i420 (rand, 1280, 720, 0, 0, 4);
+  ret &= test_convert_i420 (rand, 1920, 1080, 2, 2, 1);
+  ret &= test_convert_i420 (rand, 1920, 1080, 2, 2, 2);
+  ret &= test_convert_i420 (rand, 642, 358, 6, 4, 3);
+  ret &= test_convert_i420 (rand, 176, 144, 0, 8, 4);
+
+  g_rand_free (rand);
+
+  return ret ? EXIT_SUCCESS : EXIT_FAILURE;
+}
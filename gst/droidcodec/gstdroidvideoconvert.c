@@ -0,0 +1,567 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2014 Mohammed Sameer
+ * Copyright (C) 2015-2021 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gstdroidvideoconvert.h"
+#include <string.h>             /* memset() */
+#ifdef HAVE_ORC
+#include <orc/orc.h>
+#else
+#define orc_memcpy memcpy
+#endif
+
+/* do not bother splitting planes into bands smaller than this */
+#define GST_DROID_VIDEO_CONVERT_MIN_BAND_HEIGHT  32
+
+/* QOMX_COLOR_FormatYUV420PackedSemiPlanar64x32Tile2m8ka */
+#define GST_DROID_VIDEO_CONVERT_TILE_WIDTH       64
+#define GST_DROID_VIDEO_CONVERT_TILE_HEIGHT      32
+#define GST_DROID_VIDEO_CONVERT_TILE_SIZE \
+    (GST_DROID_VIDEO_CONVERT_TILE_WIDTH * GST_DROID_VIDEO_CONVERT_TILE_HEIGHT)
+#define GST_DROID_VIDEO_CONVERT_TILE_PLANE_ALIGN 8192
+
+#define ALIGN_SIZE(size, to) (((size) + to  - 1) & ~(to - 1))
+
+GST_DEBUG_CATEGORY_EXTERN (gst_droid_vdec_debug);
+#define GST_CAT_DEFAULT gst_droid_vdec_debug
+
+typedef struct
+{
+  guint8 *out0;
+  guint8 *out1;                 /* NULL for a plain plane copy */
+  gint stride_out;
+  guint8 *in;
+  gint stride_in;
+  gint width;
+  gint height;
+} GstDroidVideoConvertBand;
+
+static void
+gst_droid_video_convert_copy_plane_c (guint8 * out, gint stride_out,
+    guint8 * in, gint stride_in, gint width, gint height)
+{
+  int i;
+  for (i = 0; i < height; i++) {
+    orc_memcpy (out, in, width);
+    out += stride_out;
+    in += stride_in;
+  }
+}
+
+static void
+gst_droid_video_convert_copy_packed_planes_c (guint8 * out0, guint8 * out1,
+    gint stride_out, guint8 * in, gint stride_in, gint width, gint height)
+{
+  int x, y;
+  for (y = 0; y < height; y++) {
+    guint8 *row = in;
+    for (x = 0; x < width; x++) {
+      out0[x] = row[0];
+      out1[x] = row[1];
+      row += 2;
+    }
+
+    out0 += stride_out;
+    out1 += stride_out;
+    in += stride_in;
+  }
+}
+
+#ifdef HAVE_ORC
+static gpointer
+gst_droid_video_convert_create_deinterleave_program (G_GNUC_UNUSED gpointer
+    data)
+{
+  OrcProgram *p;
+  OrcCompileResult res;
+
+  orc_init ();
+
+  p = orc_program_new ();
+  orc_program_set_name (p, "gst_droid_video_convert_deinterleave_uv");
+  orc_program_set_2d (p);
+  orc_program_add_destination (p, 1, "d1");
+  orc_program_add_destination (p, 1, "d2");
+  orc_program_add_source (p, 2, "s1");
+
+  /* splitwb writes the high byte (V) to its first destination */
+  orc_program_append_str (p, "splitwb", "d2", "d1", "s1");
+
+  res = orc_program_compile (p);
+  if (!ORC_COMPILE_RESULT_IS_SUCCESSFUL (res)) {
+    /* No SIMD backend for this CPU. The orc emulator is slower than our
+     * scalar loop so don't bother with it */
+    GST_INFO ("cannot compile orc deinterleave program, using scalar path");
+    orc_program_free (p);
+    return NULL;
+  }
+
+  return p;
+}
+#endif
+
+static void
+gst_droid_video_convert_copy_packed_planes_simd (guint8 * out0, guint8 * out1,
+    gint stride_out, guint8 * in, gint stride_in, gint width, gint height)
+{
+#ifdef HAVE_ORC
+  static GOnce once = G_ONCE_INIT;
+  OrcProgram *p;
+
+  p = g_once (&once, gst_droid_video_convert_create_deinterleave_program,
+      NULL);
+
+  if (p && width > 0 && height > 0) {
+    OrcExecutor ex;
+
+    memset (&ex, 0x0, sizeof (ex));
+    orc_executor_set_program (&ex, p);
+    orc_executor_set_n (&ex, width);
+    orc_executor_set_m (&ex, height);
+    orc_executor_set_array (&ex, ORC_VAR_D1, out0);
+    orc_executor_set_stride (&ex, ORC_VAR_D1, stride_out);
+    orc_executor_set_array (&ex, ORC_VAR_D2, out1);
+    orc_executor_set_stride (&ex, ORC_VAR_D2, stride_out);
+    orc_executor_set_array (&ex, ORC_VAR_S1, in);
+    orc_executor_set_stride (&ex, ORC_VAR_S1, stride_in);
+    orc_executor_run (&ex);
+    return;
+  }
+#endif
+
+  gst_droid_video_convert_copy_packed_planes_c (out0, out1, stride_out, in,
+      stride_in, width, height);
+}
+
+static void
+gst_droid_video_convert_band (GstDroidVideoConvertBand * band)
+{
+  if (band->out1) {
+    gst_droid_video_convert_copy_packed_planes_simd (band->out0, band->out1,
+        band->stride_out, band->in, band->stride_in, band->width,
+        band->height);
+  } else {
+    gst_droid_video_convert_copy_plane_c (band->out0, band->stride_out,
+        band->in, band->stride_in, band->width, band->height);
+  }
+}
+
+static void
+gst_droid_video_convert_worker (gpointer data, gpointer user_data)
+{
+  GstDroidVideoConverter *conv = (GstDroidVideoConverter *) user_data;
+
+  gst_droid_video_convert_band ((GstDroidVideoConvertBand *) data);
+
+  g_mutex_lock (&conv->lock);
+  if (--conv->pending == 0) {
+    g_cond_signal (&conv->cond);
+  }
+  g_mutex_unlock (&conv->lock);
+}
+
+static void
+gst_droid_video_convert_bands (GstDroidVideoConverter * conv,
+    GstDroidVideoConvertBand * job)
+{
+  GstDroidVideoConvertBand bands[GST_DROID_VIDEO_CONVERT_THREADS_MAX];
+  guint n = conv->n_threads;
+  gint rows, y;
+  guint i;
+
+  if (!conv->pool || n < 2) {
+    gst_droid_video_convert_band (job);
+    return;
+  }
+
+  n = MIN (n, job->height / GST_DROID_VIDEO_CONVERT_MIN_BAND_HEIGHT);
+  if (n < 2) {
+    gst_droid_video_convert_band (job);
+    return;
+  }
+
+  /* keep the band boundaries on even rows so a band never splits
+   * a line of 2x2 subsampled chroma */
+  rows = (job->height / n) & ~1;
+
+  for (i = 0, y = 0; i < n; i++, y += rows) {
+    bands[i] = *job;
+    bands[i].out0 += y * job->stride_out;
+    if (job->out1) {
+      bands[i].out1 += y * job->stride_out;
+    }
+    bands[i].in += y * job->stride_in;
+    bands[i].height = i == n - 1 ? job->height - y : rows;
+  }
+
+  g_mutex_lock (&conv->lock);
+  conv->pending = n - 1;
+  g_mutex_unlock (&conv->lock);
+
+  for (i = 1; i < n; i++) {
+    g_thread_pool_push (conv->pool, &bands[i], NULL);
+  }
+
+  /* the calling thread does its share too */
+  gst_droid_video_convert_band (&bands[0]);
+
+  g_mutex_lock (&conv->lock);
+  while (conv->pending > 0) {
+    g_cond_wait (&conv->cond, &conv->lock);
+  }
+  g_mutex_unlock (&conv->lock);
+}
+
+void
+gst_droid_video_convert_copy_plane (GstDroidVideoConverter * conv,
+    guint8 * out, gint stride_out, guint8 * in, gint stride_in, gint width,
+    gint height)
+{
+  GstDroidVideoConvertBand job =
+      { out, NULL, stride_out, in, stride_in, width, height };
+
+  gst_droid_video_convert_bands (conv, &job);
+}
+
+static void
+gst_droid_video_convert_copy_packed_planes (GstDroidVideoConverter * conv,
+    guint8 * out0, guint8 * out1, gint stride_out, guint8 * in,
+    gint stride_in, gint width, gint height)
+{
+  GstDroidVideoConvertBand job =
+      { out0, out1, stride_out, in, stride_in, width, height };
+
+  gst_droid_video_convert_bands (conv, &job);
+}
+
+void
+gst_droid_video_converter_init (GstDroidVideoConverter * conv,
+    GstObject * parent)
+{
+  memset (conv, 0x0, sizeof (*conv));
+
+  conv->parent = parent;
+  conv->n_threads = 1;
+
+  g_mutex_init (&conv->lock);
+  g_cond_init (&conv->cond);
+}
+
+void
+gst_droid_video_converter_clear (GstDroidVideoConverter * conv)
+{
+  gst_droid_video_converter_free_threads (conv);
+
+  g_mutex_clear (&conv->lock);
+  g_cond_clear (&conv->cond);
+}
+
+void
+gst_droid_video_converter_set_threads (GstDroidVideoConverter * conv,
+    guint threads, GstVideoInfo * info)
+{
+  guint n = threads;
+
+  if (n == 0) {
+    guint pixels = info->width * info->height;
+
+    /* Up to 720p a single core keeps up, 1080p needs a second one */
+    if (pixels <= 1280 * 720) {
+      n = 1;
+    } else if (pixels <= 1920 * 1088) {
+      n = 2;
+    } else {
+      n = 4;
+    }
+  }
+
+  n = CLAMP (n, 1, MIN (g_get_num_processors (),
+          GST_DROID_VIDEO_CONVERT_THREADS_MAX));
+
+  GST_INFO_OBJECT (conv->parent, "using %u conversion threads for %dx%d", n,
+      info->width, info->height);
+
+  conv->n_threads = n;
+
+  if (n < 2) {
+    return;
+  }
+
+  if (!conv->pool) {
+    GError *err = NULL;
+
+    conv->pool = g_thread_pool_new (gst_droid_video_convert_worker, conv,
+        n - 1, TRUE, &err);
+    if (!conv->pool) {
+      GST_WARNING_OBJECT (conv->parent,
+          "failed to create conversion threads: %s", err->message);
+      g_error_free (err);
+      conv->n_threads = 1;
+    }
+  } else if (g_thread_pool_get_max_threads (conv->pool) != n - 1) {
+    g_thread_pool_set_max_threads (conv->pool, n - 1, NULL);
+  }
+}
+
+void
+gst_droid_video_converter_free_threads (GstDroidVideoConverter * conv)
+{
+  if (conv->pool) {
+    g_thread_pool_free (conv->pool, TRUE, TRUE);
+    conv->pool = NULL;
+  }
+
+  conv->n_threads = 1;
+}
+
+gboolean
+gst_droid_video_convert_yuv420_planar_to_i420 (GstDroidVideoConverter * conv,
+    GstMapInfo * out, DroidMediaData * in, GstVideoInfo * info, gsize width,
+    gsize height)
+{
+  /* Buffer is already I420, so we can copy it straight over */
+  /* though we need to handle the cropping */
+
+  GST_DEBUG_OBJECT (conv->parent, "Copying I420 buffer");
+  gint top = conv->crop_rect.top;
+  gint left = conv->crop_rect.left;
+  gint crop_width = conv->crop_rect.right - left;
+  gint crop_height = conv->crop_rect.bottom - top;
+
+  guint8 *y = in->data + (top * width) + left;
+  guint8 *u = in->data + (width * height) + (top * width / 2) + (left / 2);
+  guint8 *v =
+      in->data + (width * height) + (width * height / 4) +
+      (top * width / 2) + (left / 2);
+
+  gst_droid_video_convert_copy_plane (conv, out->data + info->offset[0],
+      info->stride[0], y, width, crop_width, crop_height);
+  gst_droid_video_convert_copy_plane (conv, out->data + info->offset[1],
+      info->stride[1], u, width / 2, crop_width / 2, crop_height / 2);
+  gst_droid_video_convert_copy_plane (conv, out->data + info->offset[2],
+      info->stride[2], v, width / 2, crop_width / 2, crop_height / 2);
+
+  return TRUE;
+}
+
+gboolean
+gst_droid_video_convert_yuv420_semi_planar_to_i420 (GstDroidVideoConverter *
+    conv, GstMapInfo * out, DroidMediaData * in, GstVideoInfo * info,
+    gsize width, gsize height)
+{
+  GST_DEBUG_OBJECT (conv->parent,
+      "Converting from OMX_COLOR_FormatYUV420SemiPlanar");
+  gint stride = width;
+  gint slice_height = ALIGN_SIZE (height, 16);
+  gint top = conv->crop_rect.top;
+  gint left = conv->crop_rect.left;
+
+  guint8 *y = in->data + (top * stride) + left;
+  guint8 *uv = in->data + (stride * slice_height) + (top * stride / 2) + left;
+
+  gst_droid_video_convert_copy_plane (conv, out->data + info->offset[0],
+      info->stride[0], y, stride, info->width, info->height);
+  gst_droid_video_convert_copy_packed_planes (conv,
+      out->data + info->offset[1], out->data + info->offset[2],
+      info->stride[1], uv, stride, info->width / 2, info->height / 2);
+
+  return TRUE;
+}
+
+gboolean
+gst_droid_video_convert_yuv420_packed_semi_planar_to_i420
+    (GstDroidVideoConverter * conv, GstMapInfo * out, DroidMediaData * in,
+    GstVideoInfo * info, gsize width, gsize height)
+{
+  /* copy to the output buffer swapping the u and v planes and cropping if necessary */
+  /* NV12 format with 128 byte alignment */
+  GST_DEBUG_OBJECT (conv->parent, "Converting from qcom NV12 semi planar");
+  gint stride = ALIGN_SIZE (width, 128);
+  gint slice_height = ALIGN_SIZE (height, 32);
+  gint top = ALIGN_SIZE (conv->crop_rect.top, 2);
+  gint left = ALIGN_SIZE (conv->crop_rect.left, 2);
+
+  guint8 *y = in->data + (top * stride) + left;
+  guint8 *uv = in->data + (stride * slice_height) + (top * stride / 2) + left;
+
+  gst_droid_video_convert_copy_plane (conv, out->data + info->offset[0],
+      info->stride[0], y, stride, info->width, info->height);
+  gst_droid_video_convert_copy_packed_planes (conv,
+      out->data + info->offset[1], out->data + info->offset[2],
+      info->stride[1], uv, stride, info->width / 2, info->height / 2);
+
+  return TRUE;
+}
+
+static void
+gst_droid_video_convert_copy_semi_planar_to_nv12 (GstDroidVideoConverter *
+    conv, GstMapInfo * out, DroidMediaData * in, GstVideoInfo * info,
+    gint stride, gint slice_height)
+{
+  /* The chroma plane is subsampled so the crop origin has to be even */
+  gint top = conv->crop_rect.top & ~1;
+  gint left = conv->crop_rect.left & ~1;
+
+  guint8 *y = in->data + (top * stride) + left;
+  guint8 *uv = in->data + (stride * slice_height) + (top / 2 * stride) + left;
+
+  gst_droid_video_convert_copy_plane (conv, out->data + info->offset[0],
+      info->stride[0], y, stride, info->width, info->height);
+  gst_droid_video_convert_copy_plane (conv, out->data + info->offset[1],
+      info->stride[1], uv, stride, GST_VIDEO_INFO_COMP_WIDTH (info, 1) * 2,
+      GST_VIDEO_INFO_COMP_HEIGHT (info, 1));
+}
+
+gboolean
+gst_droid_video_convert_yuv420_semi_planar_to_nv12 (GstDroidVideoConverter *
+    conv, GstMapInfo * out, DroidMediaData * in, GstVideoInfo * info,
+    gsize width, gsize height)
+{
+  GST_DEBUG_OBJECT (conv->parent,
+      "Copying OMX_COLOR_FormatYUV420SemiPlanar to NV12");
+
+  gst_droid_video_convert_copy_semi_planar_to_nv12 (conv, out, in, info,
+      width, ALIGN_SIZE (height, 16));
+
+  return TRUE;
+}
+
+gboolean
+gst_droid_video_convert_yuv420_packed_semi_planar_to_nv12
+    (GstDroidVideoConverter * conv, GstMapInfo * out, DroidMediaData * in,
+    GstVideoInfo * info, gsize width, gsize height)
+{
+  /* NV12 format with 128 byte stride and 32 line slice alignment */
+  GST_DEBUG_OBJECT (conv->parent, "Copying qcom NV12 semi planar to NV12");
+
+  gst_droid_video_convert_copy_semi_planar_to_nv12 (conv, out, in, info,
+      ALIGN_SIZE (width, 128), ALIGN_SIZE (height, 32));
+
+  return TRUE;
+}
+
+/*
+ * Copies the (left, top, width, height) rectangle, in bytes, out of a plane
+ * made of 64x32 tiles laid out in ZFLIPZ_2X2 order. We walk the plane one
+ * tile at a time so each 2KB tile is read sequentially while it is hot in
+ * the cache. When out1 is set the plane holds interleaved chroma which gets
+ * split into out0 and out1.
+ */
+static void
+gst_droid_video_convert_detile_plane (guint8 * out0, guint8 * out1,
+    gint stride_out, guint8 * in, gint x_tiles, gint y_tiles, gint left,
+    gint top, gint width, gint height)
+{
+  gint tx, ty;
+
+  for (ty = top / GST_DROID_VIDEO_CONVERT_TILE_HEIGHT;
+      ty * GST_DROID_VIDEO_CONVERT_TILE_HEIGHT < top + height; ty++) {
+    gint y0 = MAX (top, ty * GST_DROID_VIDEO_CONVERT_TILE_HEIGHT);
+    gint y1 = MIN (top + height, (ty + 1) * GST_DROID_VIDEO_CONVERT_TILE_HEIGHT);
+    gsize dst_offset = (y0 - top) * stride_out;
+
+    for (tx = left / GST_DROID_VIDEO_CONVERT_TILE_WIDTH;
+        tx * GST_DROID_VIDEO_CONVERT_TILE_WIDTH < left + width; tx++) {
+      gint x0 = MAX (left, tx * GST_DROID_VIDEO_CONVERT_TILE_WIDTH);
+      gint x1 =
+          MIN (left + width, (tx + 1) * GST_DROID_VIDEO_CONVERT_TILE_WIDTH);
+      guint index = gst_video_tile_get_index (GST_VIDEO_TILE_MODE_ZFLIPZ_2X2,
+          tx, ty, x_tiles, y_tiles);
+      guint8 *src = in + index * GST_DROID_VIDEO_CONVERT_TILE_SIZE +
+          (y0 - ty * GST_DROID_VIDEO_CONVERT_TILE_HEIGHT) *
+          GST_DROID_VIDEO_CONVERT_TILE_WIDTH +
+          (x0 - tx * GST_DROID_VIDEO_CONVERT_TILE_WIDTH);
+
+      if (out1) {
+        gst_droid_video_convert_copy_packed_planes_simd (out0 + dst_offset +
+            (x0 - left) / 2, out1 + dst_offset + (x0 - left) / 2, stride_out,
+            src, GST_DROID_VIDEO_CONVERT_TILE_WIDTH, (x1 - x0) / 2, y1 - y0);
+      } else {
+        gst_droid_video_convert_copy_plane_c (out0 + dst_offset + (x0 - left),
+            stride_out, src, GST_DROID_VIDEO_CONVERT_TILE_WIDTH, x1 - x0,
+            y1 - y0);
+      }
+    }
+  }
+}
+
+static gboolean
+gst_droid_video_convert_detile_64x32 (GstDroidVideoConverter * conv,
+    GstMapInfo * out, DroidMediaData * in, GstVideoInfo * info, gsize width,
+    gsize height, gboolean planar)
+{
+  gint x_tiles = ALIGN_SIZE (width, 128) / GST_DROID_VIDEO_CONVERT_TILE_WIDTH;
+  gint y_tiles = ALIGN_SIZE (height, 32) / GST_DROID_VIDEO_CONVERT_TILE_HEIGHT;
+  gint uv_y_tiles =
+      ALIGN_SIZE (height / 2, 32) / GST_DROID_VIDEO_CONVERT_TILE_HEIGHT;
+  gsize uv_offset =
+      ALIGN_SIZE (x_tiles * y_tiles * GST_DROID_VIDEO_CONVERT_TILE_SIZE,
+      GST_DROID_VIDEO_CONVERT_TILE_PLANE_ALIGN);
+  /* The chroma plane is subsampled so the crop origin has to be even */
+  gint top = conv->crop_rect.top & ~1;
+  gint left = conv->crop_rect.left & ~1;
+
+  if (in->size <
+      uv_offset + x_tiles * uv_y_tiles * GST_DROID_VIDEO_CONVERT_TILE_SIZE) {
+    GST_ERROR_OBJECT (conv->parent, "tiled frame too small (%" G_GSIZE_FORMAT
+        " bytes for %" G_GSIZE_FORMAT "x%" G_GSIZE_FORMAT ")",
+        (gsize) in->size, width, height);
+    return FALSE;
+  }
+
+  gst_droid_video_convert_detile_plane (out->data + info->offset[0], NULL,
+      info->stride[0], in->data, x_tiles, y_tiles, left, top, info->width,
+      info->height);
+  gst_droid_video_convert_detile_plane (out->data + info->offset[1],
+      planar ? out->data + info->offset[2] : NULL, info->stride[1],
+      (guint8 *) in->data + uv_offset, x_tiles, uv_y_tiles, left, top / 2,
+      GST_VIDEO_INFO_COMP_WIDTH (info, 1) * 2,
+      GST_VIDEO_INFO_COMP_HEIGHT (info, 1));
+
+  return TRUE;
+}
+
+gboolean
+gst_droid_video_convert_yuv420_64x32_tiled_to_i420 (GstDroidVideoConverter *
+    conv, GstMapInfo * out, DroidMediaData * in, GstVideoInfo * info,
+    gsize width, gsize height)
+{
+  GST_DEBUG_OBJECT (conv->parent,
+      "Converting from qcom 64x32 tiled NV12 to I420");
+
+  return gst_droid_video_convert_detile_64x32 (conv, out, in, info, width,
+      height, TRUE);
+}
+
+gboolean
+gst_droid_video_convert_yuv420_64x32_tiled_to_nv12 (GstDroidVideoConverter *
+    conv, GstMapInfo * out, DroidMediaData * in, GstVideoInfo * info,
+    gsize width, gsize height)
+{
+  GST_DEBUG_OBJECT (conv->parent,
+      "Converting from qcom 64x32 tiled NV12 to NV12");
+
+  return gst_droid_video_convert_detile_64x32 (conv, out, in, info, width,
+      height, FALSE);
+}
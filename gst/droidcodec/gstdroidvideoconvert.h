@@ -0,0 +1,103 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2014 Mohammed Sameer
+ * Copyright (C) 2015-2021 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __GST_DROID_VIDEO_CONVERT_H__
+#define __GST_DROID_VIDEO_CONVERT_H__
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include "droidmediacodec.h"
+
+G_BEGIN_DECLS
+
+#define GST_DROID_VIDEO_CONVERT_THREADS_MAX      16
+
+typedef struct _GstDroidVideoConverter GstDroidVideoConverter;
+
+/*
+ * Copies a decoded frame in a HAL colour format to an I420 or NV12 frame
+ * in system memory described by info, applying the converter crop rect.
+ * width and height are the dimensions of the HAL frame.
+ */
+typedef gboolean (*GstDroidVideoConvertFunc) (GstDroidVideoConverter * conv,
+    GstMapInfo * out, DroidMediaData * in, GstVideoInfo * info, gsize width,
+    gsize height);
+
+struct _GstDroidVideoConverter
+{
+  /* used for logging only, not reffed */
+  GstObject *parent;
+
+  DroidMediaRect crop_rect;
+
+  /* worker threads for splitting planes into bands */
+  guint n_threads;
+  GThreadPool *pool;
+  GMutex lock;
+  GCond cond;
+  gint pending;
+};
+
+void gst_droid_video_converter_init (GstDroidVideoConverter * conv, GstObject * parent);
+void gst_droid_video_converter_clear (GstDroidVideoConverter * conv);
+
+void gst_droid_video_converter_set_threads (GstDroidVideoConverter * conv,
+					    guint threads, GstVideoInfo * info);
+void gst_droid_video_converter_free_threads (GstDroidVideoConverter * conv);
+
+void gst_droid_video_convert_copy_plane (GstDroidVideoConverter * conv, guint8 * out,
+					 gint stride_out, guint8 * in, gint stride_in,
+					 gint width, gint height);
+
+gboolean gst_droid_video_convert_yuv420_planar_to_i420 (GstDroidVideoConverter * conv,
+							GstMapInfo * out, DroidMediaData * in,
+							GstVideoInfo * info, gsize width,
+							gsize height);
+gboolean gst_droid_video_convert_yuv420_semi_planar_to_i420 (GstDroidVideoConverter * conv,
+							     GstMapInfo * out, DroidMediaData * in,
+							     GstVideoInfo * info, gsize width,
+							     gsize height);
+gboolean gst_droid_video_convert_yuv420_packed_semi_planar_to_i420 (GstDroidVideoConverter * conv,
+								    GstMapInfo * out,
+								    DroidMediaData * in,
+								    GstVideoInfo * info,
+								    gsize width, gsize height);
+gboolean gst_droid_video_convert_yuv420_semi_planar_to_nv12 (GstDroidVideoConverter * conv,
+							     GstMapInfo * out, DroidMediaData * in,
+							     GstVideoInfo * info, gsize width,
+							     gsize height);
+gboolean gst_droid_video_convert_yuv420_packed_semi_planar_to_nv12 (GstDroidVideoConverter * conv,
+								    GstMapInfo * out,
+								    DroidMediaData * in,
+								    GstVideoInfo * info,
+								    gsize width, gsize height);
+gboolean gst_droid_video_convert_yuv420_64x32_tiled_to_i420 (GstDroidVideoConverter * conv,
+							     GstMapInfo * out, DroidMediaData * in,
+							     GstVideoInfo * info, gsize width,
+							     gsize height);
+gboolean gst_droid_video_convert_yuv420_64x32_tiled_to_nv12 (GstDroidVideoConverter * conv,
+							     GstMapInfo * out, DroidMediaData * in,
+							     GstVideoInfo * info, gsize width,
+							     gsize height);
+
+G_END_DECLS
+
+#endif /* __GST_DROID_VIDEO_CONVERT_H__ */
@@ -28,6 +28,7 @@
 #include <gst/interfaces/nemovideotexture.h>
 #include "gst/droid/gstdroidmediabuffer.h"
 #include "gst/droid/gstdroidbufferpool.h"
+#include "plugin.h"
 
 /* Element signals and args */
 enum
@@ -283,6 +284,13 @@ gst_droideglsink_change_state (GstElement * element, GstStateChange transition)
 
   sink = GST_DROIDEGLSINK (element);
 
+  /* The buffer pool and the droidmedia buffers need droidmedia up. This
+   * covers droidvideotexturesink as well, it does not override us */
+  if (transition == GST_STATE_CHANGE_NULL_TO_READY
+      && !gst_droid_media_ensure_init (element)) {
+    return GST_STATE_CHANGE_FAILURE;
+  }
+
   ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
 
   if (ret == GST_STATE_CHANGE_SUCCESS) {
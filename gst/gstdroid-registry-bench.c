@@ -0,0 +1,183 @@
+/*
+ * gst-droid
+ *
+ * Copyright (C) 2015-2021 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Times gst_init () in a fresh process against a private registry which
+ * only knows about the plugin in the build tree. A cold run rebuilds the
+ * registry, which loads the plugin and runs every element class_init, a
+ * warm run reads the registry back. Both are compared with an empty
+ * plugin path so the cost of the plugin itself can be read off.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gst/gst.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+
+/* meson treats this exit code as a skipped test */
+#define BENCH_SKIP          77
+#define BENCH_RUNS          15
+
+static gboolean
+bench_child (void)
+{
+  GstPlugin *plugin;
+  gint64 start = g_get_monotonic_time ();
+
+  gst_init (NULL, NULL);
+
+  g_print ("%" G_GINT64_FORMAT "\n", g_get_monotonic_time () - start);
+
+  plugin = gst_registry_find_plugin (gst_registry_get (), "droid");
+  if (!plugin) {
+    return FALSE;
+  }
+
+  gst_object_unref (plugin);
+
+  return TRUE;
+}
+
+static gint
+bench_compare (gconstpointer a, gconstpointer b)
+{
+  gint64 x = *(const gint64 *) a;
+  gint64 y = *(const gint64 *) b;
+
+  return x < y ? -1 : x > y;
+}
+
+/* returns the gst_init () time in us or -1, sets found if the plugin was */
+static gint64
+bench_spawn (const gchar * self, const gchar * registry,
+    const gchar * plugin_path, gboolean * found)
+{
+  gchar *argv[] = { (gchar *) self, (gchar *) "--child", NULL };
+  gchar **envp = g_get_environ ();
+  gchar *out = NULL;
+  GError *err = NULL;
+  gint status;
+  gint64 ret = -1;
+
+  envp = g_environ_setenv (envp, "GST_REGISTRY_1_0", registry, TRUE);
+  envp = g_environ_setenv (envp, "GST_PLUGIN_SYSTEM_PATH_1_0", "", TRUE);
+  envp = g_environ_setenv (envp, "GST_PLUGIN_PATH_1_0", plugin_path, TRUE);
+
+  if (!g_spawn_sync (NULL, argv, envp, G_SPAWN_DEFAULT, NULL, NULL, &out,
+          NULL, &status, &err)) {
+    g_printerr ("failed to run %s: %s\n", self, err->message);
+    g_error_free (err);
+    goto out;
+  }
+
+  *found = g_spawn_check_exit_status (status, NULL);
+  ret = g_ascii_strtoll (out, NULL, 10);
+
+out:
+  g_free (out);
+  g_strfreev (envp);
+
+  return ret;
+}
+
+static gboolean
+bench_run (const gchar * self, const gchar * dir, const gchar * name,
+    const gchar * plugin_path, gboolean cold, gboolean * found)
+{
+  gchar *registry = g_build_filename (dir, "registry.bin", NULL);
+  gint64 times[BENCH_RUNS];
+  gboolean ret = FALSE;
+  guint i;
+
+  /* leave a registry behind for the first warm run */
+  g_unlink (registry);
+  if (!cold && bench_spawn (self, registry, plugin_path, found) < 0) {
+    goto out;
+  }
+
+  for (i = 0; i < BENCH_RUNS; i++) {
+    if (cold) {
+      g_unlink (registry);
+    }
+
+    times[i] = bench_spawn (self, registry, plugin_path, found);
+    if (times[i] < 0) {
+      goto out;
+    }
+  }
+
+  qsort (times, BENCH_RUNS, sizeof (gint64), bench_compare);
+
+  g_print ("%-22s %-5s p50 %8.2f ms  p90 %8.2f ms\n", name,
+      cold ? "cold" : "warm", times[BENCH_RUNS / 2] / 1000.0,
+      times[BENCH_RUNS * 9 / 10] / 1000.0);
+
+  ret = TRUE;
+
+out:
+  g_unlink (registry);
+  g_free (registry);
+
+  return ret;
+}
+
+int
+main (int argc, char *argv[])
+{
+  GError *err = NULL;
+  gboolean found = FALSE, unused;
+  gboolean ret = TRUE;
+  gchar *dir;
+
+  if (argc > 1 && g_str_equal (argv[1], "--child")) {
+    return bench_child () ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  dir = g_dir_make_tmp ("gstdroid-registry-XXXXXX", &err);
+  if (!dir) {
+    g_printerr ("failed to create a registry directory: %s\n", err->message);
+    g_error_free (err);
+    return EXIT_FAILURE;
+  }
+
+  ret &= bench_run (argv[0], dir, "droid plugin", GST_DROID_PLUGIN_DIR, TRUE,
+      &found);
+
+  if (!found) {
+    /* no droidmedia on this machine, the plugin can't be loaded */
+    g_print ("droid plugin not found in %s\n", GST_DROID_PLUGIN_DIR);
+    g_rmdir (dir);
+    g_free (dir);
+    return BENCH_SKIP;
+  }
+
+  ret &= bench_run (argv[0], dir, "droid plugin", GST_DROID_PLUGIN_DIR, FALSE,
+      &found);
+  ret &= bench_run (argv[0], dir, "no plugins", "", TRUE, &unused);
+  ret &= bench_run (argv[0], dir, "no plugins", "", FALSE, &unused);
+
+  g_rmdir (dir);
+  g_free (dir);
+
+  return ret ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -42,6 +42,34 @@ GST_DEBUG_CATEGORY (gst_droid_venc_debug);
 GST_DEBUG_CATEGORY (gst_droid_codec_debug);
 GST_DEBUG_CATEGORY (gst_droid_eglsink_debug);
 GST_DEBUG_CATEGORY (gst_droid_videotexturesink_debug);
+GST_DEBUG_CATEGORY_STATIC (gst_droid_media_debug);
+
+gboolean
+gst_droid_media_ensure_init (GstElement * element)
+{
+  static gsize init = 0;
+  static gboolean initialized = FALSE;
+
+  if (g_once_init_enter (&init)) {
+    GstClockTime start = gst_util_get_timestamp ();
+
+    initialized = droid_media_init ();
+
+    GST_CAT_INFO_OBJECT (gst_droid_media_debug, element,
+        "droidmedia initialization %s after %" GST_TIME_FORMAT,
+        initialized ? "done" : "failed",
+        GST_TIME_ARGS (gst_util_get_timestamp () - start));
+
+    g_once_init_leave (&init, 1);
+  }
+
+  if (!initialized) {
+    GST_ELEMENT_ERROR (element, LIBRARY, INIT, (NULL),
+        ("Failed to initialize droidmedia"));
+  }
+
+  return initialized;
+}
 
 static gboolean
 plugin_init (GstPlugin * plugin)
@@ -72,6 +100,9 @@ plugin_init (GstPlugin * plugin)
   GST_DEBUG_CATEGORY_INIT (gst_droid_codec_debug, "droidcodec",
       0, "Android HAL codec");
 
+  GST_DEBUG_CATEGORY_INIT (gst_droid_media_debug, "droidmedia",
+      0, "Android HAL initialization");
+
   ok &= gst_element_register (plugin, "droidcamsrc", GST_RANK_PRIMARY,
       GST_TYPE_DROIDCAMSRC);
   ok &= gst_element_register (plugin, "droideglsink", GST_RANK_PRIMARY,
@@ -88,8 +119,7 @@ plugin_init (GstPlugin * plugin)
   ok &= gst_element_register (plugin, "droidaenc", GST_RANK_PRIMARY + 1,
       GST_TYPE_DROIDAENC);
 
-  if (ok)
-    ok = droid_media_init ();
+  /* droidmedia is initialized by gst_droid_media_ensure_init () */
 
   return ok;
 }
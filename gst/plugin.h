@@ -25,6 +25,13 @@
 
 G_BEGIN_DECLS
 
+/*
+ * droidmedia is brought up the first time one of our elements goes to
+ * READY instead of when the plugin is loaded. Posts an error on element
+ * if that fails.
+ */
+gboolean gst_droid_media_ensure_init (GstElement * element);
+
 G_END_DECLS
 
 #endif /* __PLUGIN_H__ */